@@ -76,6 +76,12 @@ inline bool isDeviceAccessible(void* ptr){
     }
     return true;
 #endif
+
+#if !defined(__NVCC__) && !defined(__HIP__)
+    //Without a device all memory is host memory
+    (void)ptr;
+    return true;
+#endif
 }
 
 /**
@@ -88,4 +94,26 @@ enum status { success, fail, invalid };
  * @brief Enum for specifying backend target.
  */
 enum targets { host, device, automatic };
+
+/**
+ * @brief Enum for specifying the host rehashing policy.
+ *
+ * standard:  rebuilds leave no tombstones behind.
+ * graveyard: rebuilds spread a calibrated number of tombstones evenly
+ *            through the table (Bender, Kuszmaul & Kuszmaul 2021) so that
+ *            insertions under insert/erase churn find a free slot early.
+ */
+enum class rehash_policy { standard, graveyard };
+
+/**
+ * @brief Enum for specifying the host insertion policy.
+ *
+ * linear:  classic linear probing with tombstones.
+ * ordered: ordered linear probing (Amble & Knuth 1974). Clusters are kept
+ *          sorted by (home bucket, key) so that unsuccessful lookups stop
+ *          as soon as they pass the position the key would occupy.
+ *          Every rebuild, like graveyard rebuilds, briefly holds the old and
+ *          the new bucket arrays plus 8 bytes per new bucket of bookkeeping.
+ */
+enum class insertion_policy { linear, ordered };
 } // namespace Hashinator
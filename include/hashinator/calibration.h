@@ -0,0 +1,402 @@
+/* File:    calibration.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Per machine thresholds used by targets::automatic
+ *
+ * This file defines the following classes:
+ *    --Hashinator::Thresholds
+ *    --Hashinator::Calibration
+ *    --Hashinator::HostTarget
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include "../common.h"
+#include "../splitvector/splitvec.h"
+#include "defaults.h"
+#include "hash_pair.h"
+#include "hashers.h"
+#include "hashfunctions.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+#ifdef HASHINATOR_CPU_ONLY_MODE
+#include "../splitvector/split_pool.h"
+#include "simd.h"
+#endif
+
+namespace Hashinator {
+
+/**
+ * @brief Sizes from which targets::automatic switches to a faster but costlier path.
+ *
+ * Every operation is measured on its own, since lookups, insertions and erasures write
+ * different amounts of shared state. A threshold of SIZE_MAX means the path never paid off
+ * on this machine.
+ */
+struct Thresholds {
+   size_t simdBatch = std::numeric_limits<size_t>::max();      // Host lookups of this many keys use the SIMD gathers
+   size_t threadedBatch = std::numeric_limits<size_t>::max();  // Host lookups of this many keys use all threads
+   size_t threadedInsert = std::numeric_limits<size_t>::max(); // Host insertions of this many elements use all threads
+   size_t threadedErase = std::numeric_limits<size_t>::max();  // Host erasures of this many keys use all threads
+   size_t threadedTable = std::numeric_limits<size_t>::max();  // Host table wide work on this many buckets too
+   size_t deviceBuckets = std::numeric_limits<size_t>::max();  // Tables of this many buckets are rebuilt on the device
+};
+
+/**
+ * @brief Enum for the kinds of host work that have their own thresholds.
+ *
+ * lookup: retrieve batches.
+ * insert: insert and insertIndex batches.
+ * erase:  erase batches.
+ * table:  work over the whole table (rehashing, clearing, extraction), sized by its buckets.
+ */
+enum class host_op { lookup, insert, erase, table };
+
+/**
+ * @brief Enum for the execution paths targets::automatic picks from on the host.
+ *
+ * serial:   one thread, scalar probing.
+ * simd:     one thread, SIMD lookups where the key and value types have them.
+ * threaded: spread over the host threads, SIMD lookups where available.
+ */
+enum class host_path { serial, simd, threaded };
+
+/**
+ * @brief Measures and caches the Thresholds of the machine.
+ *
+ * The thresholds are measured once by a short microbenchmark the first time they are needed
+ * and written to a cache file, which later runs read instead. The file is
+ * $HASHINATOR_CALIBRATION_FILE, or hashinator/thresholds under $XDG_CACHE_HOME or
+ * $HOME/.cache; setting HASHINATOR_CALIBRATION_FILE to an empty string disables caching.
+ * A cache written for a different thread count or SIMD width is measured again.
+ */
+class Calibration {
+public:
+   // Thresholds of this machine, measuring them if there is no valid cache
+   static Thresholds thresholds() {
+      std::lock_guard<std::mutex> lock(state().mutex);
+      if (!state().ready) {
+         const std::string path = cache_file();
+         if (path.empty() || !load(path, state().thresholds)) {
+            state().thresholds = measure();
+            if (!path.empty()) {
+               store(path, state().thresholds);
+            }
+         }
+         state().ready = true;
+      }
+      return state().thresholds;
+   }
+
+   // Overrides the thresholds for the rest of the run
+   static void set(const Thresholds& t) {
+      std::lock_guard<std::mutex> lock(state().mutex);
+      state().thresholds = t;
+      state().ready = true;
+   }
+
+   // Path used for op on a batch of the given size on the host. Only lookups have a SIMD path.
+   static host_path select(size_t batch, host_op op = host_op::lookup) {
+      const Thresholds t = thresholds();
+      const size_t threaded = op == host_op::insert  ? t.threadedInsert
+                              : op == host_op::erase ? t.threadedErase
+                              : op == host_op::table ? t.threadedTable
+                                                     : t.threadedBatch;
+      if (batch >= threaded) {
+         return host_path::threaded;
+      }
+      return op == host_op::lookup && batch >= t.simdBatch ? host_path::simd : host_path::serial;
+   }
+
+   // Where table wide work (rehashing, clearing) on a table of the given size runs
+   static targets select_target(size_t nBuckets) {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      return select(nBuckets, host_op::table) == host_path::threaded ? targets::device : targets::host;
+#else
+      return nBuckets >= thresholds().deviceBuckets ? targets::device : targets::host;
+#endif
+   }
+
+   static std::string cache_file() {
+      if (const char* env = std::getenv("HASHINATOR_CALIBRATION_FILE")) {
+         return env;
+      }
+      if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+         return std::string(xdg) + "/hashinator/thresholds";
+      }
+      if (const char* home = std::getenv("HOME")) {
+         return std::string(home) + "/.cache/hashinator/thresholds";
+      }
+      return "";
+   }
+
+   // Reads a cache file. Returns false if it is missing, malformed or was written for another setup.
+   static bool load(const std::string& path, Thresholds& t) {
+      std::ifstream in(path);
+      std::string tag, sig;
+      Thresholds read;
+      if (!(in >> tag >> sig) || tag != "signature" || sig != signature()) {
+         return false;
+      }
+      if (!(in >> tag >> read.simdBatch) || tag != "simdBatch" || !(in >> tag >> read.threadedBatch) ||
+          tag != "threadedBatch" || !(in >> tag >> read.threadedInsert) || tag != "threadedInsert" ||
+          !(in >> tag >> read.threadedErase) || tag != "threadedErase" || !(in >> tag >> read.threadedTable) ||
+          tag != "threadedTable" || !(in >> tag >> read.deviceBuckets) || tag != "deviceBuckets") {
+         return false;
+      }
+      t = read;
+      return true;
+   }
+
+   // Writes a cache file. Failures only cost a new measurement next time.
+   static bool store(const std::string& path, const Thresholds& t) {
+      std::error_code err;
+      const std::filesystem::path target(path);
+      if (target.has_parent_path()) {
+         std::filesystem::create_directories(target.parent_path(), err);
+      }
+      // Write aside and rename so that concurrent runs never read half a file
+      const std::string scratch =
+          path + ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+      {
+         std::ofstream out(scratch);
+         out << "signature " << signature() << "\n"
+             << "simdBatch " << t.simdBatch << "\n"
+             << "threadedBatch " << t.threadedBatch << "\n"
+             << "threadedInsert " << t.threadedInsert << "\n"
+             << "threadedErase " << t.threadedErase << "\n"
+             << "threadedTable " << t.threadedTable << "\n"
+             << "deviceBuckets " << t.deviceBuckets << "\n";
+         if (!out) {
+            std::remove(scratch.c_str());
+            return false;
+         }
+      }
+      std::filesystem::rename(scratch, target, err);
+      if (err) {
+         std::remove(scratch.c_str());
+         return false;
+      }
+      return true;
+   }
+
+   /**
+    * @brief Times the candidate paths on batches of 2^6 to 2^16 elements.
+    *
+    * Lookups, insertions and erasures of each batch are timed separately on a table twice
+    * its size, and clearing that table stands in for the table wide work.
+    * A threshold is the smallest batch from which a path beats the cheaper ones by a margin
+    * at every larger size, so that noise around the crossover does not flip the choice.
+    */
+   static Thresholds measure() {
+      Thresholds t;
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      using KEY = uint32_t;
+      constexpr KEY EMPTY = std::numeric_limits<KEY>::max();
+      using Hasher = Hashers::HostHasher<KEY, KEY, HashFunctions::Fibonacci<KEY>, EMPTY, EMPTY - 1>;
+      constexpr int minPower = 6;
+      constexpr int maxPower = 16;
+      std::vector<double> serial, simd, threaded;
+      std::vector<double> insertSerial, insertThreaded, eraseSerial, eraseThreaded, tableSerial, tableThreaded;
+      const bool hasThreads = split::host_concurrency() > 1;
+      constexpr double never = std::numeric_limits<double>::max();
+      for (int power = minPower; power <= maxPower; power++) {
+         const size_t n = size_t(1) << power;
+         // Half full table with every key present, looked up in a scattered order
+         split::SplitVector<hash_pair<KEY, KEY>> buckets(2 * n, hash_pair<KEY, KEY>(EMPTY, KEY()));
+         Info info(power + 1);
+         std::vector<KEY> keys(n), vals(n);
+         for (size_t i = 0; i < n; i++) {
+            keys[i] = static_cast<KEY>((i * 2654435761u) % (8 * n)) + 1;
+            vals[i] = static_cast<KEY>(i);
+         }
+         Hasher::insert(keys.data(), vals.data(), buckets.data(), &info, n, 0, split::execution_policy::serial);
+         // Enough repetitions to time at least 2^16 elements, best of three. Only run() is timed.
+         auto time = [&](auto prepare, auto run) {
+            const size_t reps = std::max<size_t>(1, (size_t(1) << maxPower) / n);
+            double best = never;
+            for (int trial = 0; trial < 3; trial++) {
+               double total = 0.0;
+               for (size_t r = 0; r < reps; r++) {
+                  prepare();
+                  const auto start = std::chrono::steady_clock::now();
+                  run();
+                  total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+               }
+               best = std::min(best, total);
+            }
+            return best / reps;
+         };
+         auto nothing = []() {};
+         auto lookup = [&](split::execution_policy policy, bool vectorized) {
+            return time(nothing, [&]() {
+               Hasher::retrieve(keys.data(), vals.data(), buckets.data(), &info, n, 0, policy, vectorized);
+            });
+         };
+         auto clear = [&]() {
+            Hasher::reset_all(buckets.data(), &info, buckets.size(), 0, split::execution_policy::serial);
+         };
+         auto fill = [&]() {
+            clear();
+            Hasher::insert(keys.data(), vals.data(), buckets.data(), &info, n, 0, split::execution_policy::serial);
+         };
+         auto insert = [&](split::execution_policy policy) {
+            return time(clear, [&]() {
+               Hasher::insert(keys.data(), vals.data(), buckets.data(), &info, n, 0, policy);
+            });
+         };
+         auto erase = [&](split::execution_policy policy) {
+            return time(fill, [&]() { Hasher::erase(keys.data(), buckets.data(), &info, n, 0, policy); });
+         };
+         auto table = [&](split::execution_policy policy) {
+            return time(nothing, [&]() { Hasher::reset_all(buckets.data(), &info, buckets.size(), 0, policy); });
+         };
+         serial.push_back(lookup(split::execution_policy::serial, false));
+         simd.push_back(SIMD::Lookup<KEY, KEY>::lanes > 0 ? lookup(split::execution_policy::serial, true) : never);
+         threaded.push_back(hasThreads ? lookup(split::execution_policy::parallel, true) : never);
+         insertSerial.push_back(insert(split::execution_policy::serial));
+         insertThreaded.push_back(hasThreads ? insert(split::execution_policy::parallel) : never);
+         eraseSerial.push_back(erase(split::execution_policy::serial));
+         eraseThreaded.push_back(hasThreads ? erase(split::execution_policy::parallel) : never);
+         tableSerial.push_back(table(split::execution_policy::serial));
+         tableThreaded.push_back(hasThreads ? table(split::execution_policy::parallel) : never);
+      }
+      std::vector<double> best(serial.size());
+      for (size_t i = 0; i < serial.size(); i++) {
+         best[i] = std::min(serial[i], simd[i]);
+      }
+      t.simdBatch = crossover(simd, serial, minPower, 0.95);
+      t.threadedBatch = crossover(threaded, best, minPower, 0.9);
+      t.threadedInsert = crossover(insertThreaded, insertSerial, minPower, 0.9);
+      t.threadedErase = crossover(eraseThreaded, eraseSerial, minPower, 0.9);
+      // The tables have twice as many buckets as the batches have elements
+      t.threadedTable = crossover(tableThreaded, tableSerial, minPower + 1, 0.9);
+#else
+      // Clearing a table is the table wide operation with the least setup on either side
+      constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+      using Hasher = Hashers::Hasher<uint32_t, uint32_t, HashFunctions::Fibonacci<uint32_t>, EMPTY, EMPTY - 1>;
+      constexpr int minPower = 10;
+      constexpr int maxPower = 24;
+      Info* info;
+      SPLIT_CHECK_ERR(split_gpuMallocManaged((void**)&info, sizeof(Info)));
+      std::vector<double> host, device;
+      for (int power = minPower; power <= maxPower; power++) {
+         split::SplitVector<hash_pair<uint32_t, uint32_t>> buckets(size_t(1) << power);
+         *info = Info(power);
+         buckets.optimizeCPU();
+         SPLIT_CHECK_ERR(split_gpuDeviceSynchronize());
+         auto start = std::chrono::steady_clock::now();
+         std::fill(buckets.begin(), buckets.end(), hash_pair<uint32_t, uint32_t>(EMPTY, 0));
+         host.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+         buckets.optimizeGPU();
+         SPLIT_CHECK_ERR(split_gpuDeviceSynchronize());
+         start = std::chrono::steady_clock::now();
+         Hasher::reset_all(buckets.data(), info, buckets.size());
+         device.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      }
+      SPLIT_CHECK_ERR(split_gpuFree(info));
+      t.deviceBuckets = crossover(device, host, minPower, 0.9);
+#endif
+      return t;
+   }
+
+private:
+   struct State {
+      std::mutex mutex;
+      bool ready = false;
+      Thresholds thresholds;
+   };
+
+   static State& state() {
+      static State s;
+      return s;
+   }
+
+   // Identifies the setup a cache file was measured with
+   static std::string signature() {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      return "host-threads" + std::to_string(split::host_concurrency()) + "-lanes" +
+             std::to_string(SIMD::Lookup<uint32_t, uint32_t>::lanes);
+#else
+      int device = 0;
+      SPLIT_CHECK_ERR(split_gpuGetDevice(&device));
+      return "device" + std::to_string(device);
+#endif
+   }
+
+   // Smallest size 2^(minPower+i) from which fast[i] < margin * slow[i] holds for every larger size
+   static size_t crossover(const std::vector<double>& fast, const std::vector<double>& slow, int minPower,
+                           double margin) {
+      size_t threshold = std::numeric_limits<size_t>::max();
+      for (size_t i = fast.size(); i-- > 0;) {
+         if (!(fast[i] < margin * slow[i])) {
+            break;
+         }
+         threshold = size_t(1) << (minPower + i);
+      }
+      return threshold;
+   }
+};
+
+#ifdef HASHINATOR_CPU_ONLY_MODE
+/**
+ * @brief Where a host batch call runs: an explicit execution policy or a target.
+ *
+ * targets::host runs serially, targets::device on all host threads (the stand in for the
+ * device in CPU only mode) and targets::automatic picks a host_path from the calibrated
+ * Thresholds of the operation. Batch calls decide on the batch size, table wide work
+ * (host_op::table) on the table size.
+ */
+class HostTarget {
+public:
+   HostTarget(split::execution_policy policy) noexcept : policy(policy), target(targets::host), isPolicy(true) {}
+   HostTarget(targets target) noexcept
+       : policy(split::execution_policy::adaptive), target(target), isPolicy(false) {}
+
+   host_path path(size_t n, host_op op = host_op::lookup) const {
+      if (isPolicy) {
+         return split::runs_parallel(policy, n) ? host_path::threaded : host_path::simd;
+      }
+      switch (target) {
+      case targets::host:
+         return host_path::simd;
+      case targets::device:
+         return host_path::threaded;
+      default:
+         return Calibration::select(n, op);
+      }
+   }
+
+   split::execution_policy execution(size_t n, host_op op = host_op::lookup) const {
+      return path(n, op) == host_path::threaded ? split::execution_policy::parallel : split::execution_policy::serial;
+   }
+
+   bool vectorized(size_t n) const { return path(n) != host_path::serial; }
+
+private:
+   split::execution_policy policy;
+   targets target;
+   bool isPolicy;
+};
+#endif
+
+} // namespace Hashinator
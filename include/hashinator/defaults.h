@@ -30,6 +30,7 @@ constexpr int BUCKET_OVERFLOW = 32;
 constexpr int WARPSIZE = __AMDGCN_WAVEFRONT_SIZE;
 constexpr int BUCKET_OVERFLOW = __AMDGCN_WAVEFRONT_SIZE;
 #else
+constexpr int WARPSIZE = 32;        // width of the host virtual warps
 constexpr int BUCKET_OVERFLOW = 32; // to allow cpu only mode
 #ifndef HASHINATOR_CPU_ONLY_MODE
 #error "Warp size not known, please use a CUDA or HIP compiler."
@@ -37,6 +38,12 @@ constexpr int BUCKET_OVERFLOW = 32; // to allow cpu only mode
 #endif
 constexpr int elementsPerWarp = 1;
 constexpr int MAX_BLOCKSIZE = 1024;
+// Upper bound for the fraction of buckets turned into tombstones by a graveyard rebuild
+constexpr float GRAVEYARD_MAX_TOMBSTONE_RATIO = 0.125;
+// Number of elements kept in the overflow stash before a rehash is forced
+constexpr int STASH_SIZE = 16;
+// Growth factor of tables that are not restricted to power of two capacities
+constexpr float GROWTH_FACTOR = 1.5;
 template <typename T>
 using DefaultHashFunction = HashFunctions::Fibonacci<T>;
 } // namespace defaults
@@ -45,12 +52,14 @@ struct Info {
    Info(){};
    Info(int sz)
        : sizePower(sz), fill(0), currentMaxBucketOverflow(defaults::BUCKET_OVERFLOW), tombstoneCounter(0),
-         err(status::invalid) {}
+         err(status::invalid), stashFill(0), stashHits(0) {}
    int sizePower;
    size_t fill;
    size_t currentMaxBucketOverflow;
    size_t tombstoneCounter;
    status err;
+   size_t stashFill; // Elements currently held in the overflow stash (included in fill)
+   size_t stashHits; // Lookups answered from the overflow stash
 };
 
 } // namespace Hashinator
@@ -2,6 +2,7 @@
  * Authors: Kostis Papadakis, Urs Ganse and Markus Battarbee (2023)
  * Description: Defines parallel hashers that insert,retrieve and
  *               delete elements to/from Hahsinator on device
+ *               or on a host thread pool in CPU only mode
  *
  *
  * This program is free software; you can redistribute it and/or
@@ -23,6 +24,14 @@
 #include "../splitvector/gpu_wrappers.h"
 #include "defaults.h"
 #include "hashfunctions.h"
+#ifdef HASHINATOR_CPU_ONLY_MODE
+#include "../splitvector/archMacros.h"
+#include "../splitvector/split_instrument.h"
+#include "../splitvector/split_pool.h"
+#include "../splitvector/split_trace.h"
+#include "hash_pair.h"
+#include "simd.h"
+#endif
 #ifdef __NVCC__
 #include "kernels_NVIDIA.h"
 #endif
@@ -33,6 +42,7 @@
 namespace Hashinator {
 namespace Hashers {
 
+#ifndef HASHINATOR_CPU_ONLY_MODE
 template <typename KEY_TYPE, typename VAL_TYPE, class HashFunction,
           KEY_TYPE EMPTYBUCKET = std::numeric_limits<KEY_TYPE>::max(), KEY_TYPE TOMBSTONE = EMPTYBUCKET = 1,
           int WARP = defaults::WARPSIZE, int elementsPerWarp = 1>
@@ -170,6 +180,316 @@ private:
       return;
    }
 };
+#else
+/*
+ * Host implementation of the Hasher interface for CPU only builds.
+ * Every element is handled by a host virtual warp of WARP/elementsPerWarp lanes that votes
+ * for buckets and claims them with the host versions of the split:: warp primitives, the
+ * same way the kernels do. Elements are spread over threads according to the execution
+ * policy (see split::parallel_for) and every chunk publishes its fill, overflow and tombstone
+ * counts with one atomic each, like the kernels do once per block. Unlike the device Hasher,
+ * which synchronizes after every launch, the calls only enqueue the work when given a non
+ * null stream.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE, class HashFunction,
+          KEY_TYPE EMPTYBUCKET = std::numeric_limits<KEY_TYPE>::max(), KEY_TYPE TOMBSTONE = EMPTYBUCKET - 1,
+          int WARP = defaults::WARPSIZE, int elementsPerWarp = 1>
+class HostHasher {
+
+   // Make sure we have sane elements per warp
+   static_assert(elementsPerWarp > 0 && elementsPerWarp <= WARP && "Host hasher cannot be instantiated");
+   static constexpr int VIRTUALWARP = WARP / elementsPerWarp;
+   using pair_type = hash_pair<KEY_TYPE, VAL_TYPE>;
+   using policy_type = split::execution_policy;
+
+public:
+   // Overload with separate input for keys and values.
+   static void insert(KEY_TYPE* keys, VAL_TYPE* vals, pair_type* buckets, Hashinator::Info* info, size_t len,
+                      split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         info->err = status::success;
+         insert_all(buckets, info, len, [keys, vals](size_t i) { return pair_type(keys[i], vals[i]); }, policy);
+#ifndef NDEBUG
+         if (info->err == status::fail) {
+            std::cerr << "***** Hashinator Runtime Warning ********" << std::endl;
+            std::cerr << "Warning: Hashmap completely overflown in Host Insert.\nNot all ellements were "
+                         "inserted!\nConsider resizing before calling insert"
+                      << std::endl;
+            std::cerr << "******************************" << std::endl;
+         }
+#endif
+      });
+   }
+
+   // Overload with input for keys only, using the index as the value
+   static void insertIndex(KEY_TYPE* keys, pair_type* buckets, Hashinator::Info* info, size_t len,
+                           split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         info->err = status::success;
+         insert_all(
+             buckets, info, len, [keys](size_t i) { return pair_type(keys[i], static_cast<VAL_TYPE>(i)); }, policy);
+#ifndef NDEBUG
+         if (info->err == status::fail) {
+            std::cerr << "***** Hashinator Runtime Warning ********" << std::endl;
+            std::cerr << "Warning: Hashmap completely overflown in Host InsertIndex.\nNot all elements were "
+                         "inserted!\nConsider resizing before calling insert"
+                      << std::endl;
+            std::cerr << "******************************" << std::endl;
+         }
+#endif
+      });
+   }
+
+   // Overload with hash_pair<key,val> (k,v) inputs
+   static void insert(pair_type* src, pair_type* buckets, Hashinator::Info* info, size_t len,
+                      split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         info->err = status::success;
+         insert_all(buckets, info, len, [src](size_t i) { return src[i]; }, policy);
+#ifndef NDEBUG
+         if (info->err == status::fail) {
+            std::cerr << "***** Hashinator Runtime Warning ********" << std::endl;
+            std::cerr << "Warning: Hashmap completely overflown in Host Insert.\nNot all ellements were "
+                         "inserted!\nConsider resizing before calling insert"
+                      << std::endl;
+            std::cerr << "******************************" << std::endl;
+         }
+#endif
+      });
+   }
+
+   // Retrieve wrapper. Values of keys that are not in the buckets are left untouched.
+   // vectorized selects the SIMD lookup, when there is one for the key and value types.
+   static void retrieve(KEY_TYPE* keys, VAL_TYPE* vals, pair_type* buckets, Hashinator::Info* info, size_t len,
+                        split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive,
+                        bool vectorized = true) {
+      split::host_launch(s, [=]() {
+         const int sizePower = info->sizePower;
+         auto body = [=](size_t begin, size_t end) {
+            SPLIT_TRACE_SCOPE_N("HostHasher::retrieve chunk", end - begin);
+            using Lookup = SIMD::Lookup<KEY_TYPE, VAL_TYPE>;
+            if constexpr (Lookup::lanes > 0) {
+               if (vectorized && (static_cast<size_t>(1) << sizePower) <= Lookup::max_buckets) {
+                  // Hash a block of keys and gather them Lookup::lanes at a time. The misses are keys
+                  // that were not found, so there is nothing left to do for them. Larger tables take
+                  // the scalar probe below.
+                  uint32_t hashes[defaults::MAX_BLOCKSIZE];
+                  uint32_t misses[defaults::MAX_BLOCKSIZE];
+                  for (size_t b = begin; b < end; b += defaults::MAX_BLOCKSIZE) {
+                     const uint32_t n = static_cast<uint32_t>(std::min<size_t>(defaults::MAX_BLOCKSIZE, end - b));
+                     if constexpr (HashFunctions::has_hash_batch<HashFunction, KEY_TYPE>::value) {
+                        HashFunction::_hash_batch(keys + b, hashes, n, sizePower);
+                     } else {
+                        for (uint32_t k = 0; k < n; k++) {
+                           hashes[k] = HashFunction::_hash(keys[b + k], sizePower);
+                        }
+                     }
+                     Lookup::find(buckets, static_cast<size_t>(1) << sizePower, keys + b, hashes, n, vals + b,
+                                  misses, EMPTYBUCKET);
+                  }
+                  return;
+               }
+            }
+            for (size_t i = begin; i < end; i++) {
+               retrieve_element(keys[i], vals[i], buckets, sizePower);
+            }
+         };
+         split::parallel_for(len, grain(len), body, policy);
+      });
+   }
+
+   static void retrieve(pair_type* src, pair_type* buckets, Hashinator::Info* info, size_t len,
+                        split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         const int sizePower = info->sizePower;
+         auto body = [=](size_t begin, size_t end) {
+            SPLIT_TRACE_SCOPE_N("HostHasher::retrieve chunk", end - begin);
+            for (size_t i = begin; i < end; i++) {
+               retrieve_element(src[i].first, src[i].second, buckets, sizePower);
+            }
+         };
+         split::parallel_for(len, grain(len), body, policy);
+      });
+   }
+
+   // Delete wrapper
+   static void erase(KEY_TYPE* keys, pair_type* buckets, Hashinator::Info* info, size_t len,
+                     split_gpuStream_t s = 0, policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         const int sizePower = info->sizePower;
+         auto body = [=](size_t begin, size_t end) {
+            SPLIT_TRACE_SCOPE_N("HostHasher::erase chunk", end - begin);
+            size_t localCount = 0;
+            for (size_t i = begin; i < end; i++) {
+               localCount += erase_element(keys[i], TOMBSTONE, buckets, sizePower);
+            }
+            if (localCount > 0) {
+               split::s_atomicAdd(&(info->tombstoneCounter), localCount);
+            }
+         };
+         split::parallel_for(len, grain(len), body, policy);
+      });
+   }
+
+   // Reset wrapper. Every element of src must be in dst.
+   static void reset(pair_type* src, pair_type* dst, Hashinator::Info* info, size_t len, split_gpuStream_t s = 0,
+                     policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         const int sizePower = info->sizePower;
+         info->fill -= len;
+         auto body = [=](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+               [[maybe_unused]] const bool found = erase_element(src[i].first, EMPTYBUCKET, dst, sizePower);
+               assert(found && "Tried to reset an element that is not in the buckets");
+            }
+         };
+         split::parallel_for(len, grain(len), body, policy);
+      });
+   }
+
+   // Reset wrapper for all elements
+   static void reset_all(pair_type* dst, Hashinator::Info* info, size_t len, split_gpuStream_t s = 0,
+                         policy_type policy = policy_type::adaptive) {
+      split::host_launch(s, [=]() {
+         auto body = [dst](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+               dst[i].first = EMPTYBUCKET;
+            }
+         };
+         split::parallel_for(len, grain(len), body, policy);
+         info->fill = 0;
+      });
+   }
+
+private:
+   // Chunk size for parallel runs: at least a block, and a few chunks per thread to balance the load
+   static size_t grain(size_t len) {
+      return std::max<size_t>(defaults::MAX_BLOCKSIZE, len / (8 * split::host_concurrency()));
+   }
+
+   // Every lane of a host virtual warp reads the key of the bucket it probes
+   static void warp_load(KEY_TYPE* lanes, const pair_type* buckets, const size_t bitMask, const size_t start) {
+      for (int lane = 0; lane < VIRTUALWARP; lane++) {
+         lanes[lane] = __atomic_load_n(&(buckets[(start + lane) & bitMask].first), __ATOMIC_RELAXED);
+      }
+   }
+
+   template <typename Source>
+   static void insert_all(pair_type* buckets, Hashinator::Info* info, size_t len, Source source,
+                          policy_type policy) {
+      const int sizePower = info->sizePower;
+      auto body = [=](size_t begin, size_t end) {
+         SPLIT_TRACE_SCOPE_N("HostHasher::insert chunk", end - begin);
+         size_t localCount = 0;
+         size_t localOverflow = 0;
+         bool done = true;
+         for (size_t i = begin; i < end; i++) {
+            done &= insert_element(source(i), buckets, sizePower, localCount, localOverflow);
+         }
+         if (localCount > 0) {
+            split::s_atomicAdd(&(info->fill), localCount);
+         }
+         if (localOverflow > __atomic_load_n(&(info->currentMaxBucketOverflow), __ATOMIC_RELAXED)) {
+            split::s_atomicMax(&(info->currentMaxBucketOverflow), nextOverflow(localOverflow, VIRTUALWARP));
+         }
+         // Make sure everyone actually made it otherwise raise the error flag.
+         if (!done) {
+            split::s_atomicExch((uint32_t*)&(info->err), (uint32_t)status::fail);
+         }
+      };
+      split::parallel_for(len, grain(len), body, policy);
+   }
+
+   // Returns false if the whole table was probed without finding a place for candidate
+   static bool insert_element(const pair_type& candidate, pair_type* buckets, const int sizePower,
+                              size_t& localCount, size_t& localOverflow) {
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidate.first, sizePower);
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, buckets, bitMask, hashIndex + i);
+
+         // vote for available emptybuckets in warp region
+         // Note that this has to be done before voting for already existing elements (below)
+         auto mask = split::s_warpVote(lanes, EMPTYBUCKET, VIRTUALWARP);
+
+         // Check if this elements already exists
+         const auto already_exists = split::s_warpVote(lanes, candidate.first, VIRTUALWARP);
+         if (already_exists) {
+            const int winner = split::s_findFirstSig(already_exists) - 1;
+            split::s_atomicStore(&(buckets[(hashIndex + i + winner) & bitMask].second), candidate.second);
+            return true;
+         }
+
+         while (mask) {
+            const int winner = split::s_findFirstSig(mask) - 1;
+            const size_t probingindex = (hashIndex + i + winner) & bitMask;
+            KEY_TYPE old = split::s_atomicCAS(&(buckets[probingindex].first), EMPTYBUCKET, candidate.first);
+            if (old == EMPTYBUCKET) {
+               localOverflow = std::max(localOverflow, std::min(i + winner, bitMask + 1) + 1);
+               split::s_atomicStore(&(buckets[probingindex].second), candidate.second);
+               localCount++;
+               return true;
+            } else if (old == candidate.first) {
+               // Parallel stuff are fun. Major edge case!
+               split::s_atomicStore(&(buckets[probingindex].second), candidate.second);
+               return true;
+            }
+            SPLIT_INSTRUMENT_COUNT(cas_failures, 1);
+            mask ^= (1ULL << winner);
+         }
+      }
+      return false;
+   }
+
+   // Probes up to the first empty bucket rather than currentMaxBucketOverflow, so elements that host
+   // side insertions placed further away are found too.
+   static void retrieve_element(const KEY_TYPE& candidateKey, VAL_TYPE& candidateVal, const pair_type* buckets,
+                                const int sizePower) {
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidateKey, sizePower);
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, buckets, bitMask, hashIndex + i);
+         const auto maskExists = split::s_warpVote(lanes, candidateKey, VIRTUALWARP);
+         if (maskExists) {
+            const int winner = split::s_findFirstSig(maskExists) - 1;
+            candidateVal = buckets[(hashIndex + i + winner) & bitMask].second;
+            return;
+         }
+         // If we encountered empty and the key is not in the range of this warp that means the key is not in hashmap.
+         if (split::s_warpVoteAny(lanes, EMPTYBUCKET, VIRTUALWARP)) {
+            return;
+         }
+      }
+   }
+
+   // Replaces candidateKey with marker. Returns true if this call removed it.
+   static bool erase_element(const KEY_TYPE& candidateKey, const KEY_TYPE marker, pair_type* buckets,
+                             const int sizePower) {
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidateKey, sizePower);
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, buckets, bitMask, hashIndex + i);
+         const auto maskExists = split::s_warpVote(lanes, candidateKey, VIRTUALWARP);
+         if (maskExists) {
+            const int winner = split::s_findFirstSig(maskExists) - 1;
+            // Duplicate keys in a batch must only be counted once
+            return split::s_atomicCAS(&(buckets[(hashIndex + i + winner) & bitMask].first), candidateKey, marker) ==
+                   candidateKey;
+         }
+         if (split::s_warpVoteAny(lanes, EMPTYBUCKET, VIRTUALWARP)) {
+            return false;
+         }
+      }
+      return false;
+   }
+};
+#endif
 
 } // namespace Hashers
 } // namespace Hashinator
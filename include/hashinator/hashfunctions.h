@@ -23,6 +23,13 @@
  * */
 #pragma once
 #include "../common.h"
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#if (defined(__AVX2__) || defined(__AVX512F__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#include <immintrin.h>
+#endif
 namespace Hashinator {
 
 namespace HashFunctions {
@@ -80,6 +87,107 @@ struct Fibonacci {
       static_assert(std::is_integral<T>::value, "Hashinator only works for integral types");
       return fibhash(key, sizePower);
    }
+
+   /**
+    * @brief Hashes a batch of keys on the host, equivalent to calling _hash on every key.
+    *
+    * 32-bit keys are hashed eight at a time with AVX2 and 64-bit keys eight at a time
+    * with AVX-512DQ when the compiler targets those instruction sets. The remaining keys
+    * and other targets use the scalar path.
+    *
+    * @param keys The input keys.
+    * @param hashes Output, the 32-bit hash of every key.
+    * @param len Number of keys.
+    * @param sizePower The size power for mixing the keys.
+    */
+   static void _hash_batch(const T* keys, uint32_t* hashes, size_t len, const int sizePower) {
+      static_assert(std::is_integral<T>::value, "Hashinator only works for integral types");
+      size_t i = 0;
+#if defined(__AVX2__) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+      if constexpr (sizeof(T) == sizeof(uint32_t)) {
+         const __m128i shift = _mm_cvtsi32_si128(32 - sizePower);
+         const __m256i golden = _mm256_set1_epi64x(2654435769ull);
+         for (; i + 8 <= len; i += 8) {
+            __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            k = _mm256_xor_si256(k, _mm256_srl_epi32(k, shift));
+            // 32x32->64 bit products of the even and the odd lanes
+            __m256i even = _mm256_srl_epi64(_mm256_mul_epu32(k, golden), shift);
+            __m256i odd = _mm256_srl_epi64(_mm256_mul_epu32(_mm256_srli_epi64(k, 32), golden), shift);
+            const __m256i h = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), h);
+         }
+      }
+#endif
+#if defined(__AVX512F__) && defined(__AVX512DQ__) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+      if constexpr (sizeof(T) == sizeof(uint64_t)) {
+         const __m128i shift = _mm_cvtsi32_si128(64 - sizePower);
+         const __m512i golden = _mm512_set1_epi64(static_cast<long long>(11400714819323198485ull));
+         for (; i + 8 <= len; i += 8) {
+            __m512i k = _mm512_loadu_si512(reinterpret_cast<const void*>(keys + i));
+            k = _mm512_xor_si512(k, _mm512_srl_epi64(k, shift));
+            const __m512i h = _mm512_srl_epi64(_mm512_mullo_epi64(k, golden), shift);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(hashes + i), _mm512_cvtepi64_epi32(h));
+         }
+      }
+#endif
+      for (; i < len; i++) {
+         hashes[i] = static_cast<uint32_t>(_hash(keys[i], sizePower));
+      }
+   }
+
+   /**
+    * @brief Computes the capacity independent 32 hash bits of a key.
+    *
+    * The bits only depend on the key so they can be stored next to an element and
+    * reused by _reduce when the table changes size.
+    *
+    * @param key The input key to be hashed.
+    * @return uint32_t The hash bits.
+    */
+   [[nodiscard]] HOSTDEVICE inline static constexpr uint32_t _hash_bits(T key) {
+      static_assert(std::is_integral<T>::value, "Hashinator only works for integral types");
+      if constexpr (sizeof(T) <= sizeof(uint32_t)) {
+         uint32_t k = static_cast<uint32_t>(key);
+         k ^= k >> 16;
+         return static_cast<uint32_t>(k * 2654435769u);
+      } else {
+         uint64_t k = static_cast<uint64_t>(key);
+         k ^= k >> 32;
+         return static_cast<uint32_t>((k * 11400714819323198485ull) >> 32);
+      }
+   }
+
+   /**
+    * @brief Maps hash bits onto [0, capacity) with Lemire's multiply-high range
+    * reduction, which replaces the modulo (or the power of two bitmask).
+    *
+    * @param bits Hash bits as returned by _hash_bits.
+    * @param capacity The number of buckets, at most 2^32.
+    * @return size_t The bucket index.
+    */
+   [[nodiscard]] HOSTDEVICE inline static constexpr size_t _reduce(uint32_t bits, const size_t capacity) {
+      return static_cast<size_t>((static_cast<uint64_t>(bits) * static_cast<uint64_t>(capacity)) >> 32);
+   }
+
+   /**
+    * @brief Maps a key to a bucket of a table with an arbitrary number of buckets.
+    *
+    * @param key The input key to be hashed.
+    * @param capacity The number of buckets, at most 2^32.
+    * @return size_t The bucket index.
+    */
+   [[nodiscard]] HOSTDEVICE inline static constexpr size_t _hash_range(T key, const size_t capacity) {
+      return _reduce(_hash_bits(key), capacity);
+   }
 };
+
+// Detects hash functions that provide a batched _hash_batch
+template <class HashFunction, typename T, typename = void>
+struct has_hash_batch : std::false_type {};
+
+template <class HashFunction, typename T>
+struct has_hash_batch<HashFunction, T,
+                      std::void_t<decltype(HashFunction::_hash_batch(std::declval<const T*>(), std::declval<uint32_t*>(),
+                                                                     size_t(), int()))>> : std::true_type {};
 } // namespace HashFunctions
 } // namespace Hashinator
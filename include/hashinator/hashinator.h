@@ -25,34 +25,70 @@
 #ifdef HASHINATOR_CPU_ONLY_MODE
 #define SPLIT_CPU_ONLY_MODE
 #endif
+#if defined(HASHINATOR_INSTRUMENT) && !defined(SPLIT_INSTRUMENT)
+#define SPLIT_INSTRUMENT
+#endif
+#if defined(HASHINATOR_TRACE) && !defined(SPLIT_TRACE)
+#define SPLIT_TRACE
+#endif
+#if defined(HASHINATOR_MEMORY_REGISTRY) && !defined(SPLIT_MEMORY_REGISTRY)
+#define SPLIT_MEMORY_REGISTRY
+#endif
+#if defined(HASHINATOR_TRACK_ALLOCATIONS) && !defined(SPLIT_TRACK_ALLOCATIONS)
+#define SPLIT_TRACK_ALLOCATIONS
+#endif
 #include "../common.h"
 #include "../splitvector/gpu_wrappers.h"
 #include "../splitvector/split_allocators.h"
+#include "../splitvector/split_instrument.h"
+#include "../splitvector/split_memory.h"
+#include "../splitvector/split_trace.h"
+#include "../splitvector/split_tracking_allocator.h"
 #include "../splitvector/splitvec.h"
 #include "defaults.h"
 #include "hash_pair.h"
 #include "hashfunctions.h"
+#include "simd.h"
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <future>
 #include <limits>
+#include <memory>
 #include <stdexcept>
-#ifndef HASHINATOR_CPU_ONLY_MODE
-#include "../splitvector/split_tools.h"
+#include <vector>
 #include "hashers.h"
-#endif
+#include "calibration.h"
+#include "latency.h"
+#include "metrics.h"
+#include "workload.h"
+#include "../splitvector/split_pool.h"
+#include "../splitvector/split_tools.h"
 
 namespace Hashinator {
 
 #ifndef HASHINATOR_CPU_ONLY_MODE
+#ifdef SPLIT_TRACK_ALLOCATIONS
+template <typename T>
+using DefaultMetaAllocator = split::tracking_allocator<split::split_unified_allocator<T>>;
+#else
 template <typename T>
 using DefaultMetaAllocator = split::split_unified_allocator<T>;
+#endif
 #define DefaultHasher                                                                                                  \
    Hashers::Hasher<KEY_TYPE, VAL_TYPE, HashFunction, EMPTYBUCKET, TOMBSTONE, defaults::WARPSIZE,                       \
                    defaults::elementsPerWarp>
 #else
+#ifdef SPLIT_TRACK_ALLOCATIONS
+template <typename T>
+using DefaultMetaAllocator = split::tracking_allocator<split::split_host_allocator<T>>;
+#else
 template <typename T>
 using DefaultMetaAllocator = split::split_host_allocator<T>;
-#define DefaultHasher void
+#endif
+#define DefaultHasher                                                                                                  \
+   Hashers::HostHasher<KEY_TYPE, VAL_TYPE, HashFunction, EMPTYBUCKET, TOMBSTONE, defaults::WARPSIZE,                   \
+                       defaults::elementsPerWarp>
 #endif
 
 using MapInfo = Hashinator::Info;
@@ -71,6 +107,16 @@ private:
    split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>> buckets;
    Meta_Allocator _metaAllocator; // Allocator used to allocate and deallocate memory for metadata
    MapInfo* _mapInfo;
+   rehash_policy _rehashPolicy = rehash_policy::standard; // Policy used by host side rehashing
+   size_t _graveyardOps = 0; // Host insertions left until the next graveyard rebuild
+   insertion_policy _insertionPolicy = insertion_policy::linear; // Policy used by host side insertions
+   bool _ordered = false; // Buckets follow the ordered layout, cleared by order unaware writers
+   hash_pair<KEY_TYPE, VAL_TYPE> _stash[defaults::STASH_SIZE]; // Elements that did not fit in the probe window
+#ifdef HASHINATOR_CPU_ONLY_MODE
+   split_gpuStream_t _asyncStream = nullptr; // Orders the *_async batches, created on first use
+   std::unique_ptr<WorkloadRecorder<KEY_TYPE, VAL_TYPE>> _workload; // Set while the operations are recorded
+#endif
+   std::unique_ptr<LatencyRecorder> _latency; // Set while latency recording is enabled
    //~Host members
 
    // Wrapper over available hash functions
@@ -107,6 +153,43 @@ private:
    HASHINATOR_HOSTDEVICE
    inline void set_status(status code) noexcept { _mapInfo->err = code; }
 
+   // Records a single key lookup that visited n buckets. Empty unless built with HASHINATOR_INSTRUMENT.
+   HASHINATOR_HOSTDEVICE
+   static inline void count_lookup([[maybe_unused]] size_t n) noexcept {
+      SPLIT_INSTRUMENT_COUNT(lookups, 1);
+      SPLIT_INSTRUMENT_COUNT(probes, n);
+   }
+
+   // Adds the map to the registry of live containers, when it is compiled in. Its buckets are counted with it.
+   void track_memory() {
+      split::memory::track(this, split::memory::kind::hashmap,
+                           [](const void* map) { return static_cast<const Hashmap*>(map)->memory_usage(); });
+      split::memory::adopt(&buckets, split::memory::kind::vector);
+   }
+
+   // Times one host operation if latency recording is enabled
+   LatencyRecorder::Sample latency_sample(latency_op op) const { return LatencyRecorder::Sample(_latency.get(), op); }
+
+   // Appends a single key operation to the workload file, if one is being recorded
+   void record_op([[maybe_unused]] workload_op op, [[maybe_unused]] const KEY_TYPE& key) const {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      if (_workload) {
+         _workload->record(op, key);
+      }
+#endif
+   }
+
+#ifdef HASHINATOR_CPU_ONLY_MODE
+   // Finishes the outstanding *_async batches and destroys their stream
+   void release_async_stream() {
+      if (_asyncStream == nullptr) {
+         return;
+      }
+      SPLIT_CHECK_ERR(split_gpuStreamDestroy(_asyncStream));
+      _asyncStream = nullptr;
+   }
+#endif
+
 public:
    Hashmap() {
       preallocate_device_handles();
@@ -117,6 +200,7 @@ public:
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
+      track_memory();
    };
 
    Hashmap(int sizepower) {
@@ -128,34 +212,67 @@ public:
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
+      track_memory();
    };
 
-   Hashmap(const Hashmap<KEY_TYPE, VAL_TYPE>& other) {
+   Hashmap(const Hashmap& other) {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      other.wait_all();
+#endif
       preallocate_device_handles();
       _mapInfo = _metaAllocator.allocate(1);
       *_mapInfo = *(other._mapInfo);
       buckets = other.buckets;
+      _rehashPolicy = other._rehashPolicy;
+      _graveyardOps = other._graveyardOps;
+      _insertionPolicy = other._insertionPolicy;
+      _ordered = other._ordered;
+      std::copy(other._stash, other._stash + defaults::STASH_SIZE, _stash);
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
+      track_memory();
    };
 
-   Hashmap(Hashmap<KEY_TYPE, VAL_TYPE>&& other) {
+   Hashmap(Hashmap&& other) {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      // Batches still queued on other refer to it, not to this map
+      other.wait_all();
+#endif
       preallocate_device_handles();
       _mapInfo = other._mapInfo;
       other._mapInfo = nullptr;
       buckets = std::move(other.buckets);
+      _latency = std::move(other._latency);
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      _workload = std::move(other._workload);
+#endif
+      _rehashPolicy = other._rehashPolicy;
+      _graveyardOps = other._graveyardOps;
+      _insertionPolicy = other._insertionPolicy;
+      _ordered = other._ordered;
+      std::copy(other._stash, other._stash + defaults::STASH_SIZE, _stash);
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
+      track_memory();
    };
 
-   Hashmap& operator=(const Hashmap<KEY_TYPE, VAL_TYPE>& other) {
+   Hashmap& operator=(const Hashmap& other) {
       if (this == &other) {
          return *this;
       }
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      wait_all();
+      other.wait_all();
+#endif
       *_mapInfo = *(other._mapInfo);
       buckets = other.buckets;
+      _rehashPolicy = other._rehashPolicy;
+      _graveyardOps = other._graveyardOps;
+      _insertionPolicy = other._insertionPolicy;
+      _ordered = other._ordered;
+      std::copy(other._stash, other._stash + defaults::STASH_SIZE, _stash);
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
@@ -164,7 +281,7 @@ public:
 
 #ifndef HASHINATOR_CPU_ONLY_MODE
    /** Copy assign but using a provided stream */
-   void overwrite(const Hashmap<KEY_TYPE, VAL_TYPE>& other, split_gpuStream_t stream = 0) {
+   void overwrite(const Hashmap& other, split_gpuStream_t stream = 0) {
       if (this == &other) {
          return;
       }
@@ -176,14 +293,27 @@ public:
    }
 #endif
 
-   Hashmap& operator=(Hashmap<KEY_TYPE, VAL_TYPE>&& other) {
+   Hashmap& operator=(Hashmap&& other) {
       if (this == &other) {
          return *this;
       }
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      wait_all();
+      other.wait_all();
+#endif
       _metaAllocator.deallocate(_mapInfo, 1);
       _mapInfo = other._mapInfo;
       other._mapInfo = nullptr;
       buckets = std::move(other.buckets);
+      _latency = std::move(other._latency);
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      _workload = std::move(other._workload);
+#endif
+      _rehashPolicy = other._rehashPolicy;
+      _graveyardOps = other._graveyardOps;
+      _insertionPolicy = other._insertionPolicy;
+      _ordered = other._ordered;
+      std::copy(other._stash, other._stash + defaults::STASH_SIZE, _stash);
 #ifndef HASHINATOR_CPU_ONLY_MODE
       SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
 #endif
@@ -191,6 +321,10 @@ public:
    }
 
    ~Hashmap() {
+      split::memory::untrack(this, split::memory::kind::hashmap);
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      release_async_stream();
+#endif
       deallocate_device_handles();
       _metaAllocator.deallocate(_mapInfo, 1);
    };
@@ -239,40 +373,60 @@ public:
       if (newSizePower > 32) {
          throw std::out_of_range("Hashmap ran into rehashing catastrophe and exceeded 32bit buckets.");
       }
+      SPLIT_INSTRUMENT_COUNT(rehashes, 1);
+      SPLIT_INSTRUMENT_TIME(rehash_ns);
+      SPLIT_TRACE_SCOPE_N("Hashmap::rehash", size_t(1) << newSizePower);
+      auto sample = latency_sample(latency_op::rehash);
+      if (_rehashPolicy == rehash_policy::graveyard || _insertionPolicy == insertion_policy::ordered) {
+         return ordered_rehash(newSizePower);
+      }
       split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>> newBuckets(
           1 << newSizePower, hash_pair<KEY_TYPE, VAL_TYPE>(EMPTYBUCKET, VAL_TYPE()));
+      hash_pair<KEY_TYPE, VAL_TYPE> newStash[defaults::STASH_SIZE];
+      size_t newStashFill = 0;
       _mapInfo->sizePower = newSizePower;
       int bitMask = (1 << _mapInfo->sizePower) - 1; // For efficient modulo of the array size
 
       // Iterate through all old elements and rehash them into the new array.
-      for (auto& e : buckets) {
-         // Skip empty buckets ; We also check for TOMBSTONE elements
-         // as we might be coming off a kernel that overflew the hashmap
-         if (e.first == EMPTYBUCKET || e.first == TOMBSTONE) {
-            continue;
-         }
-
+      auto place = [&](const hash_pair<KEY_TYPE, VAL_TYPE>& e) -> bool {
          uint32_t newHash = hash(e.first);
-         bool found = false;
          for (int i = 0; i < Hashinator::defaults::BUCKET_OVERFLOW; i++) {
             hash_pair<KEY_TYPE, VAL_TYPE>& candidate = newBuckets[(newHash + i) & bitMask];
             if (candidate.first == EMPTYBUCKET) {
                // Found an empty bucket, assign that one.
                candidate = e;
-               found = true;
-               break;
+               return true;
             }
          }
-
-         if (!found) {
+         // Overflowed the probe window, so park the element in the stash if there is room
+         if (newStashFill < defaults::STASH_SIZE) {
+            newStash[newStashFill++] = e;
+            return true;
+         }
+         return false;
+      };
+      for (auto& e : buckets) {
+         // Skip empty buckets ; We also check for TOMBSTONE elements
+         // as we might be coming off a kernel that overflew the hashmap
+         if (e.first == EMPTYBUCKET || e.first == TOMBSTONE) {
+            continue;
+         }
+         if (!place(e)) {
             // Having arrived here means that we unsuccessfully rehashed and
             // are *still* overflowing our buckets. So we need to try again with a bigger one.
             return rehash(newSizePower + 1);
          }
       }
+      for (size_t i = 0; i < _mapInfo->stashFill; i++) {
+         if (!place(_stash[i])) {
+            return rehash(newSizePower + 1);
+         }
+      }
 
       // Replace our buckets with the new ones
       buckets = newBuckets;
+      std::copy(newStash, newStash + newStashFill, _stash);
+      _mapInfo->stashFill = newStashFill;
       _mapInfo->currentMaxBucketOverflow = Hashinator::defaults::BUCKET_OVERFLOW;
       _mapInfo->tombstoneCounter = 0;
 #ifndef HASHINATOR_CPU_ONLY_MODE
@@ -280,6 +434,384 @@ public:
 #endif
    }
 
+#ifdef HASHINATOR_CPU_ONLY_MODE
+   // Rebuilds the buckets the way device_rehash does: the valid elements are extracted and then
+   // inserted again by the host hasher, both on the threads target picks for the table size.
+   // Serial runs and the graveyard and ordered policies, whose layout the hasher does not keep,
+   // fall back to the rehash above.
+   void rehash(int newSizePower, HostTarget target) {
+      const split::execution_policy policy = target.execution(buckets.size(), host_op::table);
+      if (policy == split::execution_policy::serial || _rehashPolicy == rehash_policy::graveyard ||
+          _insertionPolicy == insertion_policy::ordered) {
+         return rehash(newSizePower);
+      }
+      if (newSizePower > 32) {
+         throw std::out_of_range("Hashmap ran into rehashing catastrophe and exceeded 32bit buckets.");
+      }
+      SPLIT_INSTRUMENT_COUNT(rehashes, 1);
+      SPLIT_INSTRUMENT_TIME(rehash_ns);
+      SPLIT_TRACE_SCOPE_N("Hashmap::rehash", size_t(1) << newSizePower);
+      auto sample = latency_sample(latency_op::rehash);
+      flush_stash();
+      const size_t priorFill = _mapInfo->fill;
+      const size_t stashHits = _mapInfo->stashHits;
+      auto isValidKey = [](const hash_pair<KEY_TYPE, VAL_TYPE>& element) {
+         return element.first != TOMBSTONE && element.first != EMPTYBUCKET;
+      };
+      split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>> validElements;
+      split::tools::copy_if<hash_pair<KEY_TYPE, VAL_TYPE>, decltype(isValidKey), defaults::MAX_BLOCKSIZE>(
+          buckets, validElements, isValidKey, policy);
+      assert(validElements.size() == priorFill && "Something really bad happened during rehashing! Ask Kostis!");
+
+      buckets = split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>(
+          1 << newSizePower, hash_pair<KEY_TYPE, VAL_TYPE>(EMPTYBUCKET, VAL_TYPE()));
+      *_mapInfo = Info(newSizePower);
+      _mapInfo->stashHits = stashHits;
+      DeviceHasher::insert(validElements.data(), buckets.data(), _mapInfo, validElements.size(), 0, policy);
+      set_status((priorFill == _mapInfo->fill) ? status::success : status::fail);
+   }
+#endif
+
+   // Selects the policy used by host side rehashing. Switching to the graveyard
+   // policy schedules a rebuild on the next cleanup.
+   void set_rehash_policy(rehash_policy policy) noexcept {
+      _rehashPolicy = policy;
+      _graveyardOps = 0;
+   }
+
+   rehash_policy get_rehash_policy() const noexcept { return _rehashPolicy; }
+
+   // Selects the policy used by host side insertions. Switching to the ordered policy
+   // rebuilds the table in order. Ordered tables do not use tombstones so the graveyard
+   // policy has no effect on them. Host batch insertions and erasures insert and erase one key at a time
+   // on ordered tables. The warp accessors and the device side are not order aware: after them lookups
+   // probe the whole cluster until the next host insertion or cleanup rebuilds the ordered layout.
+   void set_insertion_policy(insertion_policy policy) {
+      _insertionPolicy = policy;
+      _ordered = false;
+      if (policy == insertion_policy::ordered) {
+         rehash(_mapInfo->sizePower);
+      }
+   }
+
+   insertion_policy get_insertion_policy() const noexcept { return _insertionPolicy; }
+
+private:
+   /**
+    * Rebuilds the table with 1<<newSizePower buckets, laying elements out in the order of their
+    * home buckets. Used by the graveyard rehash policy and the ordered insertion policy.
+    *
+    * Graveyard hashing (Bender, Kuszmaul & Kuszmaul 2021): evenly spaced tombstones are interleaved
+    * with the elements. A table with load factor 1-1/x gets n/(2x) tombstones, which later
+    * insertions reuse, and is rebuilt again after n/(4x) insertions. This keeps the expected
+    * insertion probe length at O(x) instead of O(x^2) under churn.
+    *
+    * Ordered linear probing (Amble & Knuth 1974): elements sharing a home bucket are additionally
+    * sorted by key and no tombstones are placed.
+    *
+    * The ordered layout minimizes the largest displacement so no overflow window is enforced
+    * here; instead the actual overflow is recorded for the device kernels.
+    *
+    * Elements are scattered straight into the new bucket array, so the peak transient memory is
+    * the old and new bucket arrays plus one size_t per new bucket for the group offsets.
+    */
+   void ordered_rehash(int newSizePower) {
+      const size_t len = size_t(1) << newSizePower;
+      const size_t bitMask = len - 1; // For efficient modulo of the array size
+      const float lf = (float)_mapInfo->fill / len;
+      size_t nTombstones = 0;
+      if (_rehashPolicy == rehash_policy::graveyard && _insertionPolicy == insertion_policy::linear) {
+         nTombstones = std::min(0.5f * (1.0f - lf), defaults::GRAVEYARD_MAX_TOMBSTONE_RATIO) * static_cast<float>(len);
+      }
+      const size_t stride = (nTombstones > 0) ? len / nTombstones : len;
+
+      // Count the valid elements and the graveyard tombstones of every home bucket
+      _mapInfo->sizePower = newSizePower;
+      auto valid = [](const hash_pair<KEY_TYPE, VAL_TYPE>& e) {
+         return e.first != EMPTYBUCKET && e.first != TOMBSTONE;
+      };
+      std::vector<size_t> offsets(len, 0);
+      for (const auto& e : buckets) {
+         if (valid(e)) {
+            offsets[hash(e.first) & bitMask]++;
+         }
+      }
+      // The ordered layout has no probe window, so stashed elements move back into the table
+      for (size_t i = 0; i < _mapInfo->stashFill; i++) {
+         offsets[hash(_stash[i].first) & bitMask]++;
+      }
+      for (size_t k = 0; k < nTombstones; k++) {
+         offsets[k * stride]++;
+      }
+
+      // Entries are laid out in the order of their homes, each group starting no earlier than
+      // its home. The cluster running past the last bucket wraps around to the first buckets and
+      // has to precede everything placed there. Find how many buckets it spills into.
+      size_t spill = 0;
+      for (;;) {
+         size_t pos = spill;
+         for (size_t h = 0; h < len; h++) {
+            if (offsets[h] > 0) {
+               pos = std::max(pos, h) + offsets[h];
+            }
+         }
+         const size_t newSpill = (pos > len) ? pos - len : 0;
+         if (newSpill <= spill) {
+            break;
+         }
+         spill = newSpill;
+      }
+
+      // Turn the counts into the position of the first entry of every home. Positions are not
+      // wrapped so that they also measure the displacement.
+      size_t maxOverflow = 1;
+      size_t pos = spill;
+      for (size_t h = 0; h < len; h++) {
+         const size_t count = offsets[h];
+         offsets[h] = std::max(pos, h);
+         if (count > 0) {
+            maxOverflow = std::max(maxOverflow, offsets[h] + count - h);
+            pos = offsets[h] + count;
+         }
+      }
+
+      // Scatter straight into the new buckets; afterwards offsets[h] marks the end of the group of h
+      split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>> newBuckets(
+          len, hash_pair<KEY_TYPE, VAL_TYPE>(EMPTYBUCKET, VAL_TYPE()));
+      for (const auto& e : buckets) {
+         if (valid(e)) {
+            newBuckets[offsets[hash(e.first) & bitMask]++ & bitMask] = e;
+         }
+      }
+      for (size_t i = 0; i < _mapInfo->stashFill; i++) {
+         newBuckets[offsets[hash(_stash[i].first) & bitMask]++ & bitMask] = _stash[i];
+      }
+      _mapInfo->stashFill = 0;
+      for (size_t k = 0; k < nTombstones; k++) {
+         newBuckets[offsets[k * stride]++ & bitMask] = hash_pair<KEY_TYPE, VAL_TYPE>(TOMBSTONE, VAL_TYPE());
+      }
+      buckets = std::move(newBuckets);
+
+      // Ordered tables keep every group sorted by key. Only the group that wraps around is split.
+      if (_insertionPolicy == insertion_policy::ordered) {
+         auto byKey = [](const auto& a, const auto& b) { return a.first < b.first; };
+         std::vector<hash_pair<KEY_TYPE, VAL_TYPE>> wrapped;
+         pos = spill;
+         for (size_t h = 0; h < len; h++) {
+            const size_t first = std::max(pos, h);
+            const size_t last = offsets[h];
+            if (last <= first) {
+               continue;
+            }
+            pos = last;
+            if (last - first < 2) {
+               continue;
+            }
+            if ((first & bitMask) < ((last - 1) & bitMask)) {
+               std::sort(buckets.data() + (first & bitMask), buckets.data() + ((last - 1) & bitMask) + 1, byKey);
+               continue;
+            }
+            wrapped.clear();
+            for (size_t i = first; i < last; i++) {
+               wrapped.push_back(buckets[i & bitMask]);
+            }
+            std::sort(wrapped.begin(), wrapped.end(), byKey);
+            for (size_t i = first; i < last; i++) {
+               buckets[i & bitMask] = wrapped[i - first];
+            }
+         }
+      }
+
+      _mapInfo->tombstoneCounter = nTombstones;
+      _mapInfo->currentMaxBucketOverflow = Hashinator::defaults::BUCKET_OVERFLOW;
+#ifndef HASHINATOR_CPU_ONLY_MODE
+      // Device retrieval and erasure only scan currentMaxBucketOverflow buckets
+      _mapInfo->currentMaxBucketOverflow =
+          std::max(_mapInfo->currentMaxBucketOverflow, nextOverflow(maxOverflow, defaults::WARPSIZE));
+#endif
+      // Never rebuild more often than every BUCKET_OVERFLOW insertions
+      _graveyardOps = std::max(nTombstones / 2, static_cast<size_t>(Hashinator::defaults::BUCKET_OVERFLOW));
+      _ordered = (_insertionPolicy == insertion_policy::ordered);
+#ifndef HASHINATOR_CPU_ONLY_MODE
+      SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
+#endif
+   }
+
+   // Distance of the element stored at index from its home bucket
+   inline size_t displacement(size_t index) const noexcept {
+      const size_t bitMask = buckets.size() - 1;
+      return (index - hash(buckets[index].first)) & bitMask;
+   }
+
+   // Ordered lookups may only stop early while no order unaware writer touched the buckets
+   inline bool ordered_layout() const noexcept {
+      return _insertionPolicy == insertion_policy::ordered && _ordered;
+   }
+
+   inline bool ordered_rebuild_due() const noexcept {
+      return _insertionPolicy == insertion_policy::ordered && !_ordered;
+   }
+
+   // Called by the order unaware writers, possibly from several host threads at once
+   inline void mark_unordered() noexcept {
+      if (__atomic_load_n(&_ordered, __ATOMIC_RELAXED)) {
+         __atomic_store_n(&_ordered, false, __ATOMIC_RELAXED);
+      }
+   }
+
+   // Ordered lookup. Returns the index of key or bucket_count() if it is not in the table.
+   size_t ordered_find(const KEY_TYPE& key, const size_t hashIndex) const {
+      const int sizePower = _mapInfo->sizePower;
+      const size_t bitMask = (1 << sizePower) - 1; // For efficient modulo of the array size
+      const size_t bsize = buckets.size();
+      const hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+      for (size_t i = 0; i < bsize; i++) {
+         const size_t index = (hashIndex + i) & bitMask;
+         const hash_pair<KEY_TYPE, VAL_TYPE>& candidate = data[index];
+         if (candidate.first == key) {
+            count_lookup(i + 1);
+            return index;
+         }
+         if (candidate.first == EMPTYBUCKET) {
+            count_lookup(i + 1);
+            return bsize;
+         }
+         // Stop once we pass the position the key would occupy
+         const size_t d = (index - HashFunction::_hash(candidate.first, sizePower)) & bitMask;
+         if (d < i || (d == i && key < candidate.first)) {
+            count_lookup(i + 1);
+            return bsize;
+         }
+      }
+      count_lookup(bsize);
+      return bsize;
+   }
+
+   // Ordered insertion. Shifts the tail of the cluster to make room for key in its sorted position.
+   VAL_TYPE& ordered_at(const KEY_TYPE& key, const size_t hashIndex) {
+      const size_t bitMask = buckets.size() - 1; // For efficient modulo of the array size
+      const size_t bsize = buckets.size();
+      for (size_t i = 0; i < bsize; i++) {
+         const size_t index = (hashIndex + i) & bitMask;
+         hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[index];
+         if (candidate.first == key) {
+            count_lookup(i + 1);
+            return candidate.second;
+         }
+         if (candidate.first != EMPTYBUCKET) {
+            const size_t d = displacement(index);
+            if (d > i || (d == i && candidate.first < key)) {
+               continue;
+            }
+         }
+         count_lookup(i + 1);
+         // key belongs here. Find the end of the cluster and shift everything in between.
+         size_t last = index;
+         while (buckets[last].first != EMPTYBUCKET) {
+            last = (last + 1) & bitMask;
+            if (last == index) {
+               break;
+            }
+         }
+         if (buckets[last].first != EMPTYBUCKET) {
+            break;
+         }
+         for (; last != index; last = (last - 1) & bitMask) {
+            buckets[last] = buckets[(last - 1) & bitMask];
+         }
+         candidate = hash_pair<KEY_TYPE, VAL_TYPE>(key, VAL_TYPE());
+         _mapInfo->fill++;
+         return candidate.second;
+      }
+      // No free slots left
+      rehash(_mapInfo->sizePower + 1);
+      return ordered_at(key, hash(key));
+   }
+
+   // Ordered erasure. Shifts the following elements back instead of leaving a tombstone.
+   void ordered_erase(size_t index) {
+      const size_t bitMask = buckets.size() - 1; // For efficient modulo of the array size
+      size_t hole = index;
+      for (size_t next = (hole + 1) & bitMask; next != index; next = (next + 1) & bitMask) {
+         if (buckets[next].first == EMPTYBUCKET || displacement(next) == 0) {
+            break;
+         }
+         buckets[hole] = buckets[next];
+         hole = next;
+      }
+      buckets[hole].first = EMPTYBUCKET;
+      _mapInfo->fill--;
+   }
+
+   // Counts a host side insertion towards the next graveyard rebuild
+   inline void graveyard_tick() noexcept {
+      if (_graveyardOps > 0) {
+         _graveyardOps--;
+      }
+   }
+
+   inline bool graveyard_rebuild_due() const noexcept {
+      return _rehashPolicy == rehash_policy::graveyard && _insertionPolicy == insertion_policy::linear &&
+             _graveyardOps == 0;
+   }
+
+   // Host insertions past the probe window go to the stash. The graveyard and ordered
+   // layouts have no probe window of their own so they never stash.
+   inline bool stash_enabled() const noexcept {
+      return _rehashPolicy == rehash_policy::standard && _insertionPolicy == insertion_policy::linear;
+   }
+
+   // Stash slot of key or defaults::STASH_SIZE if the key is not stashed
+   size_t stash_find(const KEY_TYPE& key) const noexcept {
+      for (size_t i = 0; i < _mapInfo->stashFill; i++) {
+         if (_stash[i].first == key) {
+            _mapInfo->stashHits++;
+            return i;
+         }
+      }
+      return defaults::STASH_SIZE;
+   }
+
+   // Iterator index of the element in stash slot i. Stashed elements follow end() so that
+   // bucket indices stay valid.
+   inline size_t stash_to_index(size_t i) const noexcept { return buckets.size() + 1 + i; }
+
+   // Removes the element in stash slot i, keeping the stash compact
+   void stash_erase(size_t i) noexcept {
+      _stash[i] = _stash[--_mapInfo->stashFill];
+      _mapInfo->fill--;
+   }
+
+public:
+   // The device kernels and the warp accessors do not search the stash so its elements are moved
+   // back into the buckets before any of them runs, widening the probe window if needed.
+   void flush_stash() {
+      if (_mapInfo->stashFill == 0) {
+         return;
+      }
+      const size_t bitMask = buckets.size() - 1;
+      for (size_t s = 0; s < _mapInfo->stashFill; s++) {
+         const auto hashIndex = hash(_stash[s].first);
+         for (size_t i = 0; i < buckets.size(); i++) {
+            hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[(hashIndex + i) & bitMask];
+            if (candidate.first == EMPTYBUCKET || candidate.first == TOMBSTONE) {
+               if (candidate.first == TOMBSTONE) {
+                  _mapInfo->tombstoneCounter--;
+               }
+               candidate = _stash[s];
+               if (i + 1 > _mapInfo->currentMaxBucketOverflow) {
+                  _mapInfo->currentMaxBucketOverflow = nextOverflow(i + 1, defaults::WARPSIZE);
+               }
+               break;
+            }
+         }
+      }
+      _mapInfo->stashFill = 0;
+#ifndef HASHINATOR_CPU_ONLY_MODE
+      SPLIT_CHECK_ERR(split_gpuMemcpy(device_map, this, sizeof(Hashmap), split_gpuMemcpyHostToDevice));
+#endif
+   }
+
 #ifndef HASHINATOR_CPU_ONLY_MODE
    // Resize the table to fit more things. This is automatically invoked once
    // maxBucketOverflow has triggered. This can only be done on host (so far)
@@ -288,7 +820,12 @@ public:
       if (newSizePower > 32) {
          throw std::out_of_range("Hashmap ran into rehashing catastrophe and exceeded 32bit buckets.");
       }
+      SPLIT_INSTRUMENT_COUNT(rehashes, 1);
+      SPLIT_INSTRUMENT_TIME(rehash_ns);
+      SPLIT_TRACE_SCOPE_N("Hashmap::rehash", size_t(1) << newSizePower);
+      auto sample = latency_sample(latency_op::rehash);
 
+      flush_stash();
       size_t priorFill = _mapInfo->fill;
       // Extract all valid elements
       hash_pair<KEY_TYPE, VAL_TYPE>* validElements;
@@ -338,31 +875,79 @@ public:
    }
 #endif
 
+   // Advances probe step i past the buckets that hold other keys, SIMD::Probe::width buckets at a time.
+   // Returns at the first bucket the scalar probe has to look at or where the vector load would wrap around.
+   size_t probe_skip(const KEY_TYPE& key, const size_t hashIndex, size_t i, const bool stopOnTombstone) const {
+      using Probe = SIMD::Probe<KEY_TYPE, VAL_TYPE>;
+      if constexpr (Probe::width > 0) {
+         const size_t bsize = buckets.size();
+         const hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+         for (size_t index = (hashIndex + i) & (bsize - 1); index + Probe::width <= bsize; index += Probe::width) {
+            const size_t skipped = Probe::skip(data + index, key, EMPTYBUCKET, TOMBSTONE, stopOnTombstone);
+            i += skipped;
+            if (skipped < Probe::width) {
+               break;
+            }
+         }
+      }
+      return i;
+   }
+
    // Element access (by reference). Nonexistent elements get created.
-   VAL_TYPE& _at(const KEY_TYPE& key) {
+   VAL_TYPE& _at(const KEY_TYPE& key) { return _at(key, hash(key)); }
+
+   // As _at(key) but with the hash of key already computed
+   VAL_TYPE& _at(const KEY_TYPE& key, const uint32_t hashIndex) {
+      if (_insertionPolicy == insertion_policy::ordered) {
+         if (!_ordered) {
+            rehash(_mapInfo->sizePower);
+         }
+         return ordered_at(key, hashIndex);
+      }
+      if (_mapInfo->stashFill > 0) {
+         const size_t slot = stash_find(key);
+         if (slot < defaults::STASH_SIZE) {
+            return _stash[slot].second;
+         }
+      }
       int bitMask = (1 << _mapInfo->sizePower) - 1; // For efficient modulo of the array size
-      auto hashIndex = hash(key);
+      const bool useStash = stash_enabled();
 
       // Try to find the matching bucket.
       const size_t bsize = buckets.size();
-      for (size_t i = 0; i < bsize; i++) {
+      for (size_t i = probe_skip(key, hashIndex, 0, true); i < bsize; i = probe_skip(key, hashIndex, i + 1, true)) {
 
          hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[(hashIndex + i) & bitMask];
 
          if (candidate.first == key) {
             // Found a match, return that
+            count_lookup(i + 1);
             return candidate.second;
          }
 
          if (candidate.first == EMPTYBUCKET) {
+            count_lookup(i + 1);
+            if (useStash && i >= _mapInfo->currentMaxBucketOverflow) {
+               // Past the probe window. Stash the key instead of lengthening every later lookup.
+               if (_mapInfo->stashFill == defaults::STASH_SIZE) {
+                  break;
+               }
+               hash_pair<KEY_TYPE, VAL_TYPE>& stashed = _stash[_mapInfo->stashFill++];
+               stashed = hash_pair<KEY_TYPE, VAL_TYPE>(key, VAL_TYPE());
+               _mapInfo->fill++;
+               return stashed.second;
+            }
             // Found an empty bucket, assign and return that.
             candidate.first = key;
             _mapInfo->fill++;
+            graveyard_tick();
             return candidate.second;
          }
 
-         if (candidate.first == TOMBSTONE) {
+         if (candidate.first == TOMBSTONE && !(useStash && i >= _mapInfo->currentMaxBucketOverflow)) {
             bool alreadyExists = false;
+            count_lookup(i + 1);
+            SPLIT_INSTRUMENT_COUNT(tombstone_reuses, 1);
 
             // We remove this Tombstone
             candidate.first = key;
@@ -374,6 +959,10 @@ public:
             const size_t bsize = buckets.size();
             for (size_t j = i + 1; j < bsize; ++j) {
                hash_pair<KEY_TYPE, VAL_TYPE>& duplicate = buckets[(hashIndex + j) & bitMask];
+               if (duplicate.first == EMPTYBUCKET) {
+                  // Keys never live past the end of their cluster
+                  break;
+               }
                if (duplicate.first == candidate.first) {
                   alreadyExists = true;
                   candidate.second = duplicate.second;
@@ -389,27 +978,37 @@ public:
             }
             if (!alreadyExists) {
                _mapInfo->fill++;
+               graveyard_tick();
             }
             return candidate.second;
          }
       }
 
-      // Not found, and we have no free slots to create a new one. So we need to rehash to a larger size.
+      // Not found, and we have no free slots (or stash slots) to create a new one. So we need to rehash to a larger
+      // size.
 #ifdef HASHINATOR_CPU_ONLY_MODE
       rehash(_mapInfo->sizePower + 1);
 #else
       device_rehash(_mapInfo->sizePower + 1);
       assert(peek_status() == status::success);
 #endif
-      return at(key); // Recursive tail call to try again with larger table.
+      return _at(key); // Recursive tail call to try again with larger table.
    }
 
    const VAL_TYPE& _at(const KEY_TYPE& key) const {
+      if (ordered_layout()) {
+         const size_t index = ordered_find(key, hash(key));
+         if (index == buckets.size()) {
+            throw std::out_of_range("Element not found in Hashmap.at");
+         }
+         return buckets[index].second;
+      }
       int bitMask = (1 << _mapInfo->sizePower) - 1; // For efficient modulo of the array size
       auto hashIndex = hash(key);
 
       // Try to find the matching bucket.
-      for (size_t i = 0; i < _mapInfo->currentMaxBucketOverflow; i++) {
+      const size_t bsize = buckets.size();
+      for (size_t i = probe_skip(key, hashIndex, 0, false); i < bsize; i = probe_skip(key, hashIndex, i + 1, false)) {
          const hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[(hashIndex + i) & bitMask];
 
          if (candidate.first == TOMBSTONE) {
@@ -418,13 +1017,18 @@ public:
 
          if (candidate.first == key) {
             // Found a match, return that
+            count_lookup(i + 1);
             return candidate.second;
          }
          if (candidate.first == EMPTYBUCKET) {
-            // Found an empty bucket, so error.
-            throw std::out_of_range("Element not found in Hashmap.at");
+            count_lookup(i + 1);
+            break;
          }
       }
+      const size_t slot = (_mapInfo->stashFill > 0) ? stash_find(key) : defaults::STASH_SIZE;
+      if (slot < defaults::STASH_SIZE) {
+         return _stash[slot].second;
+      }
 
       // Not found, so error.
       throw std::out_of_range("Element not found in Hashmap.at");
@@ -494,6 +1098,7 @@ public:
    void clear() {
       buckets = split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>(1 << _mapInfo->sizePower, {EMPTYBUCKET, VAL_TYPE()});
       *_mapInfo = MapInfo(_mapInfo->sizePower);
+      _graveyardOps = 0;
       return;
    }
 #else
@@ -504,6 +1109,7 @@ public:
          buckets =
              split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>(1 << _mapInfo->sizePower, {EMPTYBUCKET, VAL_TYPE()});
          *_mapInfo = MapInfo(_mapInfo->sizePower);
+         _graveyardOps = 0;
          break;
 
       case targets::device:
@@ -513,12 +1119,17 @@ public:
          if (len == 0) { // If size is provided, no need to page fault size information.
             len = buckets.size();
          }
+         _mapInfo->stashFill = 0;
          DeviceHasher::reset_all(buckets.data(), _mapInfo, len, s);
 #ifdef HASHINATOR_DEBUG
          set_status((_mapInfo->fill == 0) ? success : fail);
 #endif
          break;
 
+      case targets::automatic:
+         clear<prefetches>(Calibration::select_target(buckets.size()), s, len);
+         break;
+
       default:
          clear(targets::host);
          break;
@@ -529,9 +1140,9 @@ public:
 
 #ifdef HASHINATOR_CPU_ONLY_MODE
    // Try to grow our buckets until we achieve a targetLF load factor
-   void resize_to_lf(float targetLF = 0.5) {
+   void resize_to_lf(float targetLF = 0.5, HostTarget target = split::execution_policy::serial) {
       while (load_factor() > targetLF) {
-         rehash(_mapInfo->sizePower + 1);
+         rehash(_mapInfo->sizePower + 1, target);
       }
    }
 #else
@@ -545,6 +1156,9 @@ public:
          case targets::device:
             device_rehash(_mapInfo->sizePower + 1, s);
             break;
+         case targets::automatic:
+            resize(_mapInfo->sizePower + 1, Calibration::select_target(buckets.size()), s);
+            break;
          default:
             std::cerr << "Defaulting to host rehashing" << std::endl;
             resize(_mapInfo->sizePower + 1, targets::host);
@@ -556,7 +1170,9 @@ public:
 #endif
 
 #ifdef HASHINATOR_CPU_ONLY_MODE
-   void resize(int newSizePower) { rehash(newSizePower); }
+   void resize(int newSizePower, HostTarget target = split::execution_policy::serial) {
+      rehash(newSizePower, target);
+   }
 #else
    void resize(int newSizePower, targets t = targets::host, split_gpuStream_t s = 0) {
       switch (t) {
@@ -566,6 +1182,9 @@ public:
       case targets::device:
          device_rehash(newSizePower, s);
          break;
+      case targets::automatic:
+         resize(newSizePower, Calibration::select_target(std::max(buckets.size(), size_t(1) << newSizePower)), s);
+         break;
       default:
          std::cerr << "Defaulting to host rehashing" << std::endl;
          resize(newSizePower, targets::host);
@@ -581,8 +1200,7 @@ public:
       const size_t hashIndex = HashFunction::_hash(i.first, currentSizePower);
       const int bitMask = (1 << (currentSizePower)) - 1;
       size_t optimalIndex = hashIndex & bitMask;
-      const_iterator it = find(i.first);
-      int64_t overflow = llabs(it.getIndex() - optimalIndex);
+      int64_t overflow = llabs(find_index(i.first, hashIndex) - optimalIndex);
       if (i.first == TOMBSTONE) {
          printf("[╀] ");
       } else if (i.first == EMPTYBUCKET) {
@@ -608,13 +1226,123 @@ public:
    }
 
    HASHINATOR_HOSTDEVICE
-   void stats() const {
-      printf("Hashinator Stats \n");
-      printf("Bucket size= %lu\n", buckets.size());
-      printf("Fill= %lu, LoadFactor=%f \n", _mapInfo->fill, load_factor());
-      printf("Tombstones= %lu\n", _mapInfo->tombstoneCounter);
-      printf("Overflow= %lu\n", _mapInfo->currentMaxBucketOverflow);
-   }
+   void stats() const {
+      printf("Hashinator Stats \n");
+      printf("Bucket size= %lu\n", buckets.size());
+      printf("Fill= %lu, LoadFactor=%f \n", _mapInfo->fill, load_factor());
+      printf("Tombstones= %lu\n", _mapInfo->tombstoneCounter);
+      printf("Overflow= %lu\n", _mapInfo->currentMaxBucketOverflow);
+      printf("Stash= %lu/%d, StashHits= %lu\n", _mapInfo->stashFill, defaults::STASH_SIZE, _mapInfo->stashHits);
+   }
+
+   /**
+    * @brief Starts recording the latencies of the host operations of this map.
+    *
+    * One in sampleEvery finds, insertions, erasures and cleanups per thread is timed, every
+    * rehash is; latency() gives the histograms. Copies of the map do not inherit the recorder.
+    */
+   void enable_latency_recording(size_t sampleEvery = 64) {
+      _latency = std::make_unique<LatencyRecorder>(sampleEvery);
+   }
+
+   void disable_latency_recording() noexcept { _latency.reset(); }
+
+   // The recorder, or nullptr while latency recording is disabled
+   const LatencyRecorder* latency() const noexcept { return _latency.get(); }
+
+   /**
+    * @brief Structured version of stats(), for monitoring and for deciding when to resize or
+    * clean up. Once the work enqueued on s has finished the buckets are scanned in blocks on
+    * host threads as picked by policy.
+    */
+   Metrics metrics(split_gpuStream_t s = 0, split::execution_policy policy = split::execution_policy::adaptive) const {
+      SPLIT_CHECK_ERR(split_gpuStreamSynchronize(s));
+      const size_t n = buckets.size();
+      const size_t mask = n - 1;
+      const int sizePower = _mapInfo->sizePower;
+      const hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+      const size_t grain = std::max<size_t>(defaults::MAX_BLOCKSIZE, n / (8 * split::host_concurrency()));
+      std::vector<MetricsBlock> blocks(n / grain + (n % grain != 0));
+      split::parallel_for(
+          n, grain,
+          [&](size_t begin, size_t end) {
+             for (size_t c = begin / grain; c * grain < end; c++) {
+                MetricsBlock& block = blocks[c];
+                for (size_t i = c * grain; i < std::min(end, (c + 1) * grain); i++) {
+                   const KEY_TYPE key = data[i].first;
+                   if (key != EMPTYBUCKET && key != TOMBSTONE) {
+                      block.add_probe((i - HashFunction::_hash(key, sizePower)) & mask);
+                   }
+                   block.add_bucket(key != EMPTYBUCKET);
+                }
+             }
+          },
+          policy);
+      MetricsBlock total;
+      for (const auto& block : blocks) {
+         total.append(block);
+      }
+      total.close();
+
+      Metrics m;
+      m.fill = _mapInfo->fill;
+      m.capacity = n;
+      m.loadFactor = load_factor();
+      m.tombstones = _mapInfo->tombstoneCounter;
+      m.stashFill = _mapInfo->stashFill;
+      m.stashHits = _mapInfo->stashHits;
+      m.overflowWindow = _mapInfo->currentMaxBucketOverflow;
+      m.bytes = memory_usage().total();
+      m.probeHistogram = std::move(total.probes);
+      size_t elements = 0;
+      double probeSum = 0.0;
+      for (size_t d = 0; d < m.probeHistogram.size(); d++) {
+         elements += m.probeHistogram[d];
+         probeSum += static_cast<double>(d) * m.probeHistogram[d];
+      }
+      m.maxProbe = m.probeHistogram.empty() ? 0 : m.probeHistogram.size() - 1;
+      m.meanProbe = elements > 0 ? probeSum / elements : 0.0;
+      m.clusters = total.clusters;
+      m.maxCluster = total.maxCluster;
+      m.meanCluster = total.clusters > 0 ? static_cast<double>(total.clusterBuckets) / total.clusters : 0.0;
+      m.emptyRuns = std::move(total.emptyRuns);
+      m.maxEmptyRun = total.maxEmptyRun;
+      return m;
+   }
+
+   /**
+    * @brief Bytes allocated by the map, for the state reached by the work enqueued so far.
+    *
+    * Buckets holding elements are the payload; empty buckets and tombstones are slack. The
+    * map info, the bookkeeping of the bucket vector, the device handles and the recorders
+    * enabled on the map are overhead. The stash lives inside the map object and is not counted.
+    */
+   split::MemoryUsage memory_usage() const {
+      split::MemoryUsage usage = buckets.memory_usage();
+      if (_mapInfo == nullptr) {
+         return usage;
+      }
+      const size_t bucketBytes = usage.payload;
+      const size_t held = std::min<size_t>(_mapInfo->fill - _mapInfo->stashFill, buckets.size());
+      usage.payload = held * sizeof(hash_pair<KEY_TYPE, VAL_TYPE>);
+      usage.slack += bucketBytes - usage.payload;
+      usage.overhead += sizeof(MapInfo);
+#ifndef HASHINATOR_CPU_ONLY_MODE
+      usage.overhead += (device_map != nullptr) ? sizeof(Hashmap) : 0;
+#else
+      usage.overhead += _workload ? sizeof(WorkloadRecorder<KEY_TYPE, VAL_TYPE>) : 0;
+#endif
+      usage.overhead += _latency ? sizeof(LatencyRecorder) : 0;
+      return usage;
+   }
+
+   // Number of elements held in the overflow stash
+   HASHINATOR_HOSTDEVICE
+   size_t stash_size() const { return _mapInfo->stashFill; }
+
+   // Number of lookups answered from the overflow stash
+   HASHINATOR_HOSTDEVICE
+   size_t stash_hits() const { return _mapInfo->stashHits; }
 
    HASHINATOR_HOSTDEVICE
    size_t tombstone_count() const { return _mapInfo->tombstoneCounter; }
@@ -628,9 +1356,22 @@ public:
       return (float)_mapInfo->tombstoneCounter / (float)buckets.size();
    }
 
-   void swap(Hashmap<KEY_TYPE, VAL_TYPE>& other) noexcept {
+   void swap(Hashmap& other) noexcept {
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      wait_all();
+      other.wait_all();
+#endif
       buckets.swap(other.buckets);
       std::swap(_mapInfo, other._mapInfo);
+      std::swap(_rehashPolicy, other._rehashPolicy);
+      std::swap(_graveyardOps, other._graveyardOps);
+      std::swap(_insertionPolicy, other._insertionPolicy);
+      std::swap(_ordered, other._ordered);
+      std::swap(_stash, other._stash);
+      std::swap(_latency, other._latency);
+#ifdef HASHINATOR_CPU_ONLY_MODE
+      std::swap(_workload, other._workload);
+#endif
       std::swap(device_map, other.device_map);
       std::swap(device_buckets, other.device_buckets);
    }
@@ -638,11 +1379,14 @@ public:
 #ifdef HASHINATOR_CPU_ONLY_MODE
    // Try to get the overflow back to the original one
    void performCleanupTasks() {
+      SPLIT_INSTRUMENT_COUNT(cleanups, 1);
+      SPLIT_TRACE_SCOPE("Hashmap::performCleanupTasks");
+      auto sample = latency_sample(latency_op::cleanup);
       while (_mapInfo->currentMaxBucketOverflow > Hashinator::defaults::BUCKET_OVERFLOW) {
          rehash(_mapInfo->sizePower + 1);
       }
       // When operating in CPU only mode we rehash to get rid of tombstones
-      if (tombstone_ratio() > 0.25) {
+      if (tombstone_ratio() > 0.25 || graveyard_rebuild_due() || ordered_rebuild_due()) {
          rehash(_mapInfo->sizePower);
       }
    }
@@ -650,7 +1394,16 @@ public:
    // Try to get the overflow back to the original one
    template <bool prefetches = true>
    void performCleanupTasks(split_gpuStream_t s = 0) {
-      if (tombstone_ratio() > 0.025) {
+      SPLIT_INSTRUMENT_COUNT(cleanups, 1);
+      SPLIT_TRACE_SCOPE("Hashmap::performCleanupTasks");
+      auto sample = latency_sample(latency_op::cleanup);
+      if (_rehashPolicy == rehash_policy::graveyard || _insertionPolicy == insertion_policy::ordered) {
+         // Graveyard tombstones are kept around on purpose until the next rebuild, ordered tables
+         // are rebuilt after order unaware writers
+         if (tombstone_ratio() > 0.25 || graveyard_rebuild_due() || ordered_rebuild_due()) {
+            rehash(_mapInfo->sizePower);
+         }
+      } else if (tombstone_ratio() > 0.025) {
          clean_tombstones<prefetches>(s);
       }
       while (_mapInfo->currentMaxBucketOverflow > Hashinator::defaults::BUCKET_OVERFLOW) {
@@ -668,8 +1421,15 @@ public:
 
    // See _at(key)
    VAL_TYPE& at(const KEY_TYPE& key) {
+      record_op(workload_op::access, key);
+      auto sample = latency_sample(latency_op::insert_new);
       performCleanupTasks();
-      return _at(key);
+      const size_t priorFill = _mapInfo->fill;
+      VAL_TYPE& val = _at(key);
+      if (_mapInfo->fill == priorFill) {
+         sample.set(latency_op::insert_update);
+      }
+      return val;
    }
 
    // Typical array-like access with [] operator
@@ -679,21 +1439,41 @@ public:
    }
 
    // Iterator type. Iterates through all non-empty buckets.
+private:
+   // Host iterators walk the buckets and then the stash, whose elements use the indices after end()
+   hash_pair<KEY_TYPE, VAL_TYPE>& element(size_t index) {
+      return (index <= buckets.size()) ? buckets[index] : _stash[index - buckets.size() - 1];
+   }
+
+   const hash_pair<KEY_TYPE, VAL_TYPE>& element(size_t index) const {
+      return (index <= buckets.size()) ? buckets[index] : _stash[index - buckets.size() - 1];
+   }
+
+   size_t next_index(size_t index) const {
+      if (index > buckets.size()) {
+         index++;
+         return (index < stash_to_index(_mapInfo->stashFill)) ? index : buckets.size();
+      }
+      index++;
+      while (index < buckets.size()) {
+         if (buckets[index].first != EMPTYBUCKET && buckets[index].first != TOMBSTONE) {
+            return index;
+         }
+         index++;
+      }
+      return (_mapInfo->stashFill > 0) ? stash_to_index(0) : buckets.size();
+   }
+
+public:
    class iterator {
-      Hashmap<KEY_TYPE, VAL_TYPE>* hashtable;
+      Hashmap* hashtable;
       size_t index;
 
    public:
-      iterator(Hashmap<KEY_TYPE, VAL_TYPE>& hashtable, size_t index) : hashtable(&hashtable), index(index) {}
+      iterator(Hashmap& hashtable, size_t index) : hashtable(&hashtable), index(index) {}
 
       iterator& operator++() {
-         index++;
-         while (index < hashtable->buckets.size()) {
-            if (hashtable->buckets[index].first != EMPTYBUCKET && hashtable->buckets[index].first != TOMBSTONE) {
-               break;
-            }
-            index++;
-         }
+         index = hashtable->next_index(index);
          return *this;
       }
 
@@ -702,33 +1482,24 @@ public:
          ++(*this);
          return temp;
       }
-      bool operator==(iterator other) const {
-         return &hashtable->buckets[index] == &other.hashtable->buckets[other.index];
-      }
-      bool operator!=(iterator other) const {
-         return &hashtable->buckets[index] != &other.hashtable->buckets[other.index];
-      }
-      hash_pair<KEY_TYPE, VAL_TYPE>& operator*() const { return hashtable->buckets[index]; }
-      hash_pair<KEY_TYPE, VAL_TYPE>* operator->() const { return &hashtable->buckets[index]; }
+      // Stashed elements use indices past the buckets, so compare positions instead of addresses
+      bool operator==(iterator other) const { return hashtable == other.hashtable && index == other.index; }
+      bool operator!=(iterator other) const { return !(*this == other); }
+      hash_pair<KEY_TYPE, VAL_TYPE>& operator*() const { return hashtable->element(index); }
+      hash_pair<KEY_TYPE, VAL_TYPE>* operator->() const { return &hashtable->element(index); }
       size_t getIndex() { return index; }
    };
 
    // Const iterator.
    class const_iterator {
-      const Hashmap<KEY_TYPE, VAL_TYPE>* hashtable;
+      const Hashmap* hashtable;
       size_t index;
 
    public:
-      explicit const_iterator(const Hashmap<KEY_TYPE, VAL_TYPE>& hashtable, size_t index)
+      explicit const_iterator(const Hashmap& hashtable, size_t index)
           : hashtable(&hashtable), index(index) {}
       const_iterator& operator++() {
-         index++;
-         while (index < hashtable->buckets.size()) {
-            if (hashtable->buckets[index].first != EMPTYBUCKET && hashtable->buckets[index].first != TOMBSTONE) {
-               break;
-            }
-            index++;
-         }
+         index = hashtable->next_index(index);
          return *this;
       }
       const_iterator operator++(int) { // Postfix version
@@ -736,25 +1507,24 @@ public:
          ++(*this);
          return temp;
       }
-      bool operator==(const_iterator other) const {
-         return &hashtable->buckets[index] == &other.hashtable->buckets[other.index];
-      }
-      bool operator!=(const_iterator other) const {
-         return &hashtable->buckets[index] != &other.hashtable->buckets[other.index];
-      }
-      const hash_pair<KEY_TYPE, VAL_TYPE>& operator*() const { return hashtable->buckets[index]; }
-      const hash_pair<KEY_TYPE, VAL_TYPE>* operator->() const { return &hashtable->buckets[index]; }
+      bool operator==(const_iterator other) const { return hashtable == other.hashtable && index == other.index; }
+      bool operator!=(const_iterator other) const { return !(*this == other); }
+      const hash_pair<KEY_TYPE, VAL_TYPE>& operator*() const { return hashtable->element(index); }
+      const hash_pair<KEY_TYPE, VAL_TYPE>* operator->() const { return &hashtable->element(index); }
       size_t getIndex() { return index; }
    };
 
-   // Element access by iterator
-   const const_iterator find(KEY_TYPE key) const {
+private:
+   // Index of key for the host iterators or end() if it is not in the table
+   size_t find_index(const KEY_TYPE& key, const uint32_t hashIndex) const {
+      if (ordered_layout()) {
+         return ordered_find(key, hashIndex);
+      }
       int bitMask = (1 << _mapInfo->sizePower) - 1; // For efficient modulo of the array size
-      auto hashIndex = hash(key);
 
       // Try to find the matching bucket.
       const size_t bsize = buckets.size();
-      for (size_t i = 0; i < bsize; i++) {
+      for (size_t i = probe_skip(key, hashIndex, 0, false); i < bsize; i = probe_skip(key, hashIndex, i + 1, false)) {
          const hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[(hashIndex + i) & bitMask];
 
          if (candidate.first == TOMBSTONE) {
@@ -763,46 +1533,113 @@ public:
 
          if (candidate.first == key) {
             // Found a match, return that
-            return const_iterator(*this, (hashIndex + i) & bitMask);
+            count_lookup(i + 1);
+            return (hashIndex + i) & bitMask;
          }
 
          if (candidate.first == EMPTYBUCKET) {
-            // Found an empty bucket. Return empty.
-            return end();
+            count_lookup(i + 1);
+            break;
          }
       }
 
-      // Not found
-      return end();
+      // Not in the buckets, the last place to look is the stash
+      const size_t slot = (_mapInfo->stashFill > 0) ? stash_find(key) : defaults::STASH_SIZE;
+      if (slot < defaults::STASH_SIZE) {
+         return stash_to_index(slot);
+      }
+      return buckets.size();
+   }
+
+public:
+   // Element access by iterator
+   const const_iterator find(KEY_TYPE key) const {
+      record_op(workload_op::find, key);
+      auto sample = latency_sample(latency_op::find_hit);
+      const size_t index = find_index(key, hash(key));
+      if (index == buckets.size()) {
+         sample.set(latency_op::find_miss);
+      }
+      return const_iterator(*this, index);
    }
 
    iterator find(KEY_TYPE key) {
+      record_op(workload_op::find, key);
+      auto sample = latency_sample(latency_op::find_hit);
       performCleanupTasks();
-      int bitMask = (1 << _mapInfo->sizePower) - 1; // For efficient modulo of the array size
-      auto hashIndex = hash(key);
-
-      // Try to find the matching bucket.
-      const size_t bsize = buckets.size();
-      for (size_t i = 0; i < bsize; i++) {
-         const hash_pair<KEY_TYPE, VAL_TYPE>& candidate = buckets[(hashIndex + i) & bitMask];
+      const size_t index = find_index(key, hash(key));
+      if (index == buckets.size()) {
+         sample.set(latency_op::find_miss);
+      }
+      return iterator(*this, index);
+   }
 
-         if (candidate.first == TOMBSTONE) {
-            continue;
+   /**
+    * Two phase API for key sets that are looked up, inserted or erased more than once.
+    * hash_batch() hashes all keys up front (vectorized when the hash function supports it)
+    * and the *_hashed calls reuse those hashes instead of hashing again.
+    *
+    * Hashes depend on the bucket count and are only valid until the table is resized.
+    * The *_hashed calls do not run cleanup tasks so they never resize the table themselves,
+    * except for insert_hashed, which rewrites the whole hashes array whenever it had to grow.
+    */
+   void hash_batch(const KEY_TYPE* keys, uint32_t* hashes, size_t len) const {
+      if constexpr (HashFunctions::has_hash_batch<HashFunction, KEY_TYPE>::value) {
+         HashFunction::_hash_batch(keys, hashes, len, _mapInfo->sizePower);
+      } else {
+         for (size_t i = 0; i < len; i++) {
+            hashes[i] = hash(keys[i]);
          }
+      }
+   }
 
-         if (candidate.first == key) {
-            // Found a match, return that
-            return iterator(*this, (hashIndex + i) & bitMask);
+   const const_iterator find_hashed(const KEY_TYPE& key, uint32_t keyHash) const {
+      return const_iterator(*this, find_index(key, keyHash));
+   }
+
+   iterator find_hashed(const KEY_TYPE& key, uint32_t keyHash) { return iterator(*this, find_index(key, keyHash)); }
+
+   // Inserts or overwrites key. Returns true if the key was not in the table before.
+   bool insert_hashed(const KEY_TYPE& key, const VAL_TYPE& val, uint32_t keyHash) {
+      const size_t priorFill = _mapInfo->fill;
+      _at(key, keyHash) = val;
+      return _mapInfo->fill > priorFill;
+   }
+
+   size_t erase_hashed(const KEY_TYPE& key, uint32_t keyHash) {
+      iterator element = find_hashed(key, keyHash);
+      if (element == end()) {
+         return 0;
+      }
+      erase(element);
+      return 1;
+   }
+
+   // Batched versions of the above. Values of missing keys are left untouched by retrieve_hashed.
+   void retrieve_hashed(const KEY_TYPE* keys, const uint32_t* hashes, VAL_TYPE* vals, size_t len) const {
+      for (size_t i = 0; i < len; i++) {
+         const size_t index = find_index(keys[i], hashes[i]);
+         if (index != buckets.size()) {
+            vals[i] = element(index).second;
          }
+      }
+   }
 
-         if (candidate.first == EMPTYBUCKET) {
-            // Found an empty bucket. Return empty.
-            return end();
+   void insert_hashed(const KEY_TYPE* keys, const VAL_TYPE* vals, uint32_t* hashes, size_t len) {
+      for (size_t i = 0; i < len; i++) {
+         const int sizePower = _mapInfo->sizePower;
+         _at(keys[i], hashes[i]) = vals[i];
+         if (_mapInfo->sizePower != sizePower) {
+            // The table grew so every hash is stale, refresh them to keep the caller's array usable
+            hash_batch(keys, hashes, len);
          }
       }
+   }
 
-      // Not found
-      return end();
+   void erase_hashed(const KEY_TYPE* keys, const uint32_t* hashes, size_t len) {
+      for (size_t i = 0; i < len; i++) {
+         erase_hashed(keys[i], hashes[i]);
+      }
    }
 
    iterator begin() {
@@ -811,7 +1648,7 @@ public:
             return iterator(*this, i);
          }
       }
-      return end();
+      return (_mapInfo->stashFill > 0) ? iterator(*this, stash_to_index(0)) : end();
    }
 
    const_iterator begin() const {
@@ -820,7 +1657,7 @@ public:
             return const_iterator(*this, i);
          }
       }
-      return end();
+      return (_mapInfo->stashFill > 0) ? const_iterator(*this, stash_to_index(0)) : end();
    }
 
    iterator end() { return iterator(*this, buckets.size()); }
@@ -830,6 +1667,18 @@ public:
    // Remove one element from the hash table.
    iterator erase(iterator keyPos) {
       size_t index = keyPos.getIndex();
+      if (index > buckets.size()) {
+         // The last stashed element moves into the freed slot
+         const size_t slot = index - stash_to_index(0);
+         stash_erase(slot);
+         return (slot < _mapInfo->stashFill) ? iterator(*this, index) : end();
+      }
+      if (ordered_layout() && index < buckets.size() && buckets[index].first != EMPTYBUCKET) {
+         // The next element may have been shifted into this bucket
+         ordered_erase(index);
+         iterator next(*this, index);
+         return (buckets[index].first == EMPTYBUCKET) ? ++next : next;
+      }
       if (buckets[index].first != EMPTYBUCKET && buckets[index].first != TOMBSTONE) {
          buckets[index].first = TOMBSTONE;
          _mapInfo->fill--;
@@ -841,15 +1690,23 @@ public:
    }
 
    hash_pair<iterator, bool> insert(hash_pair<KEY_TYPE, VAL_TYPE> newEntry) {
-      bool found = find(newEntry.first) != end();
-      if (!found) {
-         at(newEntry.first) = newEntry.second;
+      record_op(workload_op::access, newEntry.first);
+      auto sample = latency_sample(latency_op::insert_new);
+      performCleanupTasks();
+      bool found = find_index(newEntry.first, hash(newEntry.first)) != buckets.size();
+      if (found) {
+         sample.set(latency_op::insert_update);
+      } else {
+         _at(newEntry.first) = newEntry.second;
       }
-      return hash_pair<iterator, bool>(find(newEntry.first), !found);
+      return hash_pair<iterator, bool>(iterator(*this, find_index(newEntry.first, hash(newEntry.first))), !found);
    }
 
    size_t erase(const KEY_TYPE& key) {
-      iterator element = find(key);
+      record_op(workload_op::erase, key);
+      auto sample = latency_sample(latency_op::erase);
+      performCleanupTasks();
+      iterator element(*this, find_index(key, hash(key)));
       if (element == end()) {
          return 0;
       } else {
@@ -858,6 +1715,141 @@ public:
       }
    }
 
+#ifdef HASHINATOR_CPU_ONLY_MODE
+   /*
+    * Host versions of the virtual warp accessors below. One call runs a whole virtual warp
+    * of defaults::WARPSIZE/elementsPerWarp lanes: every lane loads the bucket it probes,
+    * the warp votes on the lanes with split::s_warpVote and the first winner found with
+    * split::s_findFirstSig claims the bucket with the same atomics, so host threads may
+    * insert, find and erase concurrently just like warps do.
+    * As on the device, elements parked in the stash are not seen; call flush_stash() first.
+    */
+   template <bool skipOverWrites = false, int elementsPerWarp = defaults::elementsPerWarp>
+   void warpInsert(const KEY_TYPE& candidateKey, const VAL_TYPE& candidateVal) noexcept {
+      warpInsert_V<skipOverWrites, elementsPerWarp>(candidateKey, candidateVal);
+   }
+
+   template <bool skipOverWrites = false, int elementsPerWarp = defaults::elementsPerWarp>
+   bool warpInsert_V(const KEY_TYPE& candidateKey, const VAL_TYPE& candidateVal) noexcept {
+      constexpr int VIRTUALWARP = defaults::WARPSIZE / elementsPerWarp;
+      const int sizePower = _mapInfo->sizePower;
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidateKey, sizePower);
+      hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, VIRTUALWARP, hashIndex + i);
+
+         // vote for available emptybuckets in warp region
+         // Note that this has to be done before voting for already existing elements (below)
+         auto mask = split::s_warpVote(lanes, EMPTYBUCKET, VIRTUALWARP);
+
+         // Check if this elements already exists
+         const auto already_exists = split::s_warpVote(lanes, candidateKey, VIRTUALWARP);
+         if (already_exists) {
+            const int winner = split::s_findFirstSig(already_exists) - 1;
+            if constexpr (!skipOverWrites) {
+               split::s_atomicStore(&(data[(hashIndex + i + winner) & bitMask].second), candidateVal);
+            }
+            return false;
+         }
+
+         while (mask) {
+            const int winner = split::s_findFirstSig(mask) - 1;
+            const size_t probingindex = (hashIndex + i + winner) & bitMask;
+            KEY_TYPE old = split::s_atomicCAS(&(data[probingindex].first), EMPTYBUCKET, candidateKey);
+            if (old == EMPTYBUCKET) {
+               const size_t threadOverflow = std::min(i + winner, bitMask + 1) + 1;
+               split::s_atomicStore(&(data[probingindex].second), candidateVal);
+               split::s_atomicAdd(&(_mapInfo->fill), 1);
+               mark_unordered();
+               // Minor optimization to get rid of some unnecessary atomic calls
+               if (threadOverflow > __atomic_load_n(&(_mapInfo->currentMaxBucketOverflow), __ATOMIC_RELAXED)) {
+                  split::s_atomicMax(&(_mapInfo->currentMaxBucketOverflow),
+                                     nextOverflow(threadOverflow, VIRTUALWARP));
+               }
+               return true;
+            } else if (old == candidateKey) {
+               // Parallel insertion already added this key.
+               if constexpr (!skipOverWrites) {
+                  split::s_atomicStore(&(data[probingindex].second), candidateVal);
+               }
+               return false;
+            } // else some other key+value was written here.
+            SPLIT_INSTRUMENT_COUNT(cas_failures, 1);
+            mask ^= (1ULL << winner);
+         }
+      }
+      return false;
+   }
+
+   // Leaves candidateVal untouched if candidateKey is not in the buckets
+   template <int elementsPerWarp = defaults::elementsPerWarp>
+   void warpFind(const KEY_TYPE& candidateKey, VAL_TYPE& candidateVal) const noexcept {
+      constexpr int VIRTUALWARP = defaults::WARPSIZE / elementsPerWarp;
+      const int sizePower = _mapInfo->sizePower;
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidateKey, sizePower);
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, VIRTUALWARP, hashIndex + i);
+         const auto maskExists = split::s_warpVote(lanes, candidateKey, VIRTUALWARP);
+         if (maskExists) {
+            const int winner = split::s_findFirstSig(maskExists) - 1;
+            candidateVal = buckets.data()[(hashIndex + i + winner) & bitMask].second;
+            return;
+         }
+         // If we encountered empty and the key is not in the range of this warp that means the key is not in hashmap.
+         if (split::s_warpVoteAny(lanes, EMPTYBUCKET, VIRTUALWARP)) {
+            return;
+         }
+      }
+   }
+
+   template <int elementsPerWarp = defaults::elementsPerWarp>
+   void warpErase(const KEY_TYPE& candidateKey) noexcept {
+      constexpr int VIRTUALWARP = defaults::WARPSIZE / elementsPerWarp;
+      const int sizePower = _mapInfo->sizePower;
+      const size_t bitMask = (size_t(1) << sizePower) - 1;
+      const auto hashIndex = HashFunction::_hash(candidateKey, sizePower);
+      hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+      KEY_TYPE lanes[VIRTUALWARP];
+
+      for (size_t i = 0; i < (size_t(1) << sizePower); i += VIRTUALWARP) {
+         warp_load(lanes, VIRTUALWARP, hashIndex + i);
+         const auto maskExists = split::s_warpVote(lanes, candidateKey, VIRTUALWARP);
+         if (maskExists) {
+            const int winner = split::s_findFirstSig(maskExists) - 1;
+            KEY_TYPE old =
+                split::s_atomicCAS(&(data[(hashIndex + i + winner) & bitMask].first), candidateKey, TOMBSTONE);
+            if (old == candidateKey) {
+               split::s_atomicSub(&(_mapInfo->fill), 1);
+               split::s_atomicAdd(&(_mapInfo->tombstoneCounter), 1);
+               mark_unordered();
+            }
+            return;
+         }
+         if (split::s_warpVoteAny(lanes, EMPTYBUCKET, VIRTUALWARP)) {
+            return;
+         }
+      }
+   }
+
+private:
+   // Every lane of a host virtual warp reads the key of the bucket it probes
+   void warp_load(KEY_TYPE* lanes, const int width, const size_t start) const noexcept {
+      const hash_pair<KEY_TYPE, VAL_TYPE>* data = buckets.data();
+      const size_t bitMask = buckets.size() - 1;
+      for (int lane = 0; lane < width; lane++) {
+         lanes[lane] = __atomic_load_n(&(data[(start + lane) & bitMask].first), __ATOMIC_RELAXED);
+      }
+   }
+
+public:
+#endif
+
 #ifndef HASHINATOR_CPU_ONLY_MODE
    template <bool skipOverWrites = false>
    HASHINATOR_DEVICEONLY void warpInsert(const KEY_TYPE& candidateKey, const VAL_TYPE& candidateVal,
@@ -1163,6 +2155,7 @@ public:
    template <bool prefetches = true, typename Rule>
    size_t extractPattern(split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>& elements, Rule rule,
                          split_gpuStream_t s = 0) {
+      SPLIT_TRACE_SCOPE_N("Hashmap::extractPattern", buckets.size());
       elements.resize(_mapInfo->fill + 1, true);
       if constexpr (prefetches) {
          elements.optimizeGPU(s);
@@ -1175,6 +2168,7 @@ public:
 
    template <typename Rule, int BLOCKSIZE = 1024>
    size_t extractPattern(hash_pair<KEY_TYPE, VAL_TYPE>* elements, Rule rule, split_gpuStream_t s = 0) {
+      SPLIT_TRACE_SCOPE_N("Hashmap::extractPattern", buckets.size());
       // Extract elements matching the Pattern Rule(element)==true;
 
       // Figure out Blocks to use
@@ -1270,6 +2264,7 @@ public:
 
    template <bool prefetches = true>
    void clean_tombstones(split_gpuStream_t s = 0) {
+      SPLIT_TRACE_SCOPE_N("Hashmap::clean_tombstones", _mapInfo->tombstoneCounter);
 
       if (_mapInfo->tombstoneCounter == 0) {
          return;
@@ -1327,6 +2322,7 @@ public:
    // Uses Hasher's insert_kernel to insert all elements
    template <bool prefetches = true>
    void insert(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0) {
+      flush_stash();
       // Here we do some calculations to estimate how much if any we need to grow our buckets
       // TODO fix these if paths or at least annotate them .
       if (len == 0) {
@@ -1341,12 +2337,14 @@ public:
          resize(neededPowerSize, targets::device, s);
       }
       DeviceHasher::insert(keys, vals, buckets.data(), _mapInfo, len, s);
+      mark_unordered();
       return;
    }
 
    // Uses Hasher's insert_index_kernel to insert all elements, with the index as the value
    template <bool prefetches = true>
    void insertIndex(KEY_TYPE* keys, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0) {
+      flush_stash();
       // Here we do some calculations to estimate how much if any we need to grow our buckets
       // TODO fix these if paths or at least annotate them .
       if (len == 0) {
@@ -1361,12 +2359,14 @@ public:
          resize(neededPowerSize, targets::device, s);
       }
       DeviceHasher::insertIndex(keys, buckets.data(), _mapInfo, len, s);
+      mark_unordered();
       return;
    }
 
    // Uses Hasher's insert_kernel to insert all elements
    template <bool prefetches = true>
    void insert(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0) {
+      flush_stash();
       if (len == 0) {
          set_status(status::success);
          return;
@@ -1380,12 +2380,14 @@ public:
          resize(neededPowerSize, targets::device, s);
       }
       DeviceHasher::insert(src, buckets.data(), _mapInfo, len, s);
+      mark_unordered();
       return;
    }
 
    // Uses Hasher's retrieve_kernel to read all elements
    template <bool prefetches = true>
    void retrieve(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, split_gpuStream_t s = 0) {
+      flush_stash();
       if constexpr (prefetches) {
          buckets.optimizeGPU(s);
       }
@@ -1396,6 +2398,7 @@ public:
    // Uses Hasher's retrieve_kernel to read all elements
    template <bool prefetches = true>
    void retrieve(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, split_gpuStream_t s = 0) {
+      flush_stash();
       if constexpr (prefetches) {
          buckets.optimizeGPU(s);
       }
@@ -1406,6 +2409,7 @@ public:
    // Uses Hasher's erase_kernel to delete all elements
    template <bool prefetches = true>
    void erase(KEY_TYPE* keys, size_t len, split_gpuStream_t s = 0) {
+      flush_stash();
       if constexpr (prefetches) {
          buckets.optimizeGPU(s);
       }
@@ -1415,6 +2419,7 @@ public:
       size_t tombstonesAdded = tombstone_count() - tbStore;
       // Fill should be decremented by the number of tombstones added;
       _mapInfo->fill -= tombstonesAdded;
+      mark_unordered();
       return;
    }
 
@@ -1467,6 +2472,8 @@ public:
    void download(split_gpuStream_t stream = 0) {
       // Copy over fill as it might have changed
       optimizeCPU(stream);
+      // The kernels may have written to the buckets without keeping them ordered
+      mark_unordered();
       if (_mapInfo->currentMaxBucketOverflow > Hashinator::defaults::BUCKET_OVERFLOW) {
          rehash(_mapInfo->sizePower + 1);
       } else {
@@ -1480,11 +2487,11 @@ public:
    class device_iterator {
    private:
       size_t index;
-      Hashmap<KEY_TYPE, VAL_TYPE>* hashtable;
+      Hashmap* hashtable;
 
    public:
       HASHINATOR_DEVICEONLY
-      device_iterator(Hashmap<KEY_TYPE, VAL_TYPE>& hashtable, size_t index) : index(index), hashtable(&hashtable) {}
+      device_iterator(Hashmap& hashtable, size_t index) : index(index), hashtable(&hashtable) {}
 
       HASHINATOR_DEVICEONLY
       size_t getIndex() { return index; }
@@ -1526,11 +2533,11 @@ public:
    class const_device_iterator {
    private:
       size_t index;
-      const Hashmap<KEY_TYPE, VAL_TYPE>* hashtable;
+      const Hashmap* hashtable;
 
    public:
       HASHINATOR_DEVICEONLY
-      explicit const_device_iterator(const Hashmap<KEY_TYPE, VAL_TYPE>& hashtable, size_t index)
+      explicit const_device_iterator(const Hashmap& hashtable, size_t index)
           : index(index), hashtable(&hashtable) {}
 
       HASHINATOR_DEVICEONLY
@@ -1779,35 +2786,309 @@ public:
    }
 
 #else
+   /*
+    * The batch calls below run in order on stream s, asynchronously to the caller unless s is
+    * the null stream. The arrays passed in must stay alive until the stream gets to them.
+    * target picks how the work of a call is spread over host threads: an explicit
+    * split::execution_policy, or a targets value (see HostTarget). The default runs small
+    * batches serially; targets::automatic uses the calibrated Thresholds instead.
+    */
 
-   // Uses Hasher's insert_kernel to insert all elements
-   void insert(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, float targetLF = 0.5) {
-      for (size_t i = 0; i < len; ++i) {
-         _at(keys[i]) = vals[i];
-      }
+   // Uses Hasher's host insert to insert all elements
+   template <bool prefetches = true>
+   void insert(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0,
+               HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, keys, vals, len, targetLF, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::insert", len);
+         if (_workload) {
+            _workload->record_batch(workload_op::insert_batch, keys, vals, len, targetLF);
+         }
+         flush_stash();
+         if (len == 0) {
+            set_status(status::success);
+            return;
+         }
+         // Here we do some calculations to estimate how much if any we need to grow our buckets
+         int64_t neededPowerSize = std::ceil(std::log2((_mapInfo->fill + len) * (1.0 / targetLF)));
+         if (neededPowerSize > _mapInfo->sizePower) {
+            resize(neededPowerSize, target);
+         }
+         if (_insertionPolicy == insertion_policy::ordered) {
+            // The hasher does not keep the ordered layout, insert one key at a time instead
+            for (size_t i = 0; i < len; i++) {
+               _at(keys[i]) = vals[i];
+            }
+            set_status(status::success);
+            return;
+         }
+         DeviceHasher::insert(keys, vals, buckets.data(), _mapInfo, len, 0, target.execution(len, host_op::insert));
+      });
    }
 
-   // Uses Hasher's insert_kernel to insert all elements
-   void insert(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, float targetLF = 0.5) {
-      for (size_t i = 0; i < len; ++i) {
-         _at(src[i].first) = src[i].second;
+   // Uses Hasher's host insertIndex to insert all elements, with the index as the value
+   template <bool prefetches = true>
+   void insertIndex(KEY_TYPE* keys, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0,
+                    HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, keys, len, targetLF, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::insertIndex", len);
+         if (_workload) {
+            std::vector<VAL_TYPE> index(len);
+            for (size_t i = 0; i < len; i++) {
+               index[i] = static_cast<VAL_TYPE>(i);
+            }
+            _workload->record_batch(workload_op::insert_batch, keys, index.data(), len, targetLF);
+         }
+         flush_stash();
+         if (len == 0) {
+            set_status(status::success);
+            return;
+         }
+         int64_t neededPowerSize = std::ceil(std::log2((_mapInfo->fill + len) * (1.0 / targetLF)));
+         if (neededPowerSize > _mapInfo->sizePower) {
+            resize(neededPowerSize, target);
+         }
+         if (_insertionPolicy == insertion_policy::ordered) {
+            for (size_t i = 0; i < len; i++) {
+               _at(keys[i]) = static_cast<VAL_TYPE>(i);
+            }
+            set_status(status::success);
+            return;
+         }
+         DeviceHasher::insertIndex(keys, buckets.data(), _mapInfo, len, 0, target.execution(len, host_op::insert));
+      });
+   }
+
+   // Uses Hasher's host insert to insert all elements
+   template <bool prefetches = true>
+   void insert(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, float targetLF = 0.5, split_gpuStream_t s = 0,
+               HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, src, len, targetLF, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::insert", len);
+         if (_workload) {
+            _workload->record_pairs(workload_op::insert_batch, src, len, targetLF);
+         }
+         flush_stash();
+         if (len == 0) {
+            set_status(status::success);
+            return;
+         }
+         int64_t neededPowerSize = std::ceil(std::log2((_mapInfo->fill + len) * (1.0 / targetLF)));
+         if (neededPowerSize > _mapInfo->sizePower) {
+            resize(neededPowerSize, target);
+         }
+         if (_insertionPolicy == insertion_policy::ordered) {
+            for (size_t i = 0; i < len; i++) {
+               _at(src[i].first) = src[i].second;
+            }
+            set_status(status::success);
+            return;
+         }
+         DeviceHasher::insert(src, buckets.data(), _mapInfo, len, 0, target.execution(len, host_op::insert));
+      });
+   }
+
+   // Uses Hasher's host retrieve to read all elements. Values of missing keys are left untouched.
+   template <bool prefetches = true>
+   void retrieve(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, split_gpuStream_t s = 0,
+                 HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, keys, vals, len, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::retrieve", len);
+         if (_workload) {
+            _workload->record_batch(workload_op::retrieve_batch, keys, nullptr, len);
+         }
+         flush_stash();
+         DeviceHasher::retrieve(keys, vals, buckets.data(), _mapInfo, len, 0, target.execution(len),
+                                target.vectorized(len));
+      });
+   }
+
+   // Uses Hasher's host retrieve to read all elements
+   template <bool prefetches = true>
+   void retrieve(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, split_gpuStream_t s = 0,
+                 HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, src, len, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::retrieve", len);
+         if (_workload) {
+            _workload->record_pairs(workload_op::retrieve_batch, src, len);
+         }
+         flush_stash();
+         DeviceHasher::retrieve(src, buckets.data(), _mapInfo, len, 0, target.execution(len));
+      });
+   }
+
+   // Uses Hasher's host erase to delete all elements
+   template <bool prefetches = true>
+   void erase(KEY_TYPE* keys, size_t len, split_gpuStream_t s = 0,
+              HostTarget target = split::execution_policy::adaptive) {
+      split::host_launch(s, [this, keys, len, target]() {
+         SPLIT_TRACE_SCOPE_N("Hashmap::erase", len);
+         if (_workload) {
+            _workload->record_batch(workload_op::erase_batch, keys, nullptr, len);
+         }
+         flush_stash();
+         if (_insertionPolicy == insertion_policy::ordered) {
+            // Ordered erasures shift the cluster back instead of leaving tombstones
+            for (size_t i = 0; i < len; i++) {
+               erase_hashed(keys[i], hash(keys[i]));
+            }
+            return;
+         }
+         // Remember the last numeber of tombstones
+         size_t tbStore = tombstone_count();
+         DeviceHasher::erase(keys, buckets.data(), _mapInfo, len, 0, target.execution(len, host_op::erase));
+         size_t tombstonesAdded = tombstone_count() - tbStore;
+         // Fill should be decremented by the number of tombstones added;
+         _mapInfo->fill -= tombstonesAdded;
+      });
+   }
+
+   /*
+    * Asynchronous batch calls. Each one enqueues its batch on a stream owned by the map and
+    * returns a future that becomes ready once the batch has been applied. Batches run one at a
+    * time in the order they were enqueued, so a retrieve_async sees every earlier insert_async
+    * and erase_async of the same map. The arrays passed in must stay alive until the future is
+    * ready. Other calls on the map do not wait for these batches: call wait_all() first, or
+    * pass async_stream() as their stream to order them after the outstanding batches.
+    */
+   std::future<void> insert_async(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, float targetLF = 0.5,
+                                  HostTarget target = split::execution_policy::adaptive) {
+      return enqueue_async([this, keys, vals, len, targetLF, target]() {
+         insert(keys, vals, len, targetLF, nullptr, target);
+      });
+   }
+
+   std::future<void> insert_async(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, float targetLF = 0.5,
+                                  HostTarget target = split::execution_policy::adaptive) {
+      return enqueue_async([this, src, len, targetLF, target]() { insert(src, len, targetLF, nullptr, target); });
+   }
+
+   std::future<void> retrieve_async(KEY_TYPE* keys, VAL_TYPE* vals, size_t len,
+                                    HostTarget target = split::execution_policy::adaptive) {
+      return enqueue_async([this, keys, vals, len, target]() { retrieve(keys, vals, len, nullptr, target); });
+   }
+
+   std::future<void> retrieve_async(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len,
+                                    HostTarget target = split::execution_policy::adaptive) {
+      return enqueue_async([this, src, len, target]() { retrieve(src, len, nullptr, target); });
+   }
+
+   std::future<void> erase_async(KEY_TYPE* keys, size_t len, HostTarget target = split::execution_policy::adaptive) {
+      return enqueue_async([this, keys, len, target]() { erase(keys, len, nullptr, target); });
+   }
+
+   // Waits until every batch enqueued with the *_async calls so far has been applied
+   void wait_all() const {
+      if (_asyncStream != nullptr) {
+         SPLIT_CHECK_ERR(split_gpuStreamSynchronize(_asyncStream));
       }
    }
 
-   // Uses Hasher's retrieve_kernel to read all elements
-   void retrieve(KEY_TYPE* keys, VAL_TYPE* vals, size_t len) {
-      for (size_t i = 0; i < len; ++i) {
-         vals[i] = at(keys[i]);
+   // The stream the *_async calls are enqueued on
+   split_gpuStream_t async_stream() {
+      if (_asyncStream == nullptr) {
+         SPLIT_CHECK_ERR(split_gpuStreamCreate(&_asyncStream));
       }
+      return _asyncStream;
    }
 
-   // Uses Hasher's erase_kernel to delete all elements
-   void erase(KEY_TYPE* keys, VAL_TYPE* vals, size_t len) {
-      for (size_t i = 0; i < len; ++i) {
-         erase(keys[i].first);
+   /**
+    * @brief Starts writing the host operations of this map to the workload file path (see
+    * workload.h), for replay() to run again later on any map configuration.
+    *
+    * Single key accesses, finds and erasures are written as they run, batches once their
+    * stream gets to them. A recording in progress is finished first. Returns false if the
+    * file could not be created. Copies of the map do not inherit the recording.
+    */
+   bool record_workload(const std::string& path) {
+      auto recorder = std::make_unique<WorkloadRecorder<KEY_TYPE, VAL_TYPE>>(path);
+      if (!recorder->good()) {
+         return false;
       }
+      wait_all();
+      _workload = std::move(recorder);
+      return true;
+   }
+
+   // Finishes the workload file. Batches enqueued on other streams than async_stream() must have run.
+   void stop_workload_recording() {
+      wait_all();
+      _workload.reset();
+   }
+
+private:
+   // Runs batch on async_stream() and hands its outcome, or the exception it threw, to the future
+   template <typename Batch>
+   std::future<void> enqueue_async(Batch batch) {
+      auto done = std::make_shared<std::promise<void>>();
+      std::future<void> handle = done->get_future();
+      split::host_launch(async_stream(), [done, batch]() {
+         try {
+            batch();
+            done->set_value();
+         } catch (...) {
+            done->set_exception(std::current_exception());
+         }
+      });
+      return handle;
+   }
+
+public:
+
+   /*
+    * Host versions of the extraction calls. They wait for the work already enqueued on s,
+    * move the stash back into the buckets and then compact the buckets with split::tools
+    * on the threads target picks for the table size, so the element count they return is final.
+    */
+   template <bool prefetches = true, typename Rule>
+   size_t extractPattern(split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>& elements, Rule rule,
+                         split_gpuStream_t s = 0,
+                         HostTarget target = split::execution_policy::adaptive) {
+      SPLIT_CHECK_ERR(split_gpuStreamSynchronize(s));
+      SPLIT_TRACE_SCOPE_N("Hashmap::extractPattern", buckets.size());
+      flush_stash();
+      split::tools::copy_if<hash_pair<KEY_TYPE, VAL_TYPE>, Rule, defaults::MAX_BLOCKSIZE>(
+          buckets, elements, rule, target.execution(buckets.size(), host_op::table));
+      return elements.size();
+   }
+
+   // elements must have room for every element of the map
+   template <typename Rule>
+   size_t extractPattern(hash_pair<KEY_TYPE, VAL_TYPE>* elements, Rule rule, split_gpuStream_t s = 0,
+                         HostTarget target = split::execution_policy::adaptive) {
+      SPLIT_CHECK_ERR(split_gpuStreamSynchronize(s));
+      SPLIT_TRACE_SCOPE_N("Hashmap::extractPattern", buckets.size());
+      flush_stash();
+      return split::tools::copy_if<hash_pair<KEY_TYPE, VAL_TYPE>, Rule, defaults::MAX_BLOCKSIZE>(
+          buckets.data(), elements, buckets.size(), rule, target.execution(buckets.size(), host_op::table));
+   }
+
+   template <bool prefetches = true, typename Rule>
+   size_t extractKeysByPattern(split::SplitVector<KEY_TYPE>& elements, Rule rule, split_gpuStream_t s = 0,
+                               HostTarget target = split::execution_policy::adaptive) {
+      SPLIT_CHECK_ERR(split_gpuStreamSynchronize(s));
+      flush_stash();
+      split::tools::copy_keys_if<hash_pair<KEY_TYPE, VAL_TYPE>, KEY_TYPE, Rule, defaults::MAX_BLOCKSIZE>(
+          buckets, elements, rule, target.execution(buckets.size(), host_op::table));
+      return elements.size();
+   }
+
+   template <bool prefetches = true>
+   size_t extractAllKeys(split::SplitVector<KEY_TYPE>& elements, split_gpuStream_t s = 0,
+                         HostTarget target = split::execution_policy::adaptive) {
+      // Extract all keys
+      auto rule = [](const hash_pair<KEY_TYPE, VAL_TYPE>& kval) -> bool {
+         return kval.first != EMPTYBUCKET && kval.first != TOMBSTONE;
+      };
+      return extractKeysByPattern<prefetches>(elements, rule, s, target);
    }
 
+   // Host memory needs no prefetching. These only keep their place in the stream.
+   void optimizeGPU(split_gpuStream_t stream = 0) noexcept { buckets.optimizeGPU(stream); }
+
+   void optimizeCPU(split_gpuStream_t stream = 0) noexcept { buckets.optimizeCPU(stream); }
+
+   void streamAttach(split_gpuStream_t s, uint32_t flags = split_gpuMemAttachSingle) { buckets.streamAttach(s, flags); }
+
 #endif
 };
 } // namespace Hashinator
@@ -0,0 +1,364 @@
+/* File:    hopscotch.h
+ * Authors: Kostis Papadakis, Urs Ganse and Markus Battarbee (2023)
+ * Description: A hopscotch hashmap for read mostly tables
+ *              at high load factors.
+ *
+ * This file defines the following classes:
+ *    --Hashinator::Hopscotch;
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <cstddef>
+#ifdef HASHINATOR_CPU_ONLY_MODE
+#define SPLIT_CPU_ONLY_MODE
+#endif
+#include "../common.h"
+#include "../splitvector/split_allocators.h"
+#include "../splitvector/splitvec.h"
+#include "defaults.h"
+#include "hash_pair.h"
+#include "hashfunctions.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace Hashinator {
+
+/**
+ * Hopscotch hashing (Herlihy, Shavit & Tzafrir 2008).
+ *
+ * Every element lives within defaults::BUCKET_OVERFLOW buckets of its home bucket. Each home
+ * bucket keeps a bitmap of the neighborhood slots holding its elements, so a lookup touches a
+ * single neighborhood and only compares the keys whose bits are set. Insertions that find the
+ * nearest empty bucket outside the neighborhood hop it backwards by displacing elements that
+ * can move closer to it while staying inside their own neighborhood. If no such element exists
+ * the table grows.
+ *
+ * The bucket count does not have to be a power of two. Keys are mapped to their home bucket with
+ * HashFunction::_hash_range, batch insertions size the table to exactly what the target load
+ * factor needs and overflowing neighborhoods grow it by defaults::GROWTH_FACTOR.
+ *
+ * With CACHE_HASH_BITS every bucket also keeps the capacity independent hash bits of its key
+ * (HashFunction::_hash_bits) in a side array. Resizing then moves elements without hashing their
+ * keys again and lookups reject most neighborhood entries by their hash bits before comparing
+ * keys, which pays off for expensive hash functions or composite keys. The cost is 4 bytes per
+ * bucket.
+ *
+ * The table is host side. It offers the same batch insert/retrieve/erase calls as the CPU
+ * Hashmap so the two can be swapped for read mostly workloads at load factors of 0.85-0.9.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE, KEY_TYPE EMPTYBUCKET = std::numeric_limits<KEY_TYPE>::max(),
+          class HashFunction = HashFunctions::Fibonacci<KEY_TYPE>, bool CACHE_HASH_BITS = false>
+class Hopscotch {
+public:
+   static constexpr int NEIGHBORHOOD = defaults::BUCKET_OVERFLOW;
+   using bitmap_type = typename std::conditional<(NEIGHBORHOOD <= 32), uint32_t, uint64_t>::type;
+   static_assert(NEIGHBORHOOD <= 64, "Neighborhoods larger than 64 buckets do not fit in a bitmap");
+
+private:
+   size_t capacity; // Number of buckets
+   split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>> buckets;
+   split::SplitVector<bitmap_type> hops; // hops[h] bit i set: bucket h+i holds an element whose home is h
+   split::SplitVector<uint32_t> tags;    // Hash bits of every bucket's key, empty unless CACHE_HASH_BITS
+   size_t fill;
+
+   // Index of the lowest set bit of a non zero bitmap
+   static inline int lowest_bit(bitmap_type bits) noexcept {
+      if constexpr (sizeof(bitmap_type) == sizeof(uint32_t)) {
+         return __builtin_ctz(bits);
+      } else {
+         return __builtin_ctzll(bits);
+      }
+   }
+
+   // Wraps an index in [0, 2*capacity) back into the table
+   inline size_t wrap(size_t index) const noexcept { return (index >= capacity) ? index - capacity : index; }
+
+   // Distance from home to index going forward
+   inline size_t distance(size_t home, size_t index) const noexcept {
+      return (index >= home) ? index - home : index + capacity - home;
+   }
+
+   // Index of key or bucket_count() if it is not in the table
+   size_t find_index(const KEY_TYPE& key) const {
+      const uint32_t hashBits = HashFunction::_hash_bits(key);
+      const size_t home = HashFunction::_reduce(hashBits, capacity);
+      bitmap_type bits = hops[home];
+      while (bits) {
+         const size_t index = wrap(home + lowest_bit(bits));
+         bits &= bits - 1;
+         if constexpr (CACHE_HASH_BITS) {
+            if (tags[index] != hashBits) {
+               continue;
+            }
+         }
+         if (buckets[index].first == key) {
+            return index;
+         }
+      }
+      return buckets.size();
+   }
+
+   // Moves the empty bucket at free closer to home. Returns false if no element can be displaced.
+   bool hop_back(size_t& free) {
+      for (size_t dist = NEIGHBORHOOD - 1; dist > 0; dist--) {
+         const size_t candidateHome = (free >= dist) ? free - dist : free + capacity - dist;
+         // Only elements between candidateHome and free may move into free
+         const bitmap_type movable = hops[candidateHome] & ((bitmap_type(1) << dist) - 1);
+         if (movable == 0) {
+            continue;
+         }
+         const int offset = lowest_bit(movable);
+         const size_t from = wrap(candidateHome + offset);
+         buckets[free] = buckets[from];
+         buckets[from].first = EMPTYBUCKET;
+         if constexpr (CACHE_HASH_BITS) {
+            tags[free] = tags[from];
+         }
+         hops[candidateHome] = (hops[candidateHome] & ~(bitmap_type(1) << offset)) | (bitmap_type(1) << dist);
+         free = from;
+         return true;
+      }
+      return false;
+   }
+
+   // Places a key that is known to be absent. Returns bucket_count() if the table has to grow.
+   size_t place(const KEY_TYPE& key, uint32_t hashBits) {
+      const size_t home = HashFunction::_reduce(hashBits, capacity);
+      size_t dist = 0;
+      size_t free = home;
+      for (; dist < capacity; dist++) {
+         if (buckets[free].first == EMPTYBUCKET) {
+            break;
+         }
+         free = wrap(free + 1);
+      }
+      if (dist == capacity) {
+         return buckets.size();
+      }
+      while (dist >= NEIGHBORHOOD) {
+         if (!hop_back(free)) {
+            return buckets.size();
+         }
+         dist = distance(home, free);
+      }
+      buckets[free].first = key;
+      if constexpr (CACHE_HASH_BITS) {
+         tags[free] = hashBits;
+      }
+      hops[home] |= bitmap_type(1) << dist;
+      fill++;
+      return free;
+   }
+
+public:
+   // Tables are never smaller than one neighborhood. Use resize() for capacities that are not a power of two.
+   Hopscotch(int sizepower = 5)
+       : capacity(std::max(static_cast<size_t>(1) << sizepower, static_cast<size_t>(NEIGHBORHOOD))),
+         buckets(capacity, hash_pair<KEY_TYPE, VAL_TYPE>(EMPTYBUCKET, VAL_TYPE())), hops(capacity, bitmap_type(0)),
+         tags(CACHE_HASH_BITS ? capacity : 0), fill(0) {}
+
+   Hopscotch(const Hopscotch& other) = default;
+   Hopscotch(Hopscotch&& other) = default;
+   Hopscotch& operator=(const Hopscotch& other) = default;
+   Hopscotch& operator=(Hopscotch&& other) = default;
+
+   // Home bucket of a key
+   size_t hash(KEY_TYPE in) const {
+      static_assert(std::is_arithmetic<KEY_TYPE>::value);
+      return HashFunction::_hash_range(in, capacity);
+   }
+
+   // Resize the table to fit 1<<newSizePower buckets and reinsert all elements
+   void rehash(int newSizePower) {
+      if (newSizePower > 32) {
+         throw std::out_of_range("Hopscotch ran into rehashing catastrophe and exceeded 32bit buckets.");
+      }
+      resize(static_cast<size_t>(1) << newSizePower);
+   }
+
+   // Resize the table to newCapacity buckets and reinsert all elements.
+   // Grows further if some neighborhood overflows at the requested size.
+   void resize(size_t newCapacity) {
+      std::vector<hash_pair<KEY_TYPE, VAL_TYPE>> elements;
+      std::vector<uint32_t> elementBits;
+      elements.reserve(fill);
+      elementBits.reserve(fill);
+      for (size_t i = 0; i < buckets.size(); i++) {
+         if (buckets[i].first == EMPTYBUCKET) {
+            continue;
+         }
+         elements.push_back(buckets[i]);
+         if constexpr (CACHE_HASH_BITS) {
+            elementBits.push_back(tags[i]);
+         } else {
+            elementBits.push_back(HashFunction::_hash_bits(buckets[i].first));
+         }
+      }
+      newCapacity = std::max(newCapacity, static_cast<size_t>(NEIGHBORHOOD));
+      for (;; newCapacity = grown(newCapacity)) {
+         if (newCapacity > (static_cast<size_t>(1) << 32)) {
+            throw std::out_of_range("Hopscotch ran into rehashing catastrophe and exceeded 32bit buckets.");
+         }
+         buckets = std::move(split::SplitVector<hash_pair<KEY_TYPE, VAL_TYPE>>(
+             newCapacity, hash_pair<KEY_TYPE, VAL_TYPE>(EMPTYBUCKET, VAL_TYPE())));
+         hops = std::move(split::SplitVector<bitmap_type>(newCapacity, bitmap_type(0)));
+         if constexpr (CACHE_HASH_BITS) {
+            tags = std::move(split::SplitVector<uint32_t>(newCapacity));
+         }
+         capacity = newCapacity;
+         fill = 0;
+         bool success = true;
+         for (size_t i = 0; i < elements.size(); i++) {
+            const size_t index = place(elements[i].first, elementBits[i]);
+            if (index == buckets.size()) {
+               success = false;
+               break;
+            }
+            buckets[index].second = elements[i].second;
+         }
+         if (success) {
+            return;
+         }
+      }
+   }
+
+   // Element access, inserting a default constructed value if the key is missing
+   VAL_TYPE& at(const KEY_TYPE& key) {
+      size_t index = find_index(key);
+      if (index != buckets.size()) {
+         return buckets[index].second;
+      }
+      // Not found, and no empty bucket can be hopped into the neighborhood. Grow until one can.
+      const uint32_t hashBits = HashFunction::_hash_bits(key);
+      while ((index = place(key, hashBits)) == buckets.size()) {
+         resize(grown(capacity));
+      }
+      buckets[index].second = VAL_TYPE();
+      return buckets[index].second;
+   }
+
+   const VAL_TYPE& at(const KEY_TYPE& key) const {
+      const size_t index = find_index(key);
+      if (index == buckets.size()) {
+         throw std::out_of_range("Element not found in Hopscotch.at");
+      }
+      return buckets[index].second;
+   }
+
+   VAL_TYPE& operator[](const KEY_TYPE& key) { return at(key); }
+
+   size_t count(const KEY_TYPE& key) const { return (find_index(key) == buckets.size()) ? 0 : 1; }
+
+   // Returns a pointer to the value of key or nullptr if the key is missing
+   const VAL_TYPE* find(const KEY_TYPE& key) const {
+      const size_t index = find_index(key);
+      return (index == buckets.size()) ? nullptr : &buckets[index].second;
+   }
+
+   size_t erase(const KEY_TYPE& key) {
+      const size_t index = find_index(key);
+      if (index == buckets.size()) {
+         return 0;
+      }
+      size_t home;
+      if constexpr (CACHE_HASH_BITS) {
+         home = HashFunction::_reduce(tags[index], capacity);
+      } else {
+         home = hash(key);
+      }
+      hops[home] &= ~(bitmap_type(1) << distance(home, index));
+      buckets[index].first = EMPTYBUCKET;
+      fill--;
+      return 1;
+   }
+
+   void clear() {
+      for (auto& e : buckets) {
+         e.first = EMPTYBUCKET;
+      }
+      for (auto& h : hops) {
+         h = 0;
+      }
+      fill = 0;
+   }
+
+   size_t size() const { return fill; }
+
+   size_t bucket_count() const { return buckets.size(); }
+
+   float load_factor() const { return (float)size() / bucket_count(); }
+
+
+   // Inserts all elements, growing up front so that the final load factor stays below targetLF
+   void insert(KEY_TYPE* keys, VAL_TYPE* vals, size_t len, float targetLF = 0.5) {
+      reserve_for(len, targetLF);
+      for (size_t i = 0; i < len; ++i) {
+         at(keys[i]) = vals[i];
+      }
+   }
+
+   void insert(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len, float targetLF = 0.5) {
+      reserve_for(len, targetLF);
+      for (size_t i = 0; i < len; ++i) {
+         at(src[i].first) = src[i].second;
+      }
+   }
+
+   // Reads all elements. Values of missing keys are left untouched.
+   void retrieve(KEY_TYPE* keys, VAL_TYPE* vals, size_t len) const {
+      for (size_t i = 0; i < len; ++i) {
+         const size_t index = find_index(keys[i]);
+         if (index != buckets.size()) {
+            vals[i] = buckets[index].second;
+         }
+      }
+   }
+
+   void retrieve(hash_pair<KEY_TYPE, VAL_TYPE>* src, size_t len) const {
+      for (size_t i = 0; i < len; ++i) {
+         const size_t index = find_index(src[i].first);
+         if (index != buckets.size()) {
+            src[i].second = buckets[index].second;
+         }
+      }
+   }
+
+   void erase(KEY_TYPE* keys, size_t len) {
+      for (size_t i = 0; i < len; ++i) {
+         erase(keys[i]);
+      }
+   }
+
+private:
+   static size_t grown(size_t currentCapacity) noexcept {
+      return static_cast<size_t>(std::ceil(currentCapacity * defaults::GROWTH_FACTOR));
+   }
+
+   void reserve_for(size_t len, float targetLF) {
+      if (len == 0) {
+         return;
+      }
+      const size_t neededCapacity = std::ceil((fill + len) * (1.0 / targetLF));
+      if (neededCapacity > capacity) {
+         resize(neededCapacity);
+      }
+   }
+};
+} // namespace Hashinator
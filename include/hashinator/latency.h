@@ -0,0 +1,282 @@
+/* File:    latency.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Sampled per operation latency histograms for Hashmap
+ *
+ * This file defines the following classes:
+ *    --Hashinator::latency_op
+ *    --Hashinator::LatencyHistogram
+ *    --Hashinator::LatencyRecorder
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace Hashinator {
+
+/**
+ * @brief Host operations timed by a LatencyRecorder.
+ *
+ * Rehashes are rare and are what the tail is made of, so every one of them is timed;
+ * the other operations are sampled.
+ */
+enum class latency_op { find_hit, find_miss, insert_new, insert_update, erase, rehash, cleanup, count };
+
+constexpr size_t num_latency_ops = static_cast<size_t>(latency_op::count);
+
+/**
+ * @brief Log bucketed histogram of latencies in nanoseconds.
+ *
+ * Values below 2^SUB_BITS get a bucket each; above that every power of two is split into
+ * 2^SUB_BITS linear buckets, so any recorded value is known to within 1/16 of itself.
+ * Values are capped at 2^MAX_EXPONENT ns (about 18 minutes).
+ */
+class LatencyHistogram {
+public:
+   static constexpr int SUB_BITS = 4;
+   static constexpr int MAX_EXPONENT = 40;
+   static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+   static constexpr size_t BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;
+
+   static size_t bucket_of(uint64_t ns) noexcept {
+      ns = std::min<uint64_t>(ns, (uint64_t(1) << (MAX_EXPONENT + 1)) - 1);
+      if (ns < SUB_BUCKETS) {
+         return ns;
+      }
+      int exponent = 63;
+      while (!(ns >> exponent)) {
+         exponent--;
+      }
+      const size_t sub = (ns >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+      return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+   }
+
+   // Largest value that falls in bucket b
+   static uint64_t highest_in(size_t b) noexcept {
+      if (b < SUB_BUCKETS) {
+         return b;
+      }
+      const int exponent = static_cast<int>(b / SUB_BUCKETS) + SUB_BITS - 1;
+      const uint64_t lowest = (SUB_BUCKETS + b % SUB_BUCKETS) << (exponent - SUB_BITS);
+      return lowest + (uint64_t(1) << (exponent - SUB_BITS)) - 1;
+   }
+
+   void record(uint64_t ns, uint64_t times = 1) noexcept {
+      counts[bucket_of(ns)] += times;
+      total += times;
+      sum += ns * times;
+      minimum = std::min(minimum, ns);
+      maximum = std::max(maximum, ns);
+   }
+
+   void merge(const LatencyHistogram& other) noexcept {
+      for (size_t b = 0; b < BUCKETS; b++) {
+         counts[b] += other.counts[b];
+      }
+      total += other.total;
+      sum += other.sum;
+      minimum = std::min(minimum, other.minimum);
+      maximum = std::max(maximum, other.maximum);
+   }
+
+   uint64_t count() const noexcept { return total; }
+
+   uint64_t min() const noexcept { return total ? minimum : 0; }
+
+   uint64_t max() const noexcept { return maximum; }
+
+   double mean() const noexcept { return total ? static_cast<double>(sum) / total : 0.0; }
+
+   /**
+    * @brief Value below or at which p percent of the recorded latencies are.
+    *
+    * Like HDR histograms this reports the highest value of the bucket the percentile falls
+    * in, so it overestimates by at most one bucket width and never exceeds max().
+    */
+   uint64_t percentile(double p) const noexcept {
+      if (total == 0) {
+         return 0;
+      }
+      p = std::min(std::max(p, 0.0), 100.0);
+      const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(p / 100.0 * total + 0.5));
+      uint64_t seen = 0;
+      for (size_t b = 0; b < BUCKETS; b++) {
+         seen += counts[b];
+         if (seen >= rank) {
+            return std::min(highest_in(b), maximum);
+         }
+      }
+      return maximum;
+   }
+
+   uint64_t bucket_count(size_t b) const noexcept { return counts[b]; }
+
+private:
+   friend class LatencyRecorder;
+
+   std::array<uint64_t, BUCKETS> counts{};
+   uint64_t total = 0;
+   uint64_t sum = 0;
+   uint64_t minimum = std::numeric_limits<uint64_t>::max();
+   uint64_t maximum = 0;
+};
+
+/**
+ * @brief Collects sampled latencies of the host operations of one or more Hashmaps.
+ *
+ * Threads record into one of a few shards, picked by thread id, with relaxed atomics, and
+ * histogram() merges the shards. Each thread only times one in sample_every() operations
+ * of each kind (and every rehash), which bounds the cost of the clock reads. An operation
+ * that runs inside another one of the same kind on the same thread, like the retries of a
+ * rehash that ran out of room, is folded into the outer one.
+ */
+class LatencyRecorder {
+public:
+   // sampleEvery is rounded up to a power of two
+   explicit LatencyRecorder(size_t sampleEvery = 64) {
+      mask = 1;
+      while (mask < sampleEvery) {
+         mask <<= 1;
+      }
+      mask -= 1;
+   }
+
+   LatencyRecorder(const LatencyRecorder&) = delete;
+   LatencyRecorder& operator=(const LatencyRecorder&) = delete;
+
+   size_t sample_every() const noexcept { return mask + 1; }
+
+   // RAII timer for one operation. The kind can be settled once the outcome is known.
+   class Sample {
+   public:
+      Sample(LatencyRecorder* recorder, latency_op op) {
+         if (recorder == nullptr) {
+            return;
+         }
+         this->op = op;
+         outcome = op;
+         if (depth(op)++ > 0) {
+            return;
+         }
+         if (op != latency_op::rehash && (tick(op)++ & recorder->mask) != 0) {
+            return;
+         }
+         this->recorder = recorder;
+         start = std::chrono::steady_clock::now();
+      }
+      Sample(const Sample&) = delete;
+      Sample& operator=(const Sample&) = delete;
+
+      ~Sample() {
+         if (op == latency_op::count) {
+            return;
+         }
+         depth(op)--;
+         if (recorder != nullptr) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            recorder->record(outcome, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+         }
+      }
+
+      // Files the sample under another kind of the same operation, e.g. a find that missed
+      void set(latency_op kind) noexcept { outcome = kind; }
+
+   private:
+      LatencyRecorder* recorder = nullptr;
+      latency_op op = latency_op::count;
+      latency_op outcome = latency_op::count;
+      std::chrono::steady_clock::time_point start;
+
+      static int& depth(latency_op op) {
+         thread_local std::array<int, num_latency_ops + 1> depths{};
+         return depths[static_cast<size_t>(op)];
+      }
+
+      static uint64_t& tick(latency_op op) {
+         thread_local std::array<uint64_t, num_latency_ops + 1> ticks{};
+         return ticks[static_cast<size_t>(op)];
+      }
+   };
+
+   // Adds one latency of op to the shard of the calling thread
+   void record(latency_op op, uint64_t ns) noexcept {
+      Shard& shard = shards[std::hash<std::thread::id>()(std::this_thread::get_id()) % SHARDS];
+      Series& series = shard.series[static_cast<size_t>(op)];
+      series.counts[LatencyHistogram::bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+      series.sum.fetch_add(ns, std::memory_order_relaxed);
+      uint64_t seen = series.min.load(std::memory_order_relaxed);
+      while (ns < seen && !series.min.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+      }
+      seen = series.max.load(std::memory_order_relaxed);
+      while (ns > seen && !series.max.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+      }
+   }
+
+   // Histogram of op over every thread
+   LatencyHistogram histogram(latency_op op) const {
+      LatencyHistogram merged;
+      for (const Shard& shard : shards) {
+         const Series& series = shard.series[static_cast<size_t>(op)];
+         LatencyHistogram part;
+         for (size_t b = 0; b < LatencyHistogram::BUCKETS; b++) {
+            part.counts[b] = series.counts[b].load(std::memory_order_relaxed);
+            part.total += part.counts[b];
+         }
+         part.sum = series.sum.load(std::memory_order_relaxed);
+         part.minimum = series.min.load(std::memory_order_relaxed);
+         part.maximum = series.max.load(std::memory_order_relaxed);
+         merged.merge(part);
+      }
+      return merged;
+   }
+
+   // Not to be called while operations are being recorded
+   void reset() noexcept {
+      for (Shard& shard : shards) {
+         for (Series& series : shard.series) {
+            for (auto& c : series.counts) {
+               c.store(0, std::memory_order_relaxed);
+            }
+            series.sum.store(0, std::memory_order_relaxed);
+            series.min.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            series.max.store(0, std::memory_order_relaxed);
+         }
+      }
+   }
+
+private:
+   static constexpr size_t SHARDS = 8;
+   struct Series {
+      std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKETS> counts{};
+      std::atomic<uint64_t> sum{0};
+      std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+      std::atomic<uint64_t> max{0};
+   };
+   struct alignas(64) Shard {
+      std::array<Series, num_latency_ops> series{};
+   };
+   std::array<Shard, SHARDS> shards{};
+   size_t mask;
+};
+
+} // namespace Hashinator
@@ -0,0 +1,195 @@
+/* File:    metrics.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Structured health metrics of a Hashmap
+ *
+ * This file defines the following classes:
+ *    --Hashinator::Metrics
+ *    --Hashinator::MetricsBlock
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Hashinator {
+
+/**
+ * @brief Snapshot of the state of a Hashmap, as returned by Hashmap::metrics().
+ *
+ * A cluster is a maximal run of buckets holding an element or a tombstone, which is what a
+ * probe has to walk through; an empty run is a maximal run of empty buckets. Runs wrap
+ * around the end of the table like the probes do.
+ */
+struct Metrics {
+   size_t fill = 0;           // Elements in the map, stash included
+   size_t capacity = 0;       // Number of buckets
+   float loadFactor = 0.0;    // fill / capacity
+   size_t tombstones = 0;     // Buckets holding a tombstone
+   size_t stashFill = 0;      // Elements held in the overflow stash
+   size_t stashHits = 0;      // Lookups answered from the overflow stash
+   size_t overflowWindow = 0; // Longest probe an insertion may currently take
+   size_t bytes = 0;          // memory_usage().total() of the map
+   // probeHistogram[d] elements sit d buckets past their home bucket
+   std::vector<size_t> probeHistogram;
+   size_t maxProbe = 0;
+   double meanProbe = 0.0;
+   size_t clusters = 0;
+   size_t maxCluster = 0;
+   double meanCluster = 0.0;
+   // emptyRuns[k] runs of empty buckets are between 2^k and 2^(k+1)-1 buckets long
+   std::vector<size_t> emptyRuns;
+   size_t maxEmptyRun = 0;
+
+   std::string to_json() const {
+      auto array = [](const std::vector<size_t>& v) {
+         std::string out = "[";
+         for (size_t i = 0; i < v.size(); i++) {
+            out += (i > 0 ? "," : "") + std::to_string(v[i]);
+         }
+         return out + "]";
+      };
+      std::ostringstream json;
+      json << "{\"fill\":" << fill << ",\"capacity\":" << capacity << ",\"load_factor\":" << loadFactor
+           << ",\"tombstones\":" << tombstones << ",\"stash_fill\":" << stashFill << ",\"stash_hits\":" << stashHits
+           << ",\"overflow_window\":" << overflowWindow << ",\"bytes\":" << bytes
+           << ",\"probe_histogram\":" << array(probeHistogram) << ",\"max_probe\":" << maxProbe
+           << ",\"mean_probe\":" << meanProbe << ",\"clusters\":" << clusters << ",\"max_cluster\":" << maxCluster
+           << ",\"mean_cluster\":" << meanCluster << ",\"empty_runs\":" << array(emptyRuns)
+           << ",\"max_empty_run\":" << maxEmptyRun << "}";
+      return json.str();
+   }
+};
+
+/*
+ * Partial metrics of a contiguous block of buckets, so that blocks can be scanned on
+ * different threads. Runs that touch either end of a block may go on in the neighbouring
+ * blocks: they are only recorded once append() has joined the blocks in table order and
+ * close() has joined the last run with the first one.
+ */
+struct MetricsBlock {
+   std::vector<size_t> probes;
+   std::vector<size_t> emptyRuns;
+   size_t clusters = 0;
+   size_t clusterBuckets = 0;
+   size_t maxCluster = 0;
+   size_t maxEmptyRun = 0;
+   size_t size = 0;   // Buckets seen
+   size_t head = 0;   // Length of the run the block starts with
+   size_t tail = 0;   // Length of the run the block currently ends with
+   int8_t first = -1; // Kind of the first run: 1 occupied, 0 empty
+   int8_t last = -1;  // Kind of the current run, -1 once it has been cut
+
+   void add_probe(size_t distance) {
+      if (distance >= probes.size()) {
+         probes.resize(distance + 1, 0);
+      }
+      probes[distance]++;
+   }
+
+   void add_bucket(bool occupied) { add_span(occupied, 1); }
+
+   // Adds length buckets of the same kind after the ones seen so far
+   void add_span(bool occupied, size_t length) {
+      if (length == 0) {
+         return;
+      }
+      if (size == 0) {
+         first = occupied;
+      } else if (last != static_cast<int8_t>(occupied)) {
+         cut();
+      }
+      last = occupied;
+      tail += length;
+      size += length;
+      if (tail == size) {
+         head = size;
+      }
+   }
+
+   // Ends the current run. The head run stays open for close().
+   void cut() {
+      if (last >= 0 && tail != size) {
+         add_run(last, tail);
+      }
+      last = -1;
+      tail = 0;
+   }
+
+   void add_run(bool occupied, size_t length) {
+      if (occupied) {
+         clusters++;
+         clusterBuckets += length;
+         maxCluster = std::max(maxCluster, length);
+         return;
+      }
+      size_t bin = 0;
+      while ((length >> (bin + 1)) > 0) {
+         bin++;
+      }
+      if (bin >= emptyRuns.size()) {
+         emptyRuns.resize(bin + 1, 0);
+      }
+      emptyRuns[bin]++;
+      maxEmptyRun = std::max(maxEmptyRun, length);
+   }
+
+   // Joins the block that follows this one in the table
+   void append(const MetricsBlock& next) {
+      if (next.size == 0) {
+         return;
+      }
+      auto add = [](std::vector<size_t>& dst, const std::vector<size_t>& src) {
+         dst.resize(std::max(dst.size(), src.size()), 0);
+         for (size_t i = 0; i < src.size(); i++) {
+            dst[i] += src[i];
+         }
+      };
+      add(probes, next.probes);
+      add(emptyRuns, next.emptyRuns);
+      clusters += next.clusters;
+      clusterBuckets += next.clusterBuckets;
+      maxCluster = std::max(maxCluster, next.maxCluster);
+      maxEmptyRun = std::max(maxEmptyRun, next.maxEmptyRun);
+      add_span(next.first, next.head);
+      if (next.head < next.size) {
+         cut();
+         add_span(next.last, next.tail);
+      }
+   }
+
+   // Records the runs left open at both ends, wrapping the last one around to the first
+   void close() {
+      if (size == 0) {
+         return;
+      }
+      if (head == size) {
+         add_run(first, size);
+      } else if (last == first) {
+         add_run(first, head + tail);
+      } else {
+         add_run(first, head);
+         add_run(last, tail);
+      }
+      head = tail = 0;
+      last = -1;
+   }
+};
+
+} // namespace Hashinator
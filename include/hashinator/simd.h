@@ -0,0 +1,287 @@
+/* File:    simd.h
+ * Authors: Kostis Papadakis, Urs Ganse and Markus Battarbee (2023)
+ * Description: Host SIMD helpers for probing the bucket array.
+ *
+ * This file defines the following classes:
+ *    --Hashinator::SIMD::Probe;
+ *    --Hashinator::SIMD::Lookup;
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include "hash_pair.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if (defined(__AVX2__) || defined(__AVX512F__)) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define HASHINATOR_HOST_SIMD
+#include <immintrin.h>
+#endif
+
+namespace Hashinator {
+namespace SIMD {
+
+/**
+ * @brief Compares a run of consecutive buckets against a key in one step.
+ *
+ * This is the host counterpart of the warp voting in warpFind: the keys of
+ * width buckets are loaded into one vector register (one cache line with AVX-512 and
+ * 8-byte pairs), compared against the key, EMPTYBUCKET and optionally TOMBSTONE,
+ * and the first hit is resolved with a count of trailing zeros.
+ *
+ * The keys of the array of structs layout sit in every other lane, so the odd lanes
+ * holding the values are masked out. Only pairs of two 4-byte or two 8-byte integers
+ * are vectorized; width is 0 for every other layout and without AVX2.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE>
+struct Probe {
+private:
+   static constexpr bool packed =
+       std::is_integral<KEY_TYPE>::value && sizeof(hash_pair<KEY_TYPE, VAL_TYPE>) == 2 * sizeof(KEY_TYPE) &&
+       (sizeof(KEY_TYPE) == 4 || sizeof(KEY_TYPE) == 8);
+
+public:
+#if defined(__AVX512F__) && defined(HASHINATOR_HOST_SIMD)
+   static constexpr size_t width = packed ? 64 / sizeof(hash_pair<KEY_TYPE, VAL_TYPE>) : 0;
+#elif defined(__AVX2__) && defined(HASHINATOR_HOST_SIMD)
+   static constexpr size_t width = packed ? 32 / sizeof(hash_pair<KEY_TYPE, VAL_TYPE>) : 0;
+#else
+   static constexpr size_t width = 0;
+#endif
+
+   /**
+    * @brief Counts the leading buckets of pairs[0, width) that hold neither key,
+    * emptybucket nor, if stopOnTombstone is set, tombstone.
+    *
+    * @return width if none of the buckets matches, else the offset of the first match.
+    */
+   static size_t skip(const hash_pair<KEY_TYPE, VAL_TYPE>* pairs, const KEY_TYPE key, const KEY_TYPE emptybucket,
+                      const KEY_TYPE tombstone, const bool stopOnTombstone) {
+#if defined(__AVX512F__) && defined(HASHINATOR_HOST_SIMD)
+      if constexpr (packed && sizeof(KEY_TYPE) == 4) {
+         const __m512i v = _mm512_loadu_si512(reinterpret_cast<const void*>(pairs));
+         const __mmask16 keys = 0x5555;
+         __mmask16 hits = _mm512_mask_cmpeq_epi32_mask(keys, v, _mm512_set1_epi32(static_cast<int>(key))) |
+                          _mm512_mask_cmpeq_epi32_mask(keys, v, _mm512_set1_epi32(static_cast<int>(emptybucket)));
+         if (stopOnTombstone) {
+            hits |= _mm512_mask_cmpeq_epi32_mask(keys, v, _mm512_set1_epi32(static_cast<int>(tombstone)));
+         }
+         return hits ? __builtin_ctz(hits) / 2 : width;
+      } else if constexpr (packed && sizeof(KEY_TYPE) == 8) {
+         const __m512i v = _mm512_loadu_si512(reinterpret_cast<const void*>(pairs));
+         const __mmask8 keys = 0x55;
+         __mmask8 hits = _mm512_mask_cmpeq_epi64_mask(keys, v, _mm512_set1_epi64(static_cast<long long>(key))) |
+                         _mm512_mask_cmpeq_epi64_mask(keys, v, _mm512_set1_epi64(static_cast<long long>(emptybucket)));
+         if (stopOnTombstone) {
+            hits |= _mm512_mask_cmpeq_epi64_mask(keys, v, _mm512_set1_epi64(static_cast<long long>(tombstone)));
+         }
+         return hits ? __builtin_ctz(hits) / 2 : width;
+      }
+#elif defined(__AVX2__) && defined(HASHINATOR_HOST_SIMD)
+      if constexpr (packed && sizeof(KEY_TYPE) == 4) {
+         const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs));
+         __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(key))),
+                                      _mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(emptybucket))));
+         if (stopOnTombstone) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(v, _mm256_set1_epi32(static_cast<int>(tombstone))));
+         }
+         const int hits = _mm256_movemask_ps(_mm256_castsi256_ps(eq)) & 0x55;
+         return hits ? __builtin_ctz(hits) / 2 : width;
+      } else if constexpr (packed && sizeof(KEY_TYPE) == 8) {
+         const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pairs));
+         __m256i eq = _mm256_or_si256(_mm256_cmpeq_epi64(v, _mm256_set1_epi64x(static_cast<long long>(key))),
+                                      _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(static_cast<long long>(emptybucket))));
+         if (stopOnTombstone) {
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi64(v, _mm256_set1_epi64x(static_cast<long long>(tombstone))));
+         }
+         const int hits = _mm256_movemask_pd(_mm256_castsi256_pd(eq)) & 0x5;
+         return hits ? __builtin_ctz(hits) / 2 : width;
+      }
+#endif
+      (void)pairs;
+      (void)key;
+      (void)emptybucket;
+      (void)tombstone;
+      (void)stopOnTombstone;
+      return 0;
+   }
+};
+
+/**
+ * @brief Looks up many keys at once, one key per vector lane.
+ *
+ * Where Probe vectorizes the probe sequence of a single key, Lookup follows
+ * Polychroniou et al. and gathers the current bucket of lanes independent keys,
+ * compares them with masked compares and refills every lane whose key resolved
+ * with the next input key, so that no lane idles on a long probe sequence.
+ *
+ * Requires AVX-512F and the same packed layouts as Probe; lanes is 0 otherwise.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE>
+struct Lookup {
+private:
+   static constexpr bool packed =
+       std::is_integral<KEY_TYPE>::value && sizeof(hash_pair<KEY_TYPE, VAL_TYPE>) == 2 * sizeof(KEY_TYPE) &&
+       (sizeof(KEY_TYPE) == 4 || sizeof(KEY_TYPE) == 8);
+
+#if defined(__AVX512F__) && defined(HASHINATOR_HOST_SIMD)
+   // The lowest n set bits of mask
+   static inline uint32_t lowest_bits(uint32_t mask, size_t n) {
+      uint32_t retval = 0;
+      for (size_t k = 0; k < n; k++) {
+         retval |= mask & (~mask + 1);
+         mask &= mask - 1;
+      }
+      return retval;
+   }
+#endif
+
+public:
+#if defined(__AVX512F__) && defined(HASHINATOR_HOST_SIMD)
+   static constexpr size_t lanes = packed ? 64 / sizeof(KEY_TYPE) : 0;
+#else
+   static constexpr size_t lanes = 0;
+#endif
+   // Largest table find() handles. The gathers for 4 byte keys take signed 32 bit bucket indices.
+   static constexpr size_t max_buckets = (sizeof(KEY_TYPE) == 4) ? size_t(1) << 31 : ~size_t(0);
+
+   /**
+    * @brief Finds keys[0, len) in a linear probing table of bsize (a power of two) buckets.
+    * bsize must not exceed max_buckets.
+    *
+    * The values of the keys found are written to vals. The positions of the keys that
+    * are not in buckets, or whose probe sequence covered the whole table, are written
+    * to misses and left for the caller.
+    *
+    * @param hashes The unmasked hash of every key, as given by Hashmap::hash_batch.
+    * @return The number of misses.
+    */
+   static size_t find(const hash_pair<KEY_TYPE, VAL_TYPE>* buckets, const size_t bsize, const KEY_TYPE* keys,
+                      const uint32_t* hashes, const uint32_t len, VAL_TYPE* vals, uint32_t* misses,
+                      const KEY_TYPE emptybucket) {
+      size_t nMisses = 0;
+      assert(bsize <= max_buckets && "Table too large for the vectorized lookup");
+#if defined(__AVX512F__) && defined(HASHINATOR_HOST_SIMD)
+      alignas(64) uint32_t pos32[16], idx32[16];
+      alignas(64) uint64_t pos64[8], idx64[8];
+      uint32_t next = 0;
+      if constexpr (packed && sizeof(KEY_TYPE) == 4) {
+         const __m512i bitMask = _mm512_set1_epi32(static_cast<int>(bsize - 1));
+         const __m512i lastProbe = _mm512_set1_epi32(static_cast<int>(bsize - 1));
+         const __m512i empty = _mm512_set1_epi32(static_cast<int>(emptybucket));
+         const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+         const __m512i one = _mm512_set1_epi32(1);
+         __m512i key = _mm512_setzero_si512(), home = key, offset = key, idx = key;
+         __mmask16 active = 0;
+         while (true) {
+            // Refill the idle lanes with the next keys
+            if (active != 0xFFFF && next < len) {
+               const size_t avail = std::min<size_t>(len - next, 16 - __builtin_popcount(active));
+               const __mmask16 refill = static_cast<__mmask16>(lowest_bits(static_cast<uint16_t>(~active), avail));
+               key = _mm512_mask_expandloadu_epi32(key, refill, keys + next);
+               home = _mm512_mask_expandloadu_epi32(home, refill, hashes + next);
+               idx = _mm512_mask_expand_epi32(idx, refill, _mm512_add_epi32(iota, _mm512_set1_epi32(next)));
+               offset = _mm512_mask_mov_epi32(offset, refill, _mm512_setzero_si512());
+               active |= refill;
+               next += avail;
+            }
+            if (!active) {
+               break;
+            }
+            const __m512i bucket = _mm512_and_si512(_mm512_add_epi32(home, offset), bitMask);
+            const __m512i candidate = _mm512_mask_i32gather_epi32(empty, active, bucket, buckets, 8);
+            const __mmask16 found = _mm512_mask_cmpeq_epi32_mask(active, candidate, key);
+            const __mmask16 missed =
+                (_mm512_mask_cmpeq_epi32_mask(active, candidate, empty) |
+                 _mm512_mask_cmpge_epu32_mask(active, offset, lastProbe)) & ~found;
+            if (found | missed) {
+               _mm512_store_si512(pos32, bucket);
+               _mm512_store_si512(idx32, idx);
+               for (uint32_t m = found; m; m &= m - 1) {
+                  const int lane = __builtin_ctz(m);
+                  vals[idx32[lane]] = buckets[pos32[lane]].second;
+               }
+               for (uint32_t m = missed; m; m &= m - 1) {
+                  misses[nMisses++] = idx32[__builtin_ctz(m)];
+               }
+               active &= ~(found | missed);
+            }
+            offset = _mm512_add_epi32(offset, one);
+         }
+      } else if constexpr (packed && sizeof(KEY_TYPE) == 8) {
+         const __m512i bitMask = _mm512_set1_epi64(static_cast<long long>(bsize - 1));
+         const __m512i lastProbe = _mm512_set1_epi64(static_cast<long long>(bsize - 1));
+         const __m512i empty = _mm512_set1_epi64(static_cast<long long>(emptybucket));
+         const __m512i iota = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+         const __m512i one = _mm512_set1_epi64(1);
+         __m512i key = _mm512_setzero_si512(), home = key, offset = key, idx = key;
+         __mmask8 active = 0;
+         while (true) {
+            // Refill the idle lanes with the next keys
+            if (active != 0xFF && next < len) {
+               const size_t avail = std::min<size_t>(len - next, 8 - __builtin_popcount(active));
+               const __mmask8 refill = static_cast<__mmask8>(lowest_bits(static_cast<uint8_t>(~active), avail));
+               const __m512i loaded =
+                   _mm512_maskz_expandloadu_epi32(static_cast<__mmask16>((1u << avail) - 1), hashes + next);
+               key = _mm512_mask_expandloadu_epi64(key, refill, keys + next);
+               home = _mm512_mask_expand_epi64(home, refill, _mm512_cvtepu32_epi64(_mm512_castsi512_si256(loaded)));
+               idx = _mm512_mask_expand_epi64(idx, refill, _mm512_add_epi64(iota, _mm512_set1_epi64(next)));
+               offset = _mm512_mask_mov_epi64(offset, refill, _mm512_setzero_si512());
+               active |= refill;
+               next += avail;
+            }
+            if (!active) {
+               break;
+            }
+            const __m512i bucket = _mm512_and_si512(_mm512_add_epi64(home, offset), bitMask);
+            // Pairs are 16 bytes, twice the largest gather scale
+            const __m512i candidate =
+                _mm512_mask_i64gather_epi64(empty, active, _mm512_add_epi64(bucket, bucket), buckets, 8);
+            const __mmask8 found = _mm512_mask_cmpeq_epi64_mask(active, candidate, key);
+            const __mmask8 missed =
+                (_mm512_mask_cmpeq_epi64_mask(active, candidate, empty) |
+                 _mm512_mask_cmpge_epu64_mask(active, offset, lastProbe)) & ~found;
+            if (found | missed) {
+               _mm512_store_si512(pos64, bucket);
+               _mm512_store_si512(idx64, idx);
+               for (uint32_t m = found; m; m &= m - 1) {
+                  const int lane = __builtin_ctz(m);
+                  vals[idx64[lane]] = buckets[pos64[lane]].second;
+               }
+               for (uint32_t m = missed; m; m &= m - 1) {
+                  misses[nMisses++] = static_cast<uint32_t>(idx64[__builtin_ctz(m)]);
+               }
+               active &= ~(found | missed);
+            }
+            offset = _mm512_add_epi64(offset, one);
+         }
+      }
+#endif
+      (void)buckets;
+      (void)bsize;
+      (void)keys;
+      (void)hashes;
+      (void)len;
+      (void)vals;
+      (void)misses;
+      (void)emptybucket;
+      return nMisses;
+   }
+};
+
+} // namespace SIMD
+} // namespace Hashinator
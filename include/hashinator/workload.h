@@ -0,0 +1,301 @@
+/* File:    workload.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Capture of the operations a Hashmap sees and replay of them on any other Hashmap
+ *
+ * This file defines the following classes or functions:
+ *    --Hashinator::workload_op
+ *    --Hashinator::WorkloadRecorder
+ *    --Hashinator::Workload
+ *    --Hashinator::ReplayReport
+ *    --Hashinator::replay
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include "latency.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Hashinator {
+
+/*
+ * Workload files are binary and start with the magic "HNWL", a format version byte and the
+ * sizes in bytes of the key and the value type. Then come the operations in the order the
+ * map ran them, each one a workload_op byte followed by
+ *    access, find, erase:   the key
+ *    insert_batch:          a uint64_t length, the float target load factor, the keys and the values
+ *    retrieve_batch, erase_batch: a uint64_t length and the keys
+ * Keys and values are written as raw bytes in host byte order.
+ */
+enum class workload_op : uint8_t {
+   access,         // at(), operator[] and insert(pair), which insert the key when it is missing
+   find,           // find()
+   erase,          // erase(key)
+   insert_batch,   // insert() and insertIndex()
+   retrieve_batch, // retrieve()
+   erase_batch,    // erase(keys, len)
+   count
+};
+
+constexpr size_t num_workload_ops = static_cast<size_t>(workload_op::count);
+
+inline const char* name(workload_op op) noexcept {
+   static const char* names[num_workload_ops] = {"access",       "find",           "erase",
+                                                 "insert_batch", "retrieve_batch", "erase_batch"};
+   return names[static_cast<size_t>(op)];
+}
+
+namespace detail {
+constexpr char WORKLOAD_MAGIC[4] = {'H', 'N', 'W', 'L'};
+constexpr uint8_t WORKLOAD_VERSION = 2;
+} // namespace detail
+
+/**
+ * @brief Appends the operations of a map to a workload file.
+ *
+ * Calls may come from several threads; each operation is written whole under a lock.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE>
+class WorkloadRecorder {
+   static_assert(std::is_trivially_copyable<KEY_TYPE>::value && std::is_trivially_copyable<VAL_TYPE>::value,
+                 "Workloads store keys and values as raw bytes");
+
+public:
+   explicit WorkloadRecorder(const std::string& path) : out(path, std::ios::binary | std::ios::trunc) {
+      const uint8_t header[3] = {detail::WORKLOAD_VERSION, sizeof(KEY_TYPE), sizeof(VAL_TYPE)};
+      out.write(detail::WORKLOAD_MAGIC, sizeof(detail::WORKLOAD_MAGIC));
+      out.write(reinterpret_cast<const char*>(header), sizeof(header));
+   }
+
+   WorkloadRecorder(const WorkloadRecorder&) = delete;
+   WorkloadRecorder& operator=(const WorkloadRecorder&) = delete;
+
+   // False once a write has failed
+   bool good() const { return static_cast<bool>(out); }
+
+   void record(workload_op op, const KEY_TYPE& key) {
+      std::lock_guard<std::mutex> lock(mutex);
+      put(op);
+      put(key);
+   }
+
+   // vals and targetLF are only written for insert_batch
+   void record_batch(workload_op op, const KEY_TYPE* keys, const VAL_TYPE* vals, size_t len, float targetLF = 0.5f) {
+      std::lock_guard<std::mutex> lock(mutex);
+      put(op);
+      put(static_cast<uint64_t>(len));
+      if (op == workload_op::insert_batch) {
+         put(targetLF);
+      }
+      out.write(reinterpret_cast<const char*>(keys), len * sizeof(KEY_TYPE));
+      if (op == workload_op::insert_batch) {
+         out.write(reinterpret_cast<const char*>(vals), len * sizeof(VAL_TYPE));
+      }
+   }
+
+   // Same as above for hash_pair batches
+   template <typename PAIR>
+   void record_pairs(workload_op op, const PAIR* src, size_t len, float targetLF = 0.5f) {
+      std::vector<KEY_TYPE> keys(len);
+      std::vector<VAL_TYPE> vals(op == workload_op::insert_batch ? len : 0);
+      for (size_t i = 0; i < len; i++) {
+         keys[i] = src[i].first;
+         if (op == workload_op::insert_batch) {
+            vals[i] = src[i].second;
+         }
+      }
+      record_batch(op, keys.data(), vals.data(), len, targetLF);
+   }
+
+   void flush() {
+      std::lock_guard<std::mutex> lock(mutex);
+      out.flush();
+   }
+
+private:
+   template <typename T>
+   void put(const T& v) {
+      out.write(reinterpret_cast<const char*>(&v), sizeof(T));
+   }
+
+   std::mutex mutex;
+   std::ofstream out;
+};
+
+/**
+ * @brief A workload file read back into memory.
+ *
+ * The keys and values of all operations are kept in two flat arrays that every Op indexes into.
+ */
+template <typename KEY_TYPE, typename VAL_TYPE>
+struct Workload {
+   struct Op {
+      workload_op op;
+      size_t offset; // First key of the operation in keys, and first value in vals for insert_batch
+      size_t len;    // 1 for the single key operations
+      float targetLF; // Load factor the insert_batch was called with
+   };
+   std::vector<Op> ops;
+   std::vector<KEY_TYPE> keys;
+   std::vector<VAL_TYPE> vals;
+
+   // Number of keys over all operations
+   size_t elements() const { return keys.size(); }
+
+   // Reads a workload file. Returns false if it is missing, malformed or was written for other key or value types.
+   static bool load(const std::string& path, Workload& w) {
+      std::ifstream in(path, std::ios::binary | std::ios::ate);
+      const std::streamoff fileSize = in.tellg();
+      in.seekg(0);
+      char magic[sizeof(detail::WORKLOAD_MAGIC)];
+      uint8_t header[3];
+      if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, detail::WORKLOAD_MAGIC, sizeof(magic)) != 0 ||
+          !in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != detail::WORKLOAD_VERSION ||
+          header[1] != sizeof(KEY_TYPE) || header[2] != sizeof(VAL_TYPE)) {
+         return false;
+      }
+      Workload read;
+      uint8_t op;
+      while (in.read(reinterpret_cast<char*>(&op), 1)) {
+         if (op >= num_workload_ops) {
+            return false;
+         }
+         const workload_op kind = static_cast<workload_op>(op);
+         uint64_t len = 1;
+         if (kind >= workload_op::insert_batch && !in.read(reinterpret_cast<char*>(&len), sizeof(len))) {
+            return false;
+         }
+         float targetLF = 0.5f;
+         if (kind == workload_op::insert_batch && !in.read(reinterpret_cast<char*>(&targetLF), sizeof(targetLF))) {
+            return false;
+         }
+         // The length comes from the file, check it against what is left before allocating for it
+         const size_t bytesPerElement = sizeof(KEY_TYPE) + (kind == workload_op::insert_batch ? sizeof(VAL_TYPE) : 0);
+         if (len > static_cast<uint64_t>(fileSize - in.tellg()) / bytesPerElement) {
+            return false;
+         }
+         const size_t offset = read.keys.size();
+         read.keys.resize(offset + len);
+         if (!in.read(reinterpret_cast<char*>(read.keys.data() + offset), len * sizeof(KEY_TYPE))) {
+            return false;
+         }
+         if (kind == workload_op::insert_batch) {
+            read.vals.resize(offset + len);
+            if (!in.read(reinterpret_cast<char*>(read.vals.data() + offset), len * sizeof(VAL_TYPE))) {
+               return false;
+            }
+         }
+         read.ops.push_back(Op{kind, offset, static_cast<size_t>(len), targetLF});
+      }
+      if (!in.eof()) {
+         return false;
+      }
+      w = std::move(read);
+      return true;
+   }
+};
+
+/**
+ * @brief Outcome of a replay. latency[op] holds the time of every call of that kind, a whole
+ * batch counting as one call.
+ */
+struct ReplayReport {
+   size_t operations = 0; // Calls replayed
+   size_t elements = 0;   // Keys over all calls
+   double seconds = 0.0;  // Time spent in the calls
+   std::array<LatencyHistogram, num_workload_ops> latency;
+
+   // Keys per second
+   double throughput() const { return seconds > 0.0 ? elements / seconds : 0.0; }
+
+   std::string to_string() const {
+      std::ostringstream text;
+      text << operations << " operations, " << elements << " keys in " << seconds << " s: " << throughput() / 1e6
+           << " Mkeys/s\n";
+      for (size_t op = 0; op < num_workload_ops; op++) {
+         const LatencyHistogram& h = latency[op];
+         if (h.count() == 0) {
+            continue;
+         }
+         text << "  " << name(static_cast<workload_op>(op)) << ": " << h.count() << " calls, ns mean " << h.mean()
+              << " p50 " << h.percentile(50) << " p99 " << h.percentile(99) << " p99.9 " << h.percentile(99.9)
+              << " max " << h.max() << "\n";
+      }
+      return text.str();
+   }
+};
+
+/**
+ * @brief Runs the operations of w on map in their recorded order and times every call.
+ *
+ * map can be any Hashmap configuration with the same key and value types: other hash
+ * functions, hashers or policies, set up by the caller beforehand. target is handed to the
+ * batch calls, so it picks the host threads they run on, and insert batches grow the table to
+ * the load factor they were recorded with. The clock is read around every call, which the
+ * throughput of workloads made of single key operations includes.
+ */
+template <typename MAP, typename KEY_TYPE, typename VAL_TYPE, typename TARGET>
+ReplayReport replay(const Workload<KEY_TYPE, VAL_TYPE>& w, MAP& map, TARGET target) {
+   ReplayReport report;
+   // The batch calls take non const pointers but only read the keys and values
+   KEY_TYPE* keys = const_cast<KEY_TYPE*>(w.keys.data());
+   VAL_TYPE* vals = const_cast<VAL_TYPE*>(w.vals.data());
+   std::vector<VAL_TYPE> out;
+   for (const auto& op : w.ops) {
+      if (op.op == workload_op::retrieve_batch && out.size() < op.len) {
+         out.resize(op.len);
+      }
+      const auto start = std::chrono::steady_clock::now();
+      switch (op.op) {
+      case workload_op::access:
+         map[keys[op.offset]];
+         break;
+      case workload_op::find:
+         map.find(keys[op.offset]);
+         break;
+      case workload_op::erase:
+         map.erase(keys[op.offset]);
+         break;
+      case workload_op::insert_batch:
+         map.insert(keys + op.offset, vals + op.offset, op.len, op.targetLF, 0, target);
+         break;
+      case workload_op::retrieve_batch:
+         map.retrieve(keys + op.offset, out.data(), op.len, 0, target);
+         break;
+      case workload_op::erase_batch:
+         map.erase(keys + op.offset, op.len, 0, target);
+         break;
+      default:
+         break;
+      }
+      const auto ns =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      report.latency[static_cast<size_t>(op.op)].record(ns);
+      report.seconds += ns * 1e-9;
+      report.operations++;
+      report.elements += op.len;
+   }
+   return report;
+}
+
+} // namespace Hashinator
@@ -19,7 +19,74 @@
 
 #pragma once
 /* Select the compiled architecture */
-#ifdef __CUDACC__
+#ifdef SPLIT_CPU_ONLY_MODE
+/* Host emulation of the runtime, see split_stream.h */
+#include "split_stream.h"
+
+#define split_gpuGetLastError split::host_get_last_error
+#define split_gpuGetErrorString split::host_get_error_string
+#define split_gpuPeekAtLastError split::host_get_last_error
+
+#define split_gpuGetDevice split::host_get_device
+#define split_gpuDeviceSynchronize split::host_device_synchronize
+
+#define split_gpuFree split::host_free
+#define split_gpuFreeHost split::host_free
+#define split_gpuFreeAsync split::host_free_async
+#define split_gpuMalloc split::host_malloc
+#define split_gpuMallocHost split::host_malloc
+#define split_gpuMallocAsync split::host_malloc_async
+#define split_gpuMallocManaged split::host_malloc_managed
+#define split_gpuHostAlloc split::host_malloc
+#define split_gpuMemcpy split::host_memcpy
+#define split_gpuMemcpyAsync split::host_memcpy_async
+#define split_gpuMemset split::host_memset
+#define split_gpuMemsetAsync split::host_memset_async
+
+#define split_gpuMemAdviseSetAccessedBy 0
+#define split_gpuMemAdviseSetPreferredLocation 0
+#define split_gpuMemAttachSingle 0
+#define split_gpuMemAttachGlobal 0
+#define split_gpuMemPrefetchAsync split::host_mem_prefetch_async
+
+#define split_gpuStreamCreate split::host_stream_create
+#define split_gpuStreamDestroy split::host_stream_destroy
+#define split_gpuStreamWaitEvent split::host_stream_wait_event
+#define split_gpuStreamSynchronize split::host_stream_synchronize
+#define split_gpuStreamQuery split::host_stream_query
+#define split_gpuStreamAttachMemAsync split::host_stream_attach_mem_async
+#define split_gpuStreamCreateWithPriority split::host_stream_create_with_priority
+#define split_gpuStreamDefault 0
+
+#define split_gpuEventCreate split::host_event_create
+#define split_gpuEventCreateWithFlags split::host_event_create_with_flags
+#define split_gpuEventDestroy split::host_event_destroy
+#define split_gpuEventQuery split::host_event_query
+#define split_gpuEventRecord split::host_event_record
+#define split_gpuEventSynchronize split::host_event_synchronize
+#define split_gpuEventElapsedTime split::host_event_elapsed_time
+
+#define split_gpuError_t split::host_error_t
+#define split_gpuSuccess split::hostSuccess
+#define split_gpuErrorNotReady split::hostErrorNotReady
+
+#define split_gpuStream_t split::host_stream_t
+
+#define split_gpuEvent_t split::host_event_t
+#define split_gpuEventDefault 0
+#define split_gpuEventBlockingSync 0
+#define split_gpuEventDisableTiming 0
+
+#define split_gpuMemcpyKind split::host_memcpy_kind
+#define split_gpuMemcpyDeviceToHost split::hostMemcpyDeviceToHost
+#define split_gpuMemcpyHostToDevice split::hostMemcpyHostToDevice
+#define split_gpuMemcpyDeviceToDevice split::hostMemcpyDeviceToDevice
+
+#define split_gpuCpuDeviceId (-1)
+#define split_gpuMemoryAdvise int
+#define split_gpuMemAdvise split::host_mem_advise
+
+#elif defined(__CUDACC__)
 
 #define split_gpuGetLastError cudaGetLastError
 #define split_gpuGetErrorString cudaGetErrorString
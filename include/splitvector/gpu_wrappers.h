@@ -337,4 +337,184 @@ __device__ __forceinline__ T s_shuffle_up(T variable, unsigned int delta, U mask
 #endif
 }
 } // namespace split
+
+#else
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+namespace split {
+
+/*
+ * Host virtual warps.
+ * In CPU only mode a virtual warp is run by a single host thread. The value every lane
+ * holds is stored in an array of up to 64 elements and the voting wrappers compare all
+ * lanes at once with AVX2/AVX-512 when available, returning the same lane mask
+ * __ballot_sync would. The atomics map to the GCC builtins so that host threads can
+ * share a table the way concurrent warps do.
+ */
+
+/**
+ * @brief Host atomic exchange.
+ */
+template <typename T>
+inline T s_atomicExch(T* address, T val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   return __atomic_exchange_n(address, val, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Host store of a bucket value of any type.
+ *
+ * Values the hardware can store in one go (1, 2, 4 or 8 bytes, naturally aligned and
+ * trivially copyable, e.g. float) are stored atomically; anything larger gets a plain store.
+ */
+template <typename T>
+inline void s_atomicStore(T* address, const T& val) noexcept {
+   if constexpr (std::is_trivially_copyable<T>::value && alignof(T) >= sizeof(T) &&
+                 (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8)) {
+      T copy = val;
+      __atomic_store(address, &copy, __ATOMIC_RELEASE);
+   } else {
+      *address = val;
+   }
+}
+
+/**
+ * @brief Host atomic compare-and-swap. Returns the original value at address.
+ */
+template <typename T>
+inline T s_atomicCAS(T* address, T compare, T val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   __atomic_compare_exchange_n(address, &compare, val, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+   return compare;
+}
+
+/**
+ * @brief Host atomic addition. Returns the original value at address.
+ */
+template <typename T, typename U>
+inline T s_atomicAdd(T* address, U val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   return __atomic_fetch_add(address, static_cast<T>(val), __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Host atomic subtraction. Returns the original value at address.
+ */
+template <typename T, typename U>
+inline T s_atomicSub(T* address, U val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   return __atomic_fetch_sub(address, static_cast<T>(val), __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Host atomic maximum. Returns the original value at address.
+ */
+template <typename T, typename U>
+inline T s_atomicMax(T* address, U val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   T old = __atomic_load_n(address, __ATOMIC_ACQUIRE);
+   while (old < static_cast<T>(val) &&
+          !__atomic_compare_exchange_n(address, &old, static_cast<T>(val), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+   }
+   return old;
+}
+
+/**
+ * @brief Host atomic minimum. Returns the original value at address.
+ */
+template <typename T, typename U>
+inline T s_atomicMin(T* address, U val) noexcept {
+   static_assert(std::is_integral<T>::value && "Only integers supported");
+   T old = __atomic_load_n(address, __ATOMIC_ACQUIRE);
+   while (old > static_cast<T>(val) &&
+          !__atomic_compare_exchange_n(address, &old, static_cast<T>(val), true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+   }
+   return old;
+}
+
+/**
+ * @brief Host warp vote: the mask of the lanes[0, width) that hold value.
+ *
+ * @param lanes The value of every lane of the virtual warp.
+ * @param value The value voted for.
+ * @param width Virtual warp size, at most 64.
+ * @return Result mask, bit i set if lane i voted true.
+ */
+template <typename T>
+inline uint64_t s_warpVote(const T* lanes, T value, int width) noexcept {
+   uint64_t mask = 0;
+   int lane = 0;
+#if defined(__AVX512F__)
+   if constexpr (std::is_integral<T>::value && sizeof(T) == 4) {
+      const __m512i v = _mm512_set1_epi32(static_cast<int>(value));
+      for (; lane < width; lane += 16) {
+         const __mmask16 valid = (width - lane >= 16) ? 0xFFFF : static_cast<__mmask16>((1u << (width - lane)) - 1);
+         mask |= static_cast<uint64_t>(_mm512_mask_cmpeq_epi32_mask(valid, _mm512_maskz_loadu_epi32(valid, lanes + lane), v))
+                 << lane;
+      }
+   } else if constexpr (std::is_integral<T>::value && sizeof(T) == 8) {
+      const __m512i v = _mm512_set1_epi64(static_cast<long long>(value));
+      for (; lane < width; lane += 8) {
+         const __mmask8 valid = (width - lane >= 8) ? 0xFF : static_cast<__mmask8>((1u << (width - lane)) - 1);
+         mask |= static_cast<uint64_t>(_mm512_mask_cmpeq_epi64_mask(valid, _mm512_maskz_loadu_epi64(valid, lanes + lane), v))
+                 << lane;
+      }
+   }
+#elif defined(__AVX2__)
+   if constexpr (std::is_integral<T>::value && sizeof(T) == 4) {
+      const __m256i v = _mm256_set1_epi32(static_cast<int>(value));
+      for (; lane + 8 <= width; lane += 8) {
+         const __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + lane)), v);
+         mask |= static_cast<uint64_t>(_mm256_movemask_ps(_mm256_castsi256_ps(eq))) << lane;
+      }
+   } else if constexpr (std::is_integral<T>::value && sizeof(T) == 8) {
+      const __m256i v = _mm256_set1_epi64x(static_cast<long long>(value));
+      for (; lane + 4 <= width; lane += 4) {
+         const __m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + lane)), v);
+         mask |= static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(eq))) << lane;
+      }
+   }
+#endif
+   for (; lane < width; lane++) {
+      mask |= static_cast<uint64_t>(lanes[lane] == value) << lane;
+   }
+   return mask;
+}
+
+/**
+ * @brief Host warp vote (any): whether any of lanes[0, width) holds value.
+ */
+template <typename T>
+inline bool s_warpVoteAny(const T* lanes, T value, int width) noexcept {
+   return s_warpVote(lanes, value, width) != 0;
+}
+
+/**
+ * @brief Index of the first set bit in a mask, 1 based like __ffs. 0 if no bit is set.
+ */
+template <typename T>
+inline int s_findFirstSig(T mask) noexcept {
+   return __builtin_ffsll(static_cast<long long>(mask));
+}
+
+/**
+ * @brief Number of set bits in a mask.
+ */
+template <typename T>
+inline uint32_t s_pop_count(T mask) noexcept {
+   return __builtin_popcountll(static_cast<unsigned long long>(mask));
+}
+
+/**
+ * @brief Host broadcast shuffle: the value lane source holds.
+ */
+template <typename T>
+inline T s_shuffle(const T* lanes, unsigned int source) noexcept {
+   return lanes[source];
+}
+} // namespace split
 #endif
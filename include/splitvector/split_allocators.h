@@ -23,7 +23,10 @@
 #pragma once
 #include "archMacros.h"
 #include "gpu_wrappers.h"
+#include "split_instrument.h"
+#include "split_trace.h"
 #include <cassert>
+#include <iostream>
 namespace split {
 
 #ifndef SPLIT_CPU_ONLY_MODE
@@ -86,32 +89,42 @@ public:
    const_pointer address(const_reference x) const { return &x; }
 
    pointer allocate(size_type n, const void* /*hint*/ = 0) {
+      SPLIT_TRACE_SCOPE_N("split_unified_allocator::allocate", n * sizeof(value_type));
       T* ret;
       assert(n && "allocate 0");
       SPLIT_CHECK_ERR(split_gpuMallocManaged((void**)&ret, n * sizeof(value_type)));
       if (ret == nullptr) {
          throw std::bad_alloc();
       }
+      SPLIT_INSTRUMENT_COUNT(allocations, 1);
+      SPLIT_INSTRUMENT_COUNT(allocated_bytes, n * sizeof(value_type));
       return ret;
    }
 
    static void* allocate_raw(size_type n, const void* /*hint*/ = 0) {
+      SPLIT_TRACE_SCOPE_N("split_unified_allocator::allocate", n);
       void* ret;
       SPLIT_CHECK_ERR(split_gpuMallocManaged((void**)&ret, n));
       if (ret == nullptr) {
          throw std::bad_alloc();
       }
+      SPLIT_INSTRUMENT_COUNT(allocations, 1);
+      SPLIT_INSTRUMENT_COUNT(allocated_bytes, n);
       return ret;
    }
 
    void deallocate(pointer p, size_type n) {
       if (n != 0 && p != 0) {
+         SPLIT_TRACE_SCOPE("split_unified_allocator::deallocate");
          SPLIT_CHECK_ERR(split_gpuFree(p));
+         SPLIT_INSTRUMENT_COUNT(deallocations, 1);
       }
    }
    static void deallocate(void* p, size_type n) {
       if (n != 0 && p != 0) {
+         SPLIT_TRACE_SCOPE("split_unified_allocator::deallocate");
          SPLIT_CHECK_ERR(split_gpuFree(p));
+         SPLIT_INSTRUMENT_COUNT(deallocations, 1);
       }
    }
 
@@ -128,6 +141,15 @@ public:
    void destroy(pointer p) { p->~value_type(); }
 };
 
+#else
+/* Define the host error checking macro */
+#define SPLIT_CHECK_ERR(err) (split::host_error(err, __FILE__, __LINE__))
+inline void host_error(host_error_t err, const char* file, int line) {
+   if (err != hostSuccess) {
+      std::cerr << "\n\n" << host_get_error_string(err) << " in " << file << " at line " << line << "\n";
+      abort();
+   }
+}
 #endif
 
 /**
@@ -168,24 +190,42 @@ public:
    const_pointer address(const_reference x) const { return &x; }
 
    pointer allocate(size_type n, const void* /*hint*/ = 0) {
+      SPLIT_TRACE_SCOPE_N("split_host_allocator::allocate", n * sizeof(value_type));
       pointer const ret = reinterpret_cast<pointer>(malloc(n * sizeof(value_type)));
       if (ret == nullptr) {
          throw std::bad_alloc();
       }
+      SPLIT_INSTRUMENT_COUNT(allocations, 1);
+      SPLIT_INSTRUMENT_COUNT(allocated_bytes, n * sizeof(value_type));
       return ret;
    }
 
    static void* allocate_raw(size_type n, const void* /*hint*/ = 0) {
+      SPLIT_TRACE_SCOPE_N("split_host_allocator::allocate", n);
       void* ret = (void*)malloc(n);
       if (ret == nullptr) {
          throw std::bad_alloc();
       }
+      SPLIT_INSTRUMENT_COUNT(allocations, 1);
+      SPLIT_INSTRUMENT_COUNT(allocated_bytes, n);
       return ret;
    }
 
-   void deallocate(pointer p, size_type) { free(p); }
+   void deallocate(pointer p, size_type) {
+      SPLIT_TRACE_SCOPE("split_host_allocator::deallocate");
+      if (p != nullptr) {
+         SPLIT_INSTRUMENT_COUNT(deallocations, 1);
+      }
+      free(p);
+   }
 
-   static void deallocate(void* p, size_type) { free(p); }
+   static void deallocate(void* p, size_type) {
+      SPLIT_TRACE_SCOPE("split_host_allocator::deallocate");
+      if (p != nullptr) {
+         SPLIT_INSTRUMENT_COUNT(deallocations, 1);
+      }
+      free(p);
+   }
 
    size_type max_size() const throw() {
       size_type max = static_cast<size_type>(-1) / sizeof(value_type);
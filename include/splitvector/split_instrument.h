@@ -0,0 +1,190 @@
+/* File:    split_instrument.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Opt in operation counters for the hot paths
+ *
+ * This file defines the following classes or functions:
+ *    --split::instrument::counter
+ *    --split::instrument::snapshot
+ *    --split::instrument::reset
+ *    --SPLIT_INSTRUMENT_COUNT / SPLIT_INSTRUMENT_TIME
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#ifdef SPLIT_INSTRUMENT
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#endif
+
+namespace split {
+namespace instrument {
+
+/*
+ * Counters are only compiled in with -DSPLIT_INSTRUMENT (or -DHASHINATOR_INSTRUMENT, which
+ * implies it). Every host thread bumps its own copy of the counters without any atomic read
+ * modify write; snapshot() sums the copies of the live threads and of the threads that
+ * have already exited; reset() should not race with threads that are counting. Without the
+ * flag the macros expand to nothing and snapshot() reads all zeros. Device code is never
+ * instrumented.
+ */
+enum class counter : size_t {
+   lookups,          // Single key host lookups and insertions (find, at, operator[], ...)
+   probes,           // Buckets visited by those lookups
+   cas_failures,     // Compare and swaps that lost a race for a bucket
+   rehashes,         // Rebuilds of the buckets
+   rehash_ns,        // Host time spent in rebuilds
+   tombstone_reuses, // Insertions that took the place of a tombstone
+   cleanups,         // Calls to Hashmap::performCleanupTasks()
+   allocations,      // Allocator calls that got memory
+   allocated_bytes,  // Bytes handed out by those calls
+   deallocations,    // Allocator calls that gave memory back
+   count
+};
+
+constexpr size_t num_counters = static_cast<size_t>(counter::count);
+
+using Counters = std::array<uint64_t, num_counters>;
+
+inline const char* name(counter c) noexcept {
+   static const char* names[num_counters] = {"lookups",     "probes",          "cas_failures",
+                                             "rehashes",    "rehash_ns",       "tombstone_reuses",
+                                             "cleanups",    "allocations",     "allocated_bytes",
+                                             "deallocations"};
+   return names[static_cast<size_t>(c)];
+}
+
+inline uint64_t get(const Counters& counters, counter c) noexcept { return counters[static_cast<size_t>(c)]; }
+
+#ifdef SPLIT_INSTRUMENT
+
+class Registry;
+
+// Counters of one thread. Only their own thread writes them.
+struct Slot {
+   std::array<std::atomic<uint64_t>, num_counters> values{};
+   int timers = 0; // Nesting depth of the running SPLIT_INSTRUMENT_TIME scopes
+   Slot();
+   ~Slot();
+};
+
+class Registry {
+public:
+   static Registry& get() {
+      static Registry registry;
+      return registry;
+   }
+
+   void attach(Slot* slot) {
+      std::lock_guard<std::mutex> lock(mutex);
+      slots.insert(slot);
+   }
+
+   // Keeps the counts of exiting threads
+   void detach(Slot* slot) {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < num_counters; i++) {
+         retired[i] += slot->values[i].load(std::memory_order_relaxed);
+      }
+      slots.erase(slot);
+   }
+
+   Counters snapshot() {
+      std::lock_guard<std::mutex> lock(mutex);
+      Counters total = retired;
+      for (const Slot* slot : slots) {
+         for (size_t i = 0; i < num_counters; i++) {
+            total[i] += slot->values[i].load(std::memory_order_relaxed);
+         }
+      }
+      return total;
+   }
+
+   void reset() {
+      std::lock_guard<std::mutex> lock(mutex);
+      retired.fill(0);
+      for (Slot* slot : slots) {
+         for (auto& v : slot->values) {
+            v.store(0, std::memory_order_relaxed);
+         }
+      }
+   }
+
+private:
+   std::mutex mutex;
+   std::set<Slot*> slots;
+   Counters retired{};
+};
+
+inline Slot::Slot() { Registry::get().attach(this); }
+
+inline Slot::~Slot() { Registry::get().detach(this); }
+
+inline Slot& local() {
+   thread_local Slot slot;
+   return slot;
+}
+
+inline void add(counter c, uint64_t n) noexcept {
+   std::atomic<uint64_t>& v = local().values[static_cast<size_t>(c)];
+   v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Adds the time spent in its scope to a counter. Nested timers on the same thread only count once.
+class ScopedTimer {
+public:
+   explicit ScopedTimer(counter c) : c(c), start(std::chrono::steady_clock::now()) { local().timers++; }
+   ~ScopedTimer() {
+      if (--local().timers == 0) {
+         add(c, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start)
+                    .count());
+      }
+   }
+   ScopedTimer(const ScopedTimer&) = delete;
+   ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+   counter c;
+   std::chrono::steady_clock::time_point start;
+};
+
+// Sum of the counters over every thread
+inline Counters snapshot() { return Registry::get().snapshot(); }
+
+inline void reset() { Registry::get().reset(); }
+
+#else
+inline Counters snapshot() { return Counters{}; }
+
+inline void reset() {}
+#endif
+
+} // namespace instrument
+} // namespace split
+
+#if defined(SPLIT_INSTRUMENT) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define SPLIT_INSTRUMENT_COUNT(c, n) split::instrument::add(split::instrument::counter::c, (n))
+#define SPLIT_INSTRUMENT_CONCAT_(a, b) a##b
+#define SPLIT_INSTRUMENT_CONCAT(a, b) SPLIT_INSTRUMENT_CONCAT_(a, b)
+#define SPLIT_INSTRUMENT_TIME(c)                                                                                       \
+   split::instrument::ScopedTimer SPLIT_INSTRUMENT_CONCAT(splitInstrumentTimer, __LINE__)(split::instrument::counter::c)
+#else
+#define SPLIT_INSTRUMENT_COUNT(c, n) ((void)0)
+#define SPLIT_INSTRUMENT_TIME(c) ((void)0)
+#endif
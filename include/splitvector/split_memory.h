@@ -0,0 +1,161 @@
+/* File:    split_memory.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Memory footprint of the containers and an opt in registry of the live ones
+ *
+ * This file defines the following classes or functions:
+ *    --split::MemoryUsage
+ *    --split::memory::Totals
+ *    --split::memory::totals
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#ifdef SPLIT_MEMORY_REGISTRY
+#include <map>
+#include <mutex>
+#include <utility>
+#endif
+
+namespace split {
+
+/**
+ * @brief Bytes a container has allocated, as returned by memory_usage().
+ *
+ * Only the allocations a container makes are counted; the object itself and whatever it
+ * holds inline belong to its owner, who knows whether it lives on the stack, in an array or
+ * on the heap.
+ */
+struct MemoryUsage {
+   size_t payload = 0;  // Elements held
+   size_t slack = 0;    // Capacity reserved but not holding elements, e.g. empty buckets
+   size_t overhead = 0; // Bookkeeping: size and capacity words, map info, device copies, recorders
+
+   size_t total() const noexcept { return payload + slack + overhead; }
+
+   MemoryUsage& operator+=(const MemoryUsage& other) noexcept {
+      payload += other.payload;
+      slack += other.slack;
+      overhead += other.overhead;
+      return *this;
+   }
+};
+
+namespace memory {
+
+enum class kind : uint8_t { vector, hashmap };
+
+// Sums over the live containers. SplitVectors that are members of a Hashmap are counted with the map.
+struct Totals {
+   MemoryUsage vectors;
+   size_t liveVectors = 0;
+   MemoryUsage hashmaps;
+   size_t liveHashmaps = 0;
+
+   MemoryUsage total() const noexcept {
+      MemoryUsage sum = vectors;
+      sum += hashmaps;
+      return sum;
+   }
+};
+
+/*
+ * The registry is only compiled in with -DSPLIT_MEMORY_REGISTRY (or
+ * -DHASHINATOR_MEMORY_REGISTRY, which implies it). Containers add themselves when they are
+ * constructed and leave before they free anything, under a lock. totals() calls
+ * memory_usage() on every live container without locking the containers themselves, so it
+ * should not race with threads resizing them. Without the flag totals() reads all zeros.
+ */
+#ifdef SPLIT_MEMORY_REGISTRY
+
+class Registry {
+public:
+   using Usage = MemoryUsage (*)(const void*);
+
+   static Registry& get() {
+      static Registry registry;
+      return registry;
+   }
+
+   void track(const void* container, kind k, Usage usage) {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries[{container, k}] = Entry{usage, false};
+   }
+
+   void untrack(const void* container, kind k) {
+      std::lock_guard<std::mutex> lock(mutex);
+      entries.erase({container, k});
+   }
+
+   // Leaves a member container out of the sums since its owner already counts it
+   void adopt(const void* member, kind k) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = entries.find({member, k});
+      if (it != entries.end()) {
+         it->second.member = true;
+      }
+   }
+
+   Totals totals() {
+      std::lock_guard<std::mutex> lock(mutex);
+      Totals t;
+      for (const auto& [key, entry] : entries) {
+         if (entry.member) {
+            continue;
+         }
+         if (key.second == kind::vector) {
+            t.vectors += entry.usage(key.first);
+            t.liveVectors++;
+         } else {
+            t.hashmaps += entry.usage(key.first);
+            t.liveHashmaps++;
+         }
+      }
+      return t;
+   }
+
+private:
+   struct Entry {
+      Usage usage;
+      bool member;
+   };
+   std::mutex mutex;
+   std::map<std::pair<const void*, kind>, Entry> entries;
+};
+
+inline void track(const void* container, kind k, Registry::Usage usage) {
+   Registry::get().track(container, k, usage);
+}
+
+inline void untrack(const void* container, kind k) { Registry::get().untrack(container, k); }
+
+inline void adopt(const void* member, kind k) { Registry::get().adopt(member, k); }
+
+inline Totals totals() { return Registry::get().totals(); }
+
+#else
+template <typename Usage>
+inline void track(const void*, kind, Usage) {}
+
+inline void untrack(const void*, kind) {}
+
+inline void adopt(const void*, kind) {}
+
+inline Totals totals() { return Totals{}; }
+#endif
+
+} // namespace memory
+} // namespace split
@@ -0,0 +1,325 @@
+/* File:    split_pool.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Host thread pool and execution policies used to run
+ *              the CPU only versions of the parallel kernels
+ *
+ * This file defines the following classes or functions:
+ *    --split::ThreadPool
+ *    --split::execution_policy
+ *    --split::adaptive_threshold
+ *    --split::host_concurrency
+ *    --split::set_host_concurrency
+ *    --split::parallel_for
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(SPLIT_USE_OPENMP)
+#include <omp.h>
+#elif defined(SPLIT_USE_STD_EXECUTION)
+#include <execution>
+#include <numeric>
+#endif
+
+namespace split {
+
+/**
+ * @brief Fixed size work stealing pool of host threads.
+ *
+ * The workers are started once and sleep between jobs so that a parallel_for does not pay
+ * for thread creation. The calling thread always takes part in the job it submits.
+ * Every thread starts on its own contiguous range of chunks and takes them from the front;
+ * once it runs dry it steals the back half of another thread's range, so uneven chunks
+ * balance out while each thread keeps walking through neighbouring memory.
+ * Jobs submitted from different threads are run one after the other and a parallel_for
+ * called from inside a job runs serially on the calling thread.
+ * set_active_threads() lets fewer threads than were started take part in the next jobs,
+ * the others sit the jobs out, so scaling can be measured without restarting the pool.
+ */
+class ThreadPool {
+public:
+   explicit ThreadPool(size_t nThreads = std::max(1u, std::thread::hardware_concurrency()))
+       : slots(new Slot[std::max<size_t>(nThreads, 1)]), active(std::max<size_t>(nThreads, 1)) {
+      for (size_t t = 1; t < nThreads; t++) {
+         workers.emplace_back([this, t]() { work(t); });
+      }
+   }
+
+   ~ThreadPool() {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stop = true;
+      }
+      wake.notify_all();
+      for (auto& w : workers) {
+         w.join();
+      }
+   }
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // Pool shared by everything in the library. Its size can be set with SPLIT_NUM_THREADS.
+   static ThreadPool& global() {
+      static ThreadPool pool([]() -> size_t {
+         const char* env = std::getenv("SPLIT_NUM_THREADS");
+         const long nThreads = env ? std::strtol(env, nullptr, 10) : 0;
+         return nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+      }());
+      return pool;
+   }
+
+   // Number of threads that run a job, including the calling one
+   size_t size() const noexcept { return workers.size() + 1; }
+
+   // Number of threads that take part in the next jobs, between 1 and size()
+   size_t active_threads() const noexcept { return active.load(std::memory_order_relaxed); }
+
+   void set_active_threads(size_t nThreads) noexcept {
+      active.store(std::clamp<size_t>(nThreads, 1, size()), std::memory_order_relaxed);
+   }
+
+   /**
+    * @brief Runs body(begin, end) over [0, n) in chunks of grain elements and waits for it.
+    *
+    * Chunk boundaries are multiples of grain. body must not throw.
+    */
+   template <typename Body>
+   void parallel_for(size_t n, size_t grain, Body&& body) {
+      if (n == 0) {
+         return;
+      }
+      // Chunk ranges are packed in 32 bits each
+      grain = std::max<size_t>({grain, 1, n / std::numeric_limits<uint32_t>::max() + 1});
+      const size_t nChunks = n / grain + (n % grain != 0);
+      const size_t nSlots = active_threads();
+      if (nChunks == 1 || nSlots == 1 || in_job()) {
+         body(static_cast<size_t>(0), n);
+         return;
+      }
+
+      std::lock_guard<std::mutex> submit(submitMutex);
+      for (size_t t = 0; t < nSlots; t++) {
+         slots[t].range.store(pack(t * nChunks / nSlots, (t + 1) * nChunks / nSlots), std::memory_order_relaxed);
+      }
+      auto run = [&](size_t self) {
+         if (self >= nSlots) {
+            return;
+         }
+         size_t c;
+         do {
+            while (pop(self, c)) {
+               body(c * grain, std::min(n, (c + 1) * grain));
+            }
+         } while (steal(self, nSlots));
+      };
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         job = run;
+         pending = workers.size();
+         generation++;
+      }
+      wake.notify_all();
+
+      in_job() = true;
+      run(0);
+      in_job() = false;
+
+      std::unique_lock<std::mutex> lock(mutex);
+      done.wait(lock, [this]() { return pending == 0; });
+      job = nullptr;
+   }
+
+private:
+   // Chunks [begin, end) still waiting in a thread's range, begin in the upper half
+   struct alignas(64) Slot {
+      std::atomic<uint64_t> range{0};
+   };
+
+   std::vector<std::thread> workers;
+   std::unique_ptr<Slot[]> slots; // One per thread, slot 0 belongs to the caller
+   std::atomic<size_t> active;    // Threads taking part in a job, the first slots
+   std::mutex submitMutex;        // Serializes jobs from different callers
+   std::mutex mutex;              // Guards the members below
+   std::condition_variable wake;
+   std::condition_variable done;
+   std::function<void(size_t)> job;
+   size_t pending = 0;
+   size_t generation = 0;
+   bool stop = false;
+
+   static constexpr uint64_t pack(uint64_t begin, uint64_t end) noexcept { return (begin << 32) | end; }
+   static constexpr uint32_t first(uint64_t range) noexcept { return static_cast<uint32_t>(range >> 32); }
+   static constexpr uint32_t last(uint64_t range) noexcept { return static_cast<uint32_t>(range); }
+
+   static bool& in_job() noexcept {
+      thread_local bool inside = false;
+      return inside;
+   }
+
+   // Takes the first chunk of the thread's own range
+   bool pop(size_t self, size_t& chunk) noexcept {
+      std::atomic<uint64_t>& range = slots[self].range;
+      uint64_t r = range.load(std::memory_order_acquire);
+      while (first(r) < last(r)) {
+         if (range.compare_exchange_weak(r, pack(first(r) + 1, last(r)), std::memory_order_acq_rel)) {
+            chunk = first(r);
+            return true;
+         }
+      }
+      return false;
+   }
+
+   // Moves the back half of the next busy thread's range among the first nSlots into the (empty)
+   // range of self. Only the owner writes an empty range, so the plain store cannot race with other thieves.
+   bool steal(size_t self, size_t nSlots) noexcept {
+      for (size_t k = 1; k < nSlots; k++) {
+         std::atomic<uint64_t>& victim = slots[(self + k) % nSlots].range;
+         uint64_t r = victim.load(std::memory_order_acquire);
+         while (first(r) < last(r)) {
+            const uint32_t mid = first(r) + (last(r) - first(r)) / 2;
+            if (victim.compare_exchange_weak(r, pack(first(r), mid), std::memory_order_acq_rel)) {
+               slots[self].range.store(pack(mid, last(r)), std::memory_order_release);
+               return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   void work(size_t self) {
+      in_job() = true;
+      size_t seen = 0;
+      while (true) {
+         std::function<void(size_t)> task;
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen]() { return stop || generation != seen; });
+            if (stop) {
+               return;
+            }
+            seen = generation;
+            task = job;
+         }
+         task(self);
+         std::lock_guard<std::mutex> lock(mutex);
+         if (--pending == 0) {
+            done.notify_one();
+         }
+      }
+   }
+};
+
+/**
+ * @brief Enum for specifying how host side batch work is run.
+ *
+ * serial:   on the calling thread, or on the stream the call was enqueued on.
+ * parallel: spread over the host backend.
+ * adaptive: serial for batches smaller than adaptive_threshold(), parallel otherwise.
+ */
+enum class execution_policy { serial, parallel, adaptive };
+
+// Batch size below which the adaptive policy stays serial. Can be set with SPLIT_SERIAL_THRESHOLD.
+inline std::atomic<size_t>& adaptive_threshold() noexcept {
+   static std::atomic<size_t> threshold([]() -> size_t {
+      const char* env = std::getenv("SPLIT_SERIAL_THRESHOLD");
+      const long n = env ? std::strtol(env, nullptr, 10) : -1;
+      return n >= 0 ? n : 4096;
+   }());
+   return threshold;
+}
+
+// True if a batch of n elements is spread over threads under policy
+inline bool runs_parallel(execution_policy policy, size_t n) noexcept {
+   return policy == execution_policy::parallel ||
+          (policy == execution_policy::adaptive && n >= adaptive_threshold().load(std::memory_order_relaxed));
+}
+
+// Number of threads a parallel batch is spread over
+inline size_t host_concurrency() {
+#if defined(SPLIT_USE_OPENMP)
+   return omp_get_max_threads();
+#elif defined(SPLIT_USE_STD_EXECUTION)
+   return std::max(1u, std::thread::hardware_concurrency());
+#else
+   return ThreadPool::global().active_threads();
+#endif
+}
+
+/**
+ * @brief Spreads the next parallel batches over nThreads threads, or as many as the backend has.
+ *
+ * The global pool cannot grow past the SPLIT_NUM_THREADS it was started with and OpenMP
+ * follows omp_set_num_threads(). The standard parallel algorithms pick their own threads,
+ * so with SPLIT_USE_STD_EXECUTION this does nothing. Returns host_concurrency() afterwards.
+ */
+inline size_t set_host_concurrency(size_t nThreads) {
+#if defined(SPLIT_USE_OPENMP)
+   omp_set_num_threads(static_cast<int>(std::max<size_t>(nThreads, 1)));
+#elif !defined(SPLIT_USE_STD_EXECUTION)
+   ThreadPool::global().set_active_threads(nThreads);
+#else
+   (void)nThreads;
+#endif
+   return host_concurrency();
+}
+
+/**
+ * @brief Runs body(begin, end) over [0, n) under policy and waits for it.
+ *
+ * Parallel work goes to ThreadPool::global(), or to OpenMP or the standard parallel
+ * algorithms when built with SPLIT_USE_OPENMP or SPLIT_USE_STD_EXECUTION. Chunk boundaries
+ * are multiples of grain, but serial runs call body once with the whole range.
+ */
+template <typename Body>
+inline void parallel_for(size_t n, size_t grain, Body&& body, execution_policy policy = execution_policy::parallel) {
+   if (n == 0) {
+      return;
+   }
+   if (!runs_parallel(policy, n)) {
+      body(static_cast<size_t>(0), n);
+      return;
+   }
+#if defined(SPLIT_USE_OPENMP)
+   grain = std::max<size_t>(grain, 1);
+   const int64_t nChunks = n / grain + (n % grain != 0);
+#pragma omp parallel for schedule(dynamic)
+   for (int64_t c = 0; c < nChunks; c++) {
+      body(c * grain, std::min(n, (c + 1) * grain));
+   }
+#elif defined(SPLIT_USE_STD_EXECUTION)
+   grain = std::max<size_t>(grain, 1);
+   std::vector<size_t> chunks(n / grain + (n % grain != 0));
+   std::iota(chunks.begin(), chunks.end(), static_cast<size_t>(0));
+   std::for_each(std::execution::par, chunks.begin(), chunks.end(),
+                 [&](size_t c) { body(c * grain, std::min(n, (c + 1) * grain)); });
+#else
+   ThreadPool::global().parallel_for(n, grain, std::forward<Body>(body));
+#endif
+}
+
+} // namespace split
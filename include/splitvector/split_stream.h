@@ -0,0 +1,351 @@
+/* File:    split_stream.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Host emulation of GPU streams and events for
+ *              CPU only mode
+ *
+ * This file defines the following classes or functions:
+ *    --split::HostStream
+ *    --split::HostEvent
+ *    --split::host_launch
+ *    --split::host_stream* / split::host_event* / split::host_mem*
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace split {
+
+/*
+ * Streams in CPU only mode.
+ * A HostStream is an ordered task queue drained by its own worker thread, so work
+ * enqueued on it runs in order and asynchronously to the caller, like work on a GPU
+ * stream. Tasks that are data parallel themselves (the HostHasher) hand their work to
+ * split::ThreadPool::global(). The null stream behaves like a per thread default stream:
+ * its work runs right away on the calling thread, so code that passes s=0 stays
+ * synchronous.
+ */
+
+enum host_error_t { hostSuccess = 0, hostErrorInvalidValue = 1, hostErrorNotReady = 600 };
+
+enum host_memcpy_kind { hostMemcpyHostToHost, hostMemcpyHostToDevice, hostMemcpyDeviceToHost, hostMemcpyDeviceToDevice };
+
+class HostStream {
+public:
+   HostStream() : worker([this]() { work(); }) {}
+
+   // Pending work is finished before the stream goes away
+   ~HostStream() {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         stop = true;
+      }
+      wake.notify_one();
+      worker.join();
+   }
+
+   HostStream(const HostStream&) = delete;
+   HostStream& operator=(const HostStream&) = delete;
+
+   void enqueue(std::function<void()> task) {
+      {
+         std::lock_guard<std::mutex> lock(mutex);
+         tasks.push_back(std::move(task));
+      }
+      wake.notify_one();
+   }
+
+   // Waits until every task enqueued so far has run
+   void synchronize() {
+      std::unique_lock<std::mutex> lock(mutex);
+      idle.wait(lock, [this]() { return tasks.empty() && !busy; });
+   }
+
+   bool query() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return tasks.empty() && !busy;
+   }
+
+   // Every live stream, for host_device_synchronize()
+   static std::set<HostStream*>& registry() {
+      static std::set<HostStream*> streams;
+      return streams;
+   }
+
+   static std::mutex& registry_mutex() {
+      static std::mutex m;
+      return m;
+   }
+
+private:
+   std::mutex mutex;
+   std::condition_variable wake;
+   std::condition_variable idle;
+   std::deque<std::function<void()>> tasks;
+   bool busy = false;
+   bool stop = false;
+   std::thread worker;
+
+   void work() {
+      while (true) {
+         std::function<void()> task;
+         {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stop || !tasks.empty(); });
+            if (tasks.empty()) {
+               return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            busy = true;
+         }
+         task();
+         std::lock_guard<std::mutex> lock(mutex);
+         busy = false;
+         if (tasks.empty()) {
+            idle.notify_all();
+         }
+      }
+   }
+};
+
+/*
+ * Events mark a point in a stream. Every record gets a ticket and the event is complete
+ * once the stream has reached the last ticket handed out.
+ */
+struct HostEvent {
+   std::mutex mutex;
+   std::condition_variable reached;
+   uint64_t recorded = 0;
+   uint64_t completed = 0;
+   std::chrono::steady_clock::time_point stamp;
+
+   void complete(uint64_t ticket) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (ticket > completed) {
+         completed = ticket;
+         stamp = std::chrono::steady_clock::now();
+      }
+      reached.notify_all();
+   }
+
+   void wait(uint64_t ticket) {
+      std::unique_lock<std::mutex> lock(mutex);
+      reached.wait(lock, [this, ticket]() { return completed >= ticket; });
+   }
+};
+
+using host_stream_t = HostStream*;
+using host_event_t = HostEvent*;
+
+/**
+ * @brief Runs task on stream s, or right away on the calling thread for the null stream.
+ */
+template <typename Task>
+inline void host_launch(host_stream_t s, Task&& task) {
+   if (s == nullptr) {
+      task();
+      return;
+   }
+   s->enqueue(std::forward<Task>(task));
+}
+
+inline host_error_t host_stream_create(host_stream_t* s) {
+   *s = new HostStream();
+   std::lock_guard<std::mutex> lock(HostStream::registry_mutex());
+   HostStream::registry().insert(*s);
+   return hostSuccess;
+}
+
+inline host_error_t host_stream_create_with_priority(host_stream_t* s, unsigned int, int) {
+   return host_stream_create(s);
+}
+
+inline host_error_t host_stream_destroy(host_stream_t s) {
+   if (s == nullptr) {
+      return hostErrorInvalidValue;
+   }
+   {
+      std::lock_guard<std::mutex> lock(HostStream::registry_mutex());
+      HostStream::registry().erase(s);
+   }
+   delete s;
+   return hostSuccess;
+}
+
+inline host_error_t host_stream_synchronize(host_stream_t s) {
+   if (s != nullptr) {
+      s->synchronize();
+   }
+   return hostSuccess;
+}
+
+inline host_error_t host_stream_query(host_stream_t s) {
+   return (s == nullptr || s->query()) ? hostSuccess : hostErrorNotReady;
+}
+
+// Waits for every live stream
+inline host_error_t host_device_synchronize() {
+   std::set<HostStream*> streams;
+   {
+      std::lock_guard<std::mutex> lock(HostStream::registry_mutex());
+      streams = HostStream::registry();
+   }
+   for (auto* s : streams) {
+      s->synchronize();
+   }
+   return hostSuccess;
+}
+
+inline host_error_t host_event_create(host_event_t* e) {
+   *e = new HostEvent();
+   return hostSuccess;
+}
+
+inline host_error_t host_event_create_with_flags(host_event_t* e, unsigned int) { return host_event_create(e); }
+
+inline host_error_t host_event_destroy(host_event_t e) {
+   if (e == nullptr) {
+      return hostErrorInvalidValue;
+   }
+   // Pending records still point to the event
+   e->wait(e->recorded);
+   delete e;
+   return hostSuccess;
+}
+
+inline host_error_t host_event_record(host_event_t e, host_stream_t s = nullptr) {
+   uint64_t ticket;
+   {
+      std::lock_guard<std::mutex> lock(e->mutex);
+      ticket = ++e->recorded;
+   }
+   host_launch(s, [e, ticket]() { e->complete(ticket); });
+   return hostSuccess;
+}
+
+inline host_error_t host_event_query(host_event_t e) {
+   std::lock_guard<std::mutex> lock(e->mutex);
+   return (e->completed >= e->recorded) ? hostSuccess : hostErrorNotReady;
+}
+
+inline host_error_t host_event_synchronize(host_event_t e) {
+   uint64_t ticket;
+   {
+      std::lock_guard<std::mutex> lock(e->mutex);
+      ticket = e->recorded;
+   }
+   e->wait(ticket);
+   return hostSuccess;
+}
+
+// Work enqueued on s after this call waits for the last record of e
+inline host_error_t host_stream_wait_event(host_stream_t s, host_event_t e, unsigned int = 0) {
+   uint64_t ticket;
+   {
+      std::lock_guard<std::mutex> lock(e->mutex);
+      ticket = e->recorded;
+   }
+   host_launch(s, [e, ticket]() { e->wait(ticket); });
+   return hostSuccess;
+}
+
+inline host_error_t host_event_elapsed_time(float* ms, host_event_t start, host_event_t stop) {
+   if (host_event_query(start) != hostSuccess || host_event_query(stop) != hostSuccess) {
+      return hostErrorNotReady;
+   }
+   *ms = std::chrono::duration<float, std::milli>(stop->stamp - start->stamp).count();
+   return hostSuccess;
+}
+
+inline host_error_t host_malloc(void** ptr, size_t size) {
+   *ptr = std::malloc(size);
+   return (*ptr == nullptr && size > 0) ? hostErrorInvalidValue : hostSuccess;
+}
+
+inline host_error_t host_malloc_managed(void** ptr, size_t size, unsigned int = 0) { return host_malloc(ptr, size); }
+
+// Stream ordered allocation: the memory is usable by work enqueued on s from now on
+inline host_error_t host_malloc_async(void** ptr, size_t size, host_stream_t) { return host_malloc(ptr, size); }
+
+inline host_error_t host_free(void* ptr) {
+   std::free(ptr);
+   return hostSuccess;
+}
+
+inline host_error_t host_free_async(void* ptr, host_stream_t s) {
+   host_launch(s, [ptr]() { std::free(ptr); });
+   return hostSuccess;
+}
+
+inline host_error_t host_memcpy(void* dst, const void* src, size_t count, host_memcpy_kind = hostMemcpyHostToHost) {
+   std::memcpy(dst, src, count);
+   return hostSuccess;
+}
+
+inline host_error_t host_memcpy_async(void* dst, const void* src, size_t count, host_memcpy_kind,
+                                      host_stream_t s = nullptr) {
+   host_launch(s, [dst, src, count]() { std::memcpy(dst, src, count); });
+   return hostSuccess;
+}
+
+inline host_error_t host_memset(void* dst, int value, size_t count) {
+   std::memset(dst, value, count);
+   return hostSuccess;
+}
+
+inline host_error_t host_memset_async(void* dst, int value, size_t count, host_stream_t s = nullptr) {
+   host_launch(s, [dst, value, count]() { std::memset(dst, value, count); });
+   return hostSuccess;
+}
+
+// Host memory is always resident, prefetches and memory advice only keep their place in the stream
+inline host_error_t host_mem_prefetch_async(const void*, size_t, int, host_stream_t = nullptr) { return hostSuccess; }
+
+inline host_error_t host_mem_advise(const void*, size_t, int, int) { return hostSuccess; }
+
+inline host_error_t host_stream_attach_mem_async(host_stream_t, void*, size_t = 0, unsigned int = 0) {
+   return hostSuccess;
+}
+
+inline host_error_t host_get_device(int* device) {
+   *device = 0;
+   return hostSuccess;
+}
+
+inline host_error_t host_get_last_error() { return hostSuccess; }
+
+inline const char* host_get_error_string(host_error_t err) {
+   switch (err) {
+   case hostSuccess:
+      return "no error";
+   case hostErrorNotReady:
+      return "work has not completed yet";
+   default:
+      return "invalid argument";
+   }
+}
+
+} // namespace split
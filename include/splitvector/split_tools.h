@@ -14,6 +14,7 @@
  *    --split::tools::split_prefix_scan_raw
  *    --split::tools::split_prefix_scan
  *    --split::tools::split_prescan
+ *    --split::tools::host_compact (CPU only mode)
  *
  * This program is free software; you can redistribute it and/or
  * modify it under the terms of the GNU General Public License
@@ -30,6 +31,101 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  * */
 #pragma once
+#ifdef SPLIT_CPU_ONLY_MODE
+#include "split_pool.h"
+#include "splitvec.h"
+#include <vector>
+
+namespace split {
+namespace tools {
+
+/*
+ * Host versions of the stream compaction tools for CPU only mode.
+ * The input is cut into chunks of at least BLOCKSIZE elements; every chunk counts its
+ * matches, an exclusive scan over the chunk counts gives each chunk its output offset and
+ * the chunks then write their matches in place, so the output keeps the input order like
+ * the device versions do. Both passes run under the given execution policy.
+ */
+
+/**
+ * @brief Copies proj(input[i]) for every input[i] that satisfies rule to output.
+ *
+ * @return The number of elements written.
+ */
+template <typename T, typename U, typename Rule, typename Projection, size_t BLOCKSIZE = 1024>
+size_t host_compact(T* input, U* output, size_t size, Rule rule, Projection proj,
+                    split::execution_policy policy = split::execution_policy::adaptive) {
+   const size_t grain = std::max<size_t>(BLOCKSIZE, size / (8 * split::host_concurrency()));
+   const size_t nChunks = size / grain + (size % grain != 0);
+   std::vector<size_t> offsets(nChunks + 1, 0);
+   split::parallel_for(
+       size, grain,
+       [&](size_t begin, size_t end) {
+          for (size_t c = begin / grain; c * grain < end; c++) {
+             size_t count = 0;
+             for (size_t i = c * grain; i < std::min(end, (c + 1) * grain); i++) {
+                count += rule(input[i]) ? 1 : 0;
+             }
+             offsets[c + 1] = count;
+          }
+       },
+       policy);
+   for (size_t c = 0; c < nChunks; c++) {
+      offsets[c + 1] += offsets[c];
+   }
+   split::parallel_for(
+       size, grain,
+       [&](size_t begin, size_t end) {
+          for (size_t c = begin / grain; c * grain < end; c++) {
+             U* out = output + offsets[c];
+             for (size_t i = c * grain; i < std::min(end, (c + 1) * grain); i++) {
+                if (rule(input[i])) {
+                   *out++ = proj(input[i]);
+                }
+             }
+          }
+       },
+       policy);
+   return offsets[nChunks];
+}
+
+/**
+ * @brief Perform element compaction based on a rule.
+ *
+ * output is resized to the number of elements of input that satisfy rule.
+ */
+template <typename T, typename Rule, size_t BLOCKSIZE = 1024, typename ALLOCATOR_IN, typename ALLOCATOR_OUT>
+void copy_if(split::SplitVector<T, ALLOCATOR_IN>& input, split::SplitVector<T, ALLOCATOR_OUT>& output, Rule rule,
+             split::execution_policy policy = split::execution_policy::adaptive) {
+   output.resize(input.size());
+   const size_t len = host_compact<T, T, Rule, T (*)(const T&), BLOCKSIZE>(
+       input.data(), output.data(), input.size(), rule, [](const T& e) { return e; }, policy);
+   output.resize(len);
+}
+
+/**
+ * @brief Same as copy_if but only for Hashinator keys
+ */
+template <typename T, typename U, typename Rule, size_t BLOCKSIZE = 1024, typename ALLOCATOR_IN,
+          typename ALLOCATOR_OUT>
+void copy_keys_if(split::SplitVector<T, ALLOCATOR_IN>& input, split::SplitVector<U, ALLOCATOR_OUT>& output, Rule rule,
+                  split::execution_policy policy = split::execution_policy::adaptive) {
+   output.resize(input.size());
+   const size_t len = host_compact<T, U, Rule, U (*)(const T&), BLOCKSIZE>(
+       input.data(), output.data(), input.size(), rule, [](const T& e) { return e.first; }, policy);
+   output.resize(len);
+}
+
+template <typename T, typename Rule, size_t BLOCKSIZE = 1024>
+size_t copy_if(T* input, T* output, size_t size, Rule rule,
+               split::execution_policy policy = split::execution_policy::adaptive) {
+   return host_compact<T, T, Rule, T (*)(const T&), BLOCKSIZE>(
+       input, output, size, rule, [](const T& e) { return e; }, policy);
+}
+
+} // namespace tools
+} // namespace split
+#else
 #include "../common.h"
 #include "gpu_wrappers.h"
 #define NUM_BANKS 32 // TODO depends on device
@@ -1254,3 +1350,4 @@ size_t copy_if(T* input, T* output, size_t size, Rule rule, void* stack, size_t
 }
 } // namespace tools
 } // namespace split
+#endif
@@ -0,0 +1,290 @@
+/* File:    split_trace.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Opt in scoped range tracing of host runs, written out as Chrome trace JSON
+ *
+ * This file defines the following classes or functions:
+ *    --split::trace::ScopedRange
+ *    --split::trace::write_chrome_trace
+ *    --split::trace::dump
+ *    --split::trace::clear
+ *    --SPLIT_TRACE_SCOPE / SPLIT_TRACE_SCOPE_N
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#ifdef SPLIT_TRACE
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#endif
+
+namespace split {
+namespace trace {
+
+/*
+ * Ranges are only compiled in with -DSPLIT_TRACE (or -DHASHINATOR_TRACE, which implies it).
+ * Every host thread appends its finished ranges to a ring buffer of its own, without locks,
+ * overwriting its oldest ranges once the ring is full. The rings outlive their threads, so
+ * the ranges of pool workers or of threads that have already exited are still written out.
+ * Timestamps are steady_clock readings, so ranges recorded by the application itself with
+ * the same clock line up with these ones. write_chrome_trace() and clear() should not race
+ * with threads that are recording; call them between phases. Without the flag the macros
+ * expand to nothing and the trace is empty. Device code is never traced.
+ */
+
+#ifdef SPLIT_TRACE
+
+// One finished range. name must outlive the trace, which string literals do.
+struct Event {
+   const char* name;
+   uint64_t begin; // ns
+   uint64_t end;   // ns
+   uint64_t arg;
+   bool hasArg;
+};
+
+// Ranges of one thread. Only their own thread appends to them.
+class Ring {
+public:
+   Ring(uint32_t tid, size_t capacity) : tid(tid), events(capacity) {}
+
+   void push(const Event& e) noexcept {
+      const uint64_t n = head.load(std::memory_order_relaxed);
+      events[n % events.size()] = e;
+      head.store(n + 1, std::memory_order_release);
+   }
+
+   // Calls f on the ranges still held, oldest first
+   template <typename F>
+   void for_each(F&& f) const {
+      const uint64_t n = head.load(std::memory_order_acquire);
+      const uint64_t kept = std::min<uint64_t>(n, events.size());
+      for (uint64_t i = n - kept; i < n; i++) {
+         f(events[i % events.size()]);
+      }
+   }
+
+   uint64_t dropped() const noexcept {
+      const uint64_t n = head.load(std::memory_order_acquire);
+      return n > events.size() ? n - events.size() : 0;
+   }
+
+   void clear() noexcept { head.store(0, std::memory_order_relaxed); }
+
+   const uint32_t tid;
+   std::string threadName;
+   bool retired = false; // Its thread has exited
+
+private:
+   std::vector<Event> events;
+   std::atomic<uint64_t> head{0};
+};
+
+class Registry {
+public:
+   static Registry& get() {
+      static Registry registry;
+      return registry;
+   }
+
+   std::shared_ptr<Ring> attach() {
+      std::lock_guard<std::mutex> lock(mutex);
+      rings.push_back(std::make_shared<Ring>(nextTid++, capacity));
+      return rings.back();
+   }
+
+   void retire(Ring* ring) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ring->retired = true;
+   }
+
+   void set_name(Ring* ring, const std::string& name) {
+      std::lock_guard<std::mutex> lock(mutex);
+      ring->threadName = name;
+   }
+
+   // Only applies to threads that record their first range afterwards
+   void set_capacity(size_t events) {
+      std::lock_guard<std::mutex> lock(mutex);
+      capacity = std::max<size_t>(events, 1);
+   }
+
+   void write(std::ostream& out) {
+      std::lock_guard<std::mutex> lock(mutex);
+      const auto flags = out.flags();
+      const auto precision = out.precision();
+      out << std::fixed << std::setprecision(3);
+      out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      bool first = true;
+      uint64_t dropped = 0;
+      for (const auto& ring : rings) {
+         if (!ring->threadName.empty()) {
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->tid
+                << ",\"args\":{\"name\":\"" << escape(ring->threadName.c_str()) << "\"}}";
+            first = false;
+         }
+         ring->for_each([&](const Event& e) {
+            out << (first ? "" : ",") << "\n{\"name\":\"" << escape(e.name)
+                << "\",\"cat\":\"split\",\"ph\":\"X\",\"ts\":" << e.begin / 1000.0
+                << ",\"dur\":" << (e.end - e.begin) / 1000.0 << ",\"pid\":1,\"tid\":" << ring->tid;
+            if (e.hasArg) {
+               out << ",\"args\":{\"n\":" << e.arg << "}";
+            }
+            out << "}";
+            first = false;
+         });
+         dropped += ring->dropped();
+      }
+      out << "\n],\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+      out.flags(flags);
+      out.precision(precision);
+   }
+
+   // Forgets every range, and the rings of the threads that have exited
+   void clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::vector<std::shared_ptr<Ring>> live;
+      for (auto& ring : rings) {
+         if (!ring->retired) {
+            ring->clear();
+            live.push_back(std::move(ring));
+         }
+      }
+      rings = std::move(live);
+   }
+
+   std::atomic<bool> enabled{true};
+
+private:
+   static std::string escape(const char* s) {
+      std::string out;
+      for (; *s; s++) {
+         if (*s == '"' || *s == '\\') {
+            out += '\\';
+         }
+         out += (static_cast<unsigned char>(*s) < 0x20) ? ' ' : *s;
+      }
+      return out;
+   }
+
+   std::mutex mutex;
+   std::vector<std::shared_ptr<Ring>> rings;
+   uint32_t nextTid = 1;
+   size_t capacity = size_t(1) << 14;
+};
+
+// Keeps the ring of a thread alive in the registry after the thread has exited
+struct Handle {
+   std::shared_ptr<Ring> ring = Registry::get().attach();
+   ~Handle() { Registry::get().retire(ring.get()); }
+};
+
+inline Ring& local() {
+   thread_local Handle handle;
+   return *handle.ring;
+}
+
+inline uint64_t now() noexcept {
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+       .count();
+}
+
+// Records the time spent in its scope as a range called name, with an optional size argument n
+class ScopedRange {
+public:
+   explicit ScopedRange(const char* name) : name(name), hasArg(false) { start(); }
+   ScopedRange(const char* name, uint64_t n) : name(name), arg(n), hasArg(true) { start(); }
+   ~ScopedRange() {
+      if (begin != 0) {
+         local().push(Event{name, begin, now(), arg, hasArg});
+      }
+   }
+   ScopedRange(const ScopedRange&) = delete;
+   ScopedRange& operator=(const ScopedRange&) = delete;
+
+private:
+   void start() noexcept {
+      if (Registry::get().enabled.load(std::memory_order_relaxed)) {
+         begin = now();
+      }
+   }
+
+   const char* name;
+   uint64_t begin = 0;
+   uint64_t arg = 0;
+   bool hasArg;
+};
+
+// Ranges are recorded from the start. disable() stops recording new ones.
+inline void enable() noexcept { Registry::get().enabled.store(true, std::memory_order_relaxed); }
+
+inline void disable() noexcept { Registry::get().enabled.store(false, std::memory_order_relaxed); }
+
+// Number of ranges each thread keeps; only threads that have not traced anything yet pick it up
+inline void set_buffer_size(size_t events) { Registry::get().set_capacity(events); }
+
+// Names the calling thread in the trace
+inline void set_thread_name(const std::string& name) { Registry::get().set_name(&local(), name); }
+
+// Writes every range held as a Chrome trace, which chrome://tracing and Perfetto open
+inline void write_chrome_trace(std::ostream& out) { Registry::get().write(out); }
+
+inline void clear() { Registry::get().clear(); }
+
+#else
+inline void enable() noexcept {}
+
+inline void disable() noexcept {}
+
+inline void set_buffer_size(size_t) {}
+
+inline void set_thread_name(const std::string&) {}
+
+inline void write_chrome_trace(std::ostream& out) {
+   out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[],\"otherData\":{\"dropped_events\":0}}\n";
+}
+
+inline void clear() {}
+#endif
+
+// Writes the trace to a file. Returns false if the file could not be written.
+inline bool dump(const std::string& path) {
+   std::ofstream out(path);
+   write_chrome_trace(out);
+   return static_cast<bool>(out);
+}
+
+} // namespace trace
+} // namespace split
+
+#if defined(SPLIT_TRACE) && !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+#define SPLIT_TRACE_CONCAT_(a, b) a##b
+#define SPLIT_TRACE_CONCAT(a, b) SPLIT_TRACE_CONCAT_(a, b)
+#define SPLIT_TRACE_SCOPE(name) split::trace::ScopedRange SPLIT_TRACE_CONCAT(splitTraceRange, __LINE__)(name)
+#define SPLIT_TRACE_SCOPE_N(name, n)                                                                                   \
+   split::trace::ScopedRange SPLIT_TRACE_CONCAT(splitTraceRange, __LINE__)(name, static_cast<uint64_t>(n))
+#else
+#define SPLIT_TRACE_SCOPE(name) ((void)0)
+#define SPLIT_TRACE_SCOPE_N(name, n) ((void)0)
+#endif
@@ -0,0 +1,439 @@
+/* File:    split_tracking_allocator.h
+ * Authors: Kostis Papadakis (2023)
+ * Description: Allocator adapter that keeps statistics of the allocations it forwards
+ *
+ * This file defines the following classes or functions:
+ *    --split::tracking_allocator
+ *    --split::tracking::AllocationStats
+ *    --split::tracking::snapshot
+ *    --split::tracking::reset
+ *    --split::tracking::sample_call_sites
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ * */
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#if defined(__has_include)
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#include <cstdlib>
+#define SPLIT_TRACKING_BACKTRACE
+#endif
+#endif
+
+#if !defined(SPLIT_CPU_ONLY_MODE) && (defined(__NVCC__) || defined(__HIP__))
+#define SPLIT_TRACKING_HOSTDEVICE __host__ __device__
+#else
+#define SPLIT_TRACKING_HOSTDEVICE
+#endif
+
+namespace split {
+namespace tracking {
+
+/*
+ * Every tracking_allocator, whatever it wraps and whatever it allocates, reports to the same
+ * process wide tracker. Counters are relaxed atomics; live bytes are exact because the size of
+ * every block is kept until it is freed, in a table split over a few locks. That makes the
+ * adapter a diagnostic tool rather than something to ship in a release build. Construction
+ * time is the time from an allocation to the construction of its last element, which is only
+ * seen when the elements are constructed in order right after the allocation on the same
+ * thread, as SplitVector does. Device code is never tracked.
+ */
+constexpr size_t num_size_classes = 64;
+
+// Allocations whose sampled call stacks were the same
+struct CallSite {
+   std::vector<std::string> frames; // Innermost first; the top ones are the tracker's own
+   uint64_t allocations = 0;
+   uint64_t bytes = 0;
+};
+
+struct AllocationStats {
+   uint64_t allocations = 0;
+   uint64_t deallocations = 0;
+   uint64_t allocatedBytes = 0;
+   uint64_t freedBytes = 0;
+   uint64_t liveBytes = 0;
+   uint64_t peakBytes = 0; // High water mark of liveBytes
+   uint64_t allocationNs = 0;
+   uint64_t deallocationNs = 0;
+   uint64_t constructs = 0;
+   uint64_t destroys = 0;
+   uint64_t constructionNs = 0;
+   std::array<uint64_t, num_size_classes> sizeClasses{}; // sizeClasses[i] counts sizes in [2^i, 2^(i+1)), 0 in [0]
+   size_t sampleEvery = 0;                               // Call sites hold one allocation in sampleEvery
+   std::vector<CallSite> callSites;                      // Most bytes first
+
+   std::string to_string(size_t maxCallSites = 8) const {
+      std::ostringstream text;
+      text << allocations << " allocations, " << allocatedBytes << " B in " << allocationNs * 1e-6 << " ms, "
+           << deallocations << " deallocations, " << freedBytes << " B in " << deallocationNs * 1e-6 << " ms\n";
+      text << "live " << liveBytes << " B, peak " << peakBytes << " B\n";
+      text << constructs << " constructions, " << constructionNs * 1e-6 << " ms after allocations, " << destroys
+           << " destructions\n";
+      for (size_t i = 0; i < num_size_classes; i++) {
+         if (sizeClasses[i] != 0) {
+            text << "  [" << (i == 0 ? 0 : uint64_t(1) << i) << ", " << (uint64_t(1) << (i + 1))
+                 << ") B: " << sizeClasses[i] << "\n";
+         }
+      }
+      for (size_t i = 0; i < std::min(maxCallSites, callSites.size()); i++) {
+         text << "call site " << i << ": " << callSites[i].allocations << " sampled allocations, "
+              << callSites[i].bytes << " B\n";
+         for (const auto& frame : callSites[i].frames) {
+            text << "    " << frame << "\n";
+         }
+      }
+      return text.str();
+   }
+};
+
+inline size_t size_class(uint64_t bytes) noexcept {
+   size_t c = 0;
+   while (bytes > 1) {
+      bytes >>= 1;
+      c++;
+   }
+   return c;
+}
+
+inline uint64_t now() noexcept {
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+       .count();
+}
+
+class Tracker {
+public:
+   static Tracker& get() {
+      static Tracker tracker;
+      return tracker;
+   }
+
+   void allocated(const void* p, uint64_t bytes, uint64_t ns) {
+      allocations.fetch_add(1, std::memory_order_relaxed);
+      allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+      allocationNs.fetch_add(ns, std::memory_order_relaxed);
+      sizeClasses[size_class(bytes)].fetch_add(1, std::memory_order_relaxed);
+      {
+         Shard& s = shard(p);
+         std::lock_guard<std::mutex> lock(s.mutex);
+         s.sizes[p] = bytes;
+      }
+      const uint64_t live = liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+      uint64_t peak = peakBytes.load(std::memory_order_relaxed);
+      while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+      }
+      const size_t every = sampleEvery.load(std::memory_order_relaxed);
+      thread_local uint64_t tick = 0;
+      if (every != 0 && ++tick % every == 0) {
+         sample(bytes);
+      }
+   }
+
+   // Called before the block is freed, so that its address cannot have been handed out again
+   uint64_t deallocating(const void* p) {
+      uint64_t bytes = 0;
+      Shard& s = shard(p);
+      std::lock_guard<std::mutex> lock(s.mutex);
+      auto it = s.sizes.find(p);
+      if (it != s.sizes.end()) {
+         bytes = it->second;
+         s.sizes.erase(it);
+      }
+      return bytes;
+   }
+
+   void deallocated(uint64_t bytes, uint64_t ns) {
+      deallocations.fetch_add(1, std::memory_order_relaxed);
+      freedBytes.fetch_add(bytes, std::memory_order_relaxed);
+      deallocationNs.fetch_add(ns, std::memory_order_relaxed);
+      liveBytes.fetch_sub(bytes, std::memory_order_relaxed);
+   }
+
+   // The block whose last element, once constructed, ends the construction timing of this thread
+   void expect_construction(const void* last, uint64_t start) noexcept {
+      Pending& pending = local();
+      pending.last = last;
+      pending.start = start;
+   }
+
+   void constructed(const void* p) noexcept {
+      constructs.fetch_add(1, std::memory_order_relaxed);
+      Pending& pending = local();
+      if (p == pending.last) {
+         constructionNs.fetch_add(now() - pending.start, std::memory_order_relaxed);
+         pending.last = nullptr;
+      }
+   }
+
+   void destroyed() noexcept { destroys.fetch_add(1, std::memory_order_relaxed); }
+
+   void set_sampling(size_t every, size_t depth) {
+      stackDepth.store(std::min<size_t>(std::max<size_t>(depth, 1), max_stack_depth), std::memory_order_relaxed);
+      sampleEvery.store(every, std::memory_order_relaxed);
+   }
+
+   AllocationStats snapshot() {
+      AllocationStats stats;
+      stats.allocations = allocations.load(std::memory_order_relaxed);
+      stats.deallocations = deallocations.load(std::memory_order_relaxed);
+      stats.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed);
+      stats.freedBytes = freedBytes.load(std::memory_order_relaxed);
+      stats.liveBytes = liveBytes.load(std::memory_order_relaxed);
+      stats.peakBytes = peakBytes.load(std::memory_order_relaxed);
+      stats.allocationNs = allocationNs.load(std::memory_order_relaxed);
+      stats.deallocationNs = deallocationNs.load(std::memory_order_relaxed);
+      stats.constructs = constructs.load(std::memory_order_relaxed);
+      stats.destroys = destroys.load(std::memory_order_relaxed);
+      stats.constructionNs = constructionNs.load(std::memory_order_relaxed);
+      for (size_t i = 0; i < num_size_classes; i++) {
+         stats.sizeClasses[i] = sizeClasses[i].load(std::memory_order_relaxed);
+      }
+      stats.sampleEvery = sampleEvery.load(std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(sitesMutex);
+      for (const auto& [stack, site] : sites) {
+         CallSite c = site;
+         c.frames = symbolize(stack);
+         stats.callSites.push_back(std::move(c));
+      }
+      std::sort(stats.callSites.begin(), stats.callSites.end(),
+                [](const CallSite& a, const CallSite& b) { return a.bytes > b.bytes; });
+      return stats;
+   }
+
+   // Zeroes the counters and the call sites. Blocks still live stay live and the peak restarts from them.
+   void reset() {
+      for (auto* c : {&allocations, &deallocations, &allocatedBytes, &freedBytes, &allocationNs, &deallocationNs,
+                      &constructs, &destroys, &constructionNs}) {
+         c->store(0, std::memory_order_relaxed);
+      }
+      for (auto& c : sizeClasses) {
+         c.store(0, std::memory_order_relaxed);
+      }
+      peakBytes.store(liveBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      std::lock_guard<std::mutex> lock(sitesMutex);
+      sites.clear();
+   }
+
+private:
+   static constexpr size_t num_shards = 16;
+   static constexpr size_t max_stack_depth = 32;
+
+   struct Shard {
+      std::mutex mutex;
+      std::unordered_map<const void*, uint64_t> sizes;
+   };
+
+   struct Pending {
+      const void* last = nullptr;
+      uint64_t start = 0;
+   };
+
+   static Pending& local() noexcept {
+      thread_local Pending pending;
+      return pending;
+   }
+
+   Shard& shard(const void* p) noexcept {
+      const uint64_t h = (reinterpret_cast<uintptr_t>(p) >> 4) * 0x9E3779B97F4A7C15ull;
+      return shards[h >> 60];
+   }
+
+   void sample(uint64_t bytes) {
+#ifdef SPLIT_TRACKING_BACKTRACE
+      void* frames[max_stack_depth];
+      const int n = backtrace(frames, static_cast<int>(stackDepth.load(std::memory_order_relaxed)));
+      std::vector<void*> stack(frames, frames + std::max(n, 0));
+      std::lock_guard<std::mutex> lock(sitesMutex);
+      CallSite& site = sites[stack];
+      site.allocations++;
+      site.bytes += bytes;
+#else
+      (void)bytes;
+#endif
+   }
+
+   static std::vector<std::string> symbolize(const std::vector<void*>& stack) {
+      std::vector<std::string> frames;
+#ifdef SPLIT_TRACKING_BACKTRACE
+      char** names = backtrace_symbols(stack.data(), static_cast<int>(stack.size()));
+      for (size_t i = 0; i < stack.size(); i++) {
+         frames.emplace_back(names ? names[i] : "?");
+      }
+      free(names);
+#else
+      (void)stack;
+#endif
+      return frames;
+   }
+
+   std::atomic<uint64_t> allocations{0};
+   std::atomic<uint64_t> deallocations{0};
+   std::atomic<uint64_t> allocatedBytes{0};
+   std::atomic<uint64_t> freedBytes{0};
+   std::atomic<uint64_t> liveBytes{0};
+   std::atomic<uint64_t> peakBytes{0};
+   std::atomic<uint64_t> allocationNs{0};
+   std::atomic<uint64_t> deallocationNs{0};
+   std::atomic<uint64_t> constructs{0};
+   std::atomic<uint64_t> destroys{0};
+   std::atomic<uint64_t> constructionNs{0};
+   std::array<std::atomic<uint64_t>, num_size_classes> sizeClasses{};
+   std::array<Shard, num_shards> shards;
+   std::atomic<size_t> sampleEvery{0};
+   std::mutex sitesMutex;
+   std::atomic<size_t> stackDepth{8};
+   std::map<std::vector<void*>, CallSite> sites;
+};
+
+// Sums over every tracking_allocator since the start or the last reset()
+inline AllocationStats snapshot() { return Tracker::get().snapshot(); }
+
+inline void reset() { Tracker::get().reset(); }
+
+/*
+ * Records the call stack, depth frames deep, of one allocation in every. 0 turns sampling off,
+ * which is the default. Stacks are symbolized by snapshot(); build with -rdynamic to get names
+ * for functions outside shared libraries. Without <execinfo.h> no call sites are recorded.
+ */
+inline void sample_call_sites(size_t every, size_t depth = 8) { Tracker::get().set_sampling(every, depth); }
+
+} // namespace tracking
+
+/**
+ * @brief Allocator adapter that reports every allocation of Allocator to split::tracking.
+ *
+ * Allocator is any split allocator, or another allocator with the same interface. The
+ * adapter counts calls, bytes, live bytes and their high water mark, sizes and the time spent
+ * in the wrapped allocator; split::tracking::snapshot() reads them.
+ *
+ * @tparam Allocator The allocator that does the allocations.
+ */
+template <class Allocator>
+class tracking_allocator {
+public:
+   typedef Allocator wrapped_type;
+   typedef typename Allocator::value_type value_type;
+   typedef value_type* pointer;
+   typedef const value_type* const_pointer;
+   typedef value_type& reference;
+   typedef const value_type& const_reference;
+   typedef ptrdiff_t difference_type;
+   typedef size_t size_type;
+   typedef std::true_type is_always_equal;
+   template <class U>
+   struct rebind {
+      typedef tracking_allocator<typename Allocator::template rebind<U>::other> other;
+   };
+
+   /**
+    * @brief Default constructor.
+    */
+   tracking_allocator() throw() {}
+
+   /**
+    * @brief Copy constructor with different type.
+    */
+   template <class U>
+   tracking_allocator(tracking_allocator<U> const&) throw() {}
+   pointer address(reference x) const { return &x; }
+   const_pointer address(const_reference x) const { return &x; }
+
+   pointer allocate(size_type n, const void* hint = 0) {
+      const uint64_t start = tracking::now();
+      pointer ret = base.allocate(n, hint);
+      const uint64_t end = tracking::now();
+      tracking::Tracker::get().allocated(ret, n * sizeof(value_type), end - start);
+      if (n != 0) {
+         tracking::Tracker::get().expect_construction(ret + (n - 1), end);
+      }
+      return ret;
+   }
+
+   static void* allocate_raw(size_type n, const void* hint = 0) {
+      const uint64_t start = tracking::now();
+      void* ret = Allocator::allocate_raw(n, hint);
+      tracking::Tracker::get().allocated(ret, n, tracking::now() - start);
+      return ret;
+   }
+
+   void deallocate(pointer p, size_type n) {
+      if (p == nullptr) {
+         base.deallocate(p, n);
+         return;
+      }
+      const uint64_t bytes = tracking::Tracker::get().deallocating(p);
+      const uint64_t start = tracking::now();
+      base.deallocate(p, n);
+      tracking::Tracker::get().deallocated(bytes, tracking::now() - start);
+   }
+
+   static void deallocate(void* p, size_type n) {
+      if (p == nullptr) {
+         Allocator::deallocate(p, n);
+         return;
+      }
+      const uint64_t bytes = tracking::Tracker::get().deallocating(p);
+      const uint64_t start = tracking::now();
+      Allocator::deallocate(p, n);
+      tracking::Tracker::get().deallocated(bytes, tracking::now() - start);
+   }
+
+   size_type max_size() const throw() { return base.max_size(); }
+
+   // Placement new like the split allocators, since their construct() is not callable from device code on the host one
+   template <typename U, typename... Args>
+   SPLIT_TRACKING_HOSTDEVICE void construct(U* p, Args&&... args) {
+      ::new (p) U(std::forward<Args>(args)...);
+#if !defined(__CUDA_ARCH__) && !defined(__HIP_DEVICE_COMPILE__)
+      tracking::Tracker::get().constructed(p);
+#endif
+   }
+
+   void destroy(pointer p) {
+      base.destroy(p);
+      tracking::Tracker::get().destroyed();
+   }
+
+private:
+   Allocator base;
+};
+
+// Stateless like the allocators they wrap, so any two can free what the other allocated
+template <class A, class B>
+bool operator==(const tracking_allocator<A>&, const tracking_allocator<B>&) noexcept {
+   return true;
+}
+
+template <class A, class B>
+bool operator!=(const tracking_allocator<A>&, const tracking_allocator<B>&) noexcept {
+   return false;
+}
+
+} // namespace split
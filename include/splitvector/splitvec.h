@@ -23,6 +23,8 @@
  * */
 #pragma once
 #include "split_allocators.h"
+#include "split_memory.h"
+#include "split_tracking_allocator.h"
 #include <algorithm>
 #include <cassert>
 #include <iostream>
@@ -40,15 +42,25 @@
 #define HOSTONLY __host__
 #define DEVICEONLY __device__
 #define HOSTDEVICE __host__ __device__
+#ifdef SPLIT_TRACK_ALLOCATIONS
+template <typename T>
+using DefaultAllocator = split::tracking_allocator<split::split_unified_allocator<T>>;
+#else
 template <typename T>
 using DefaultAllocator = split::split_unified_allocator<T>;
+#endif
 #else
 #define HOSTONLY
 #define DEVICEONLY
 #define HOSTDEVICE
+#ifdef SPLIT_TRACK_ALLOCATIONS
+template <typename T>
+using DefaultAllocator = split::tracking_allocator<split::split_host_allocator<T>>;
+#else
 template <typename T>
 using DefaultAllocator = split::split_host_allocator<T>;
 #endif
+#endif
 
 namespace split {
 
@@ -98,6 +110,14 @@ private:
     */
    inline void _check_ptr(void* ptr) { assert(ptr); }
 
+   /**
+    * @brief Adds the vector to the registry of live containers, when it is compiled in.
+    */
+   HOSTONLY void _track() {
+      split::memory::track(this, split::memory::kind::vector,
+                           [](const void* v) { return static_cast<const SplitVector*>(v)->memory_usage(); });
+   }
+
    /**
     * @brief Internal range check used in the .at() method.
     *
@@ -225,6 +245,7 @@ public:
     */
    HOSTONLY explicit SplitVector() : _location(Residency::host), d_vec(nullptr) {
       this->_allocate(0); // seems counter-intuitive based on stl but it is not!
+      _track();
    }
 
    /**
@@ -232,7 +253,10 @@ public:
     *
     * @param size The size of the SplitVector to be created.
     */
-   HOSTONLY explicit SplitVector(size_t size) : _location(Residency::host), d_vec(nullptr) { this->_allocate(size); }
+   HOSTONLY explicit SplitVector(size_t size) : _location(Residency::host), d_vec(nullptr) {
+      this->_allocate(size);
+      _track();
+   }
 
    /**
     * @brief Constructor to create a SplitVector of a specified size with initial values.
@@ -242,6 +266,7 @@ public:
     */
    HOSTONLY explicit SplitVector(size_t size, const T& val) : _location(Residency::host), d_vec(nullptr) {
       this->_allocate(size);
+      _track();
       for (size_t i = 0; i < size; i++) {
          _data[i] = val;
       }
@@ -256,6 +281,7 @@ public:
    HOSTONLY explicit SplitVector(const SplitVector<T, Allocator>& other) {
       const size_t size_to_allocate = other.size();
       this->_allocate(size_to_allocate);
+      _track();
       for (size_t i = 0; i < size_to_allocate; i++) {
          _data[i] = other._data[i];
       }
@@ -270,6 +296,7 @@ public:
          }
       };
       this->_allocate(size_to_allocate);
+      _track();
       if constexpr (std::is_trivially_copyable<T>::value) {
          if (other._location == Residency::device) {
             _location = Residency::device;
@@ -298,6 +325,7 @@ public:
       other._capacity = nullptr;
       _location = other._location;
       d_vec = nullptr;
+      _track();
    }
 
    /**
@@ -307,6 +335,7 @@ public:
     */
    HOSTONLY explicit SplitVector(std::initializer_list<T> init_list) : _location(Residency::host), d_vec(nullptr) {
       this->_allocate(init_list.size());
+      _track();
       for (size_t i = 0; i < size(); i++) {
          _data[i] = init_list.begin()[i];
       }
@@ -319,6 +348,7 @@ public:
     */
    HOSTONLY explicit SplitVector(const std::vector<T>& other) : _location(Residency::host), d_vec(nullptr) {
       this->_allocate(other.size());
+      _track();
       for (size_t i = 0; i < size(); i++) {
          _data[i] = other[i];
       }
@@ -328,6 +358,7 @@ public:
     * @brief Destructor for the SplitVector. Deallocates memory.
     */
    HOSTONLY ~SplitVector() {
+      split::memory::untrack(this, split::memory::kind::vector);
       _deallocate();
 #ifndef SPLIT_CPU_ONLY_MODE
       if (d_vec) {
@@ -354,6 +385,23 @@ public:
       }
       return *this;
    }
+
+   /** Copy assign but using a provided stream. other must stay alive until the stream gets there. */
+   HOSTONLY void overwrite(const SplitVector<T, Allocator>& other, split_gpuStream_t stream = 0) {
+      if (this == &other) {
+         return;
+      }
+      // Match other's size and minimum required capacity prior to copying
+      resize(other.size(), true, stream);
+      T* dst = _data;
+      const T* src = other._data;
+      const size_t len = size();
+      split::host_launch(stream, [dst, src, len]() {
+         for (size_t i = 0; i < len; i++) {
+            dst[i] = src[i];
+         }
+      });
+   }
 #else
 
    HOSTONLY SplitVector<T, Allocator>& operator=(const SplitVector<T, Allocator>& other) {
@@ -430,7 +478,7 @@ public:
          return *this;
       }
 
-      _deallocate_and_destroy(capacity(), _data);
+      _deallocate();
 #ifndef SPLIT_CPU_ONLY_MODE
       if (d_vec) {
          SPLIT_CHECK_ERR(split_gpuFree(d_vec));
@@ -514,6 +562,7 @@ public:
     */
    HOSTONLY
    const SplitVector<T, Allocator>* device_pointer() const noexcept { return d_vec; }
+#endif
 
    /**
     * @brief Manually prefetches data to the GPU.
@@ -606,7 +655,6 @@ public:
       SPLIT_CHECK_ERR(split_gpuMemAdvise(_capacity, sizeof(size_t), advice, device));
       SPLIT_CHECK_ERR(split_gpuMemPrefetchAsync(_capacity, sizeof(size_t), device, stream));
    }
-#endif
 
    /**
     * @brief Swaps the content of two SplitVectors.
@@ -688,8 +736,10 @@ public:
     * @brief Reallocates data to a bigger chunk of memory.
     *
     * @param requested_space The size of the requested space.
+    * @param stream Work already queued on stream is finished before the data moves.
     */
-   void reallocate(size_t requested_space) {
+   void reallocate(size_t requested_space, split_gpuStream_t stream = 0) {
+      SPLIT_CHECK_ERR(split_gpuStreamSynchronize(stream));
       if (requested_space == 0) {
          if (_data != nullptr) {
             _deallocate_and_destroy(capacity(), _data);
@@ -732,7 +782,7 @@ public:
     * Memory location will change so any old pointers/iterators
     * will be invalidated after a call.
     */
-   void reserve(size_t requested_space, bool eco = false) {
+   void reserve(size_t requested_space, bool eco = false, split_gpuStream_t stream = 0) {
       size_t current_space = *_capacity;
       // Vector was default initialized
       if (_data == nullptr) {
@@ -753,7 +803,7 @@ public:
       if (!eco) {
          requested_space *= _alloc_multiplier;
       }
-      reallocate(requested_space);
+      reallocate(requested_space, stream);
       return;
    }
 
@@ -768,13 +818,13 @@ public:
     * Memory location will change so any old pointers/iterators
     * will be invalid from now on.
     */
-   void resize(size_t newSize, bool eco = false) {
+   void resize(size_t newSize, bool eco = false, split_gpuStream_t stream = 0) {
       // Let's reserve some space and change our size
       if (newSize <= size()) {
          *_size = newSize;
          return;
       }
-      reserve(newSize, eco);
+      reserve(newSize, eco, stream);
       *_size = newSize;
       // TODO: should it set entries to zero?
    }
@@ -782,12 +832,12 @@ public:
    /**
     * @brief Increase the capacity of the SplitVector by 1.
     */
-   void grow() { reserve(capacity() + 1); }
+   void grow(split_gpuStream_t stream = 0) { reserve(capacity() + 1, false, stream); }
 
    /**
     * @brief Reduce the capacity of the SplitVector to match its size.
     */
-   void shrink_to_fit() {
+   void shrink_to_fit(split_gpuStream_t stream = 0) {
       size_t curr_cap = *_capacity;
       size_t curr_size = *_size;
 
@@ -795,7 +845,7 @@ public:
          return;
       }
 
-      reallocate(curr_size);
+      reallocate(curr_size, stream);
       return;
    }
 
@@ -998,6 +1048,24 @@ public:
    HOSTDEVICE
    inline size_t capacity() const noexcept { return *_capacity; }
 
+   /**
+    * @brief Bytes allocated by the SplitVector.
+    *
+    * The elements make up the payload and the unused capacity the slack. The size and
+    * capacity words, and the device copy made by upload(), are overhead. A vector that has
+    * been moved from holds nothing.
+    */
+   HOSTONLY MemoryUsage memory_usage() const noexcept {
+      MemoryUsage usage;
+      if (_size == nullptr || _capacity == nullptr) {
+         return usage;
+      }
+      usage.payload = size() * sizeof(T);
+      usage.slack = (capacity() - size()) * sizeof(T);
+      usage.overhead = 2 * sizeof(size_t) + (d_vec != nullptr ? sizeof(SplitVector) : 0);
+      return usage;
+   }
+
    /**
     * @brief Get a reference to the last element of the SplitVector.
     *
@@ -1488,10 +1556,9 @@ public:
    iterator erase(iterator it) noexcept {
       const int64_t index = it.data() - begin().data();
       if constexpr (!std::is_trivial<T>::value) {
-         _data[index].~T();
+         // Every slot up to capacity holds a live object, so shift by assignment and leave the last one moved from
          for (size_t i = index; i < size() - 1; i++) {
-            new (&_data[i]) T(_data[i + 1]);
-            _data[i + 1].~T();
+            _data[i] = std::move(_data[i + 1]);
          }
       } else {
          for (auto i = static_cast<size_t>(index); i < size() - 1; i++) {
@@ -1518,12 +1585,8 @@ public:
 
       const size_t sz = size();
       if constexpr (!std::is_trivial<T>::value) {
-         for (int64_t i = start; i < end; i++) {
-            _data[i].~T();
-         }
          for (size_t i = start; i < sz - range; ++i) {
-            new (&_data[i]) T(_data[i + range]);
-            _data[i + range].~T();
+            _data[i] = std::move(_data[i + range]);
          }
       } else {
          for (size_t i = start; i < sz - range; ++i) {
@@ -1552,9 +1615,10 @@ public:
       if (index < 0 || index > static_cast<int64_t>(size())) {
          throw new std::out_of_range("Out of range");
       }
-      resize(size() + 1);
+      const size_t oldSize = size();
+      resize(oldSize + 1);
       iterator it = &_data[index];
-      std::move(it.data(), end().data(), it.data() + 1);
+      std::move_backward(it.data(), _data + oldSize, _data + oldSize + 1);
       _allocator.destroy(it.data());
       _allocator.construct(it.data(), args...);
       return it;
@@ -0,0 +1,530 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+
+/*
+ * Host benchmark suite. Unlike the rest of this directory it is a .cpp file so it builds
+ * without a CUDA or HIP toolchain.
+ *    cpu_suite [--quick] [--repeats R] [--sizes 16,20] [--load-factors 0.5,0.9]
+ *              [--format csv|json] [--output file]
+ * Every combination of workload, key and value size (values are exchanged atomically by the
+ * hashers, so they are integers of up to 8 bytes), table size and load factor is run on
+ * Hashinator with serial and with threaded batches, on std::unordered_map and on a minimal
+ * linear probing map. A table of 2^size buckets is filled to the load factor, then the keys
+ * are looked up, missing keys are looked up, the churn workload erases and reinserts a tenth
+ * of its keys with a cleanup of the tombstones in between, and every key is erased. Each
+ * operation reports the best of R repeats. Results go to stdout, or to the output file, as
+ * CSV or as JSON; the run fails if any map returns a wrong value. The defaults sweep 2^14,
+ * 2^18 and 2^22 buckets at load factors 0.5, 0.75 and 0.9 and take a while; --quick runs
+ * one small table once, as a smoke test.
+ */
+using namespace Hashinator;
+
+template <typename V>
+V make_value(uint64_t key) {
+   return static_cast<V>(key * 3 + 1);
+}
+
+// Bijective mixes, so distinct indices give distinct keys
+inline uint32_t mix(uint32_t x) {
+   x ^= x >> 16;
+   x *= 0x85ebca6bu;
+   x ^= x >> 13;
+   x *= 0xc2b2ae35u;
+   x ^= x >> 16;
+   return x;
+}
+
+inline uint64_t mix(uint64_t x) {
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdull;
+   x ^= x >> 33;
+   x *= 0xc4ceb9fe1a85ec53ull;
+   x ^= x >> 33;
+   return x;
+}
+
+enum class workload { uniform, zipf, sequential, blocks, churn };
+
+const char* name(workload w) {
+   static const char* names[] = {"uniform", "zipf", "sequential", "blocks", "churn"};
+   return names[static_cast<int>(w)];
+}
+
+// The keys a run inserts, the order it looks them up in and keys that are never inserted
+template <typename K>
+struct Keys {
+   std::vector<K> inserted;
+   std::vector<K> lookups;
+   std::vector<K> missing;
+};
+
+// The two largest keys are the empty bucket and tombstone markers of the maps
+template <typename K>
+bool reserved(K key) {
+   return key >= std::numeric_limits<K>::max() - 1;
+}
+
+template <typename K>
+std::vector<K> uniform_keys(size_t n, size_t first) {
+   std::vector<K> keys;
+   keys.reserve(n);
+   for (K i = static_cast<K>(first); keys.size() < n; i++) {
+      const K key = mix(i);
+      if (!reserved(key)) {
+         keys.push_back(key);
+      }
+   }
+   return keys;
+}
+
+/*
+ * Global ids of the velocity blocks of a Vlasiator style mesh that fall in a sphere, in id
+ * order: runs of consecutive ids along x, separated by strides of a row along y and of a
+ * plane along z.
+ */
+template <typename K>
+std::vector<K> block_keys(size_t n) {
+   const double radius = std::cbrt(3.0 * n / (4.0 * M_PI)) + 1.0;
+   const size_t side = static_cast<size_t>(2.0 * radius) + 2;
+   const double center = side / 2.0;
+   std::vector<K> keys;
+   keys.reserve(n);
+   for (size_t z = 0; z < side && keys.size() < n; z++) {
+      for (size_t y = 0; y < side && keys.size() < n; y++) {
+         for (size_t x = 0; x < side && keys.size() < n; x++) {
+            const double dx = x + 0.5 - center, dy = y + 0.5 - center, dz = z + 0.5 - center;
+            if (dx * dx + dy * dy + dz * dz <= radius * radius) {
+               keys.push_back(static_cast<K>(1 + x + y * side + z * side * side));
+            }
+         }
+      }
+   }
+   return keys;
+}
+
+// Lookups of the inserted keys by Zipf distributed rank, with exponent s
+template <typename K>
+std::vector<K> zipf_lookups(const std::vector<K>& keys, double s, std::mt19937_64& gen) {
+   std::vector<double> cdf(keys.size());
+   double sum = 0.0;
+   for (size_t i = 0; i < keys.size(); i++) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+      cdf[i] = sum;
+   }
+   std::uniform_real_distribution<double> u(0.0, sum);
+   std::vector<K> lookups(keys.size());
+   for (auto& key : lookups) {
+      const size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u(gen)) - cdf.begin();
+      key = keys[std::min(rank, keys.size() - 1)];
+   }
+   return lookups;
+}
+
+template <typename K>
+Keys<K> generate(workload w, size_t n, std::mt19937_64& gen) {
+   Keys<K> k;
+   switch (w) {
+   case workload::sequential:
+      k.inserted.resize(n);
+      for (size_t i = 0; i < n; i++) {
+         k.inserted[i] = static_cast<K>(i + 1);
+      }
+      break;
+   case workload::blocks:
+      k.inserted = block_keys<K>(n);
+      break;
+   default:
+      k.inserted = uniform_keys<K>(n, 0);
+      break;
+   }
+   if (w == workload::zipf) {
+      k.lookups = zipf_lookups(k.inserted, 0.99, gen);
+   } else {
+      k.lookups = k.inserted;
+      std::shuffle(k.lookups.begin(), k.lookups.end(), gen);
+   }
+   const std::unordered_set<K> present(k.inserted.begin(), k.inserted.end());
+   for (const K key : uniform_keys<K>(2 * n, n)) {
+      if (k.missing.size() < n && present.count(key) == 0) {
+         k.missing.push_back(key);
+      }
+   }
+   return k;
+}
+
+/*
+ * Reference map: one array of keys and one of values, Fibonacci hashing and linear probing,
+ * tombstones on erase and a rebuild at twice the size past 90% of the buckets taken.
+ */
+template <typename K, typename V>
+class OpenAddressingMap {
+public:
+   explicit OpenAddressingMap(int sizePower) { rebuild(sizePower); }
+
+   void insert(K key, const V& val) {
+      if (10 * (fill + tombstones + 1) > 9 * keys.size()) {
+         grow();
+      }
+      size_t slot = home(key);
+      size_t firstTombstone = keys.size();
+      for (;; slot = (slot + 1) & mask) {
+         if (keys[slot] == key) {
+            vals[slot] = val;
+            return;
+         }
+         if (keys[slot] == TOMBSTONE && firstTombstone == keys.size()) {
+            firstTombstone = slot;
+         }
+         if (keys[slot] == EMPTY) {
+            break;
+         }
+      }
+      if (firstTombstone != keys.size()) {
+         slot = firstTombstone;
+         tombstones--;
+      }
+      keys[slot] = key;
+      vals[slot] = val;
+      fill++;
+   }
+
+   bool find(K key, V& val) const {
+      for (size_t slot = home(key);; slot = (slot + 1) & mask) {
+         if (keys[slot] == key) {
+            val = vals[slot];
+            return true;
+         }
+         if (keys[slot] == EMPTY) {
+            return false;
+         }
+      }
+   }
+
+   void erase(K key) {
+      for (size_t slot = home(key);; slot = (slot + 1) & mask) {
+         if (keys[slot] == key) {
+            keys[slot] = TOMBSTONE;
+            fill--;
+            tombstones++;
+            return;
+         }
+         if (keys[slot] == EMPTY) {
+            return;
+         }
+      }
+   }
+
+private:
+   static constexpr K EMPTY = std::numeric_limits<K>::max();
+   static constexpr K TOMBSTONE = std::numeric_limits<K>::max() - 1;
+
+   size_t home(K key) const { return (static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> shift; }
+
+   void rebuild(int sizePower) {
+      keys.assign(size_t(1) << sizePower, EMPTY);
+      vals.assign(keys.size(), V{});
+      mask = keys.size() - 1;
+      shift = 64 - sizePower;
+      fill = 0;
+      tombstones = 0;
+   }
+
+   void grow() {
+      std::vector<K> oldKeys;
+      std::vector<V> oldVals;
+      oldKeys.swap(keys);
+      oldVals.swap(vals);
+      rebuild(64 - shift + 1);
+      for (size_t i = 0; i < oldKeys.size(); i++) {
+         if (oldKeys[i] != EMPTY && oldKeys[i] != TOMBSTONE) {
+            insert(oldKeys[i], oldVals[i]);
+         }
+      }
+   }
+
+   std::vector<K> keys;
+   std::vector<V> vals;
+   size_t mask = 0;
+   int shift = 64;
+   size_t fill = 0;
+   size_t tombstones = 0;
+};
+
+// Batch interfaces over the maps under test. retrieve() leaves the values of missing keys alone.
+template <typename K, typename V>
+struct HashinatorRunner {
+   HashinatorRunner(int sizePower, HostTarget target) : map(sizePower), target(target) {}
+   void insert(K* keys, V* vals, size_t n) { map.insert(keys, vals, n, 1.0, 0, target); }
+   void retrieve(K* keys, V* vals, size_t n) { map.retrieve(keys, vals, n, 0, target); }
+   void erase(K* keys, size_t n) { map.erase(keys, n, 0, target); }
+   // Hashinator leaves tombstones to be cleaned up between phases
+   void cleanup() { map.performCleanupTasks(); }
+   Hashmap<K, V> map;
+   HostTarget target;
+};
+
+template <typename K, typename V>
+struct StdRunner {
+   StdRunner(int sizePower, double loadFactor) { map.reserve(static_cast<size_t>((1 << sizePower) * loadFactor)); }
+   void insert(K* keys, V* vals, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         map[keys[i]] = vals[i];
+      }
+   }
+   void retrieve(K* keys, V* vals, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         auto it = map.find(keys[i]);
+         if (it != map.end()) {
+            vals[i] = it->second;
+         }
+      }
+   }
+   void erase(K* keys, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         map.erase(keys[i]);
+      }
+   }
+   void cleanup() {}
+   std::unordered_map<K, V> map;
+};
+
+template <typename K, typename V>
+struct OpenAddressingRunner {
+   explicit OpenAddressingRunner(int sizePower) : map(sizePower) {}
+   void insert(K* keys, V* vals, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         map.insert(keys[i], vals[i]);
+      }
+   }
+   void retrieve(K* keys, V* vals, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         map.find(keys[i], vals[i]);
+      }
+   }
+   void erase(K* keys, size_t n) {
+      for (size_t i = 0; i < n; i++) {
+         map.erase(keys[i]);
+      }
+   }
+   void cleanup() {}
+   OpenAddressingMap<K, V> map;
+};
+
+struct Result {
+   std::string map;
+   std::string workload;
+   size_t keyBytes;
+   size_t valueBytes;
+   int sizePower;
+   double loadFactor;
+   std::string operation;
+   size_t elements;
+   double seconds;
+   double mops() const { return seconds > 0.0 ? elements / seconds * 1e-6 : 0.0; }
+};
+
+struct Options {
+   int repeats = 3;
+   std::vector<int> sizes = {14, 18, 22};
+   std::vector<double> loadFactors = {0.5, 0.75, 0.9};
+   std::string format = "csv";
+   std::string output;
+};
+
+template <typename F>
+double seconds(F&& f) {
+   const auto start = std::chrono::steady_clock::now();
+   f();
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct Case {
+   workload w;
+   int sizePower;
+   double loadFactor;
+   int repeats;
+};
+
+/*
+ * Runs one case on one map. make() builds an empty map. Returns false if a lookup read a
+ * wrong value or found a missing key.
+ */
+template <typename K, typename V, typename Make>
+bool run(const char* label, const Case& c, const Keys<K>& k, Make make, std::vector<Result>& results) {
+   const size_t n = k.inserted.size();
+   std::vector<K> inserted = k.inserted, lookups = k.lookups, missing = k.missing;
+   std::vector<V> vals(n), out(n);
+   for (size_t i = 0; i < n; i++) {
+      vals[i] = make_value<V>(inserted[i]);
+   }
+   const size_t churned = c.w == workload::churn ? n / 10 : 0;
+   std::vector<K> fresh = churned ? uniform_keys<K>(churned, 4 * n) : std::vector<K>{};
+   std::vector<V> freshVals(churned);
+   for (size_t i = 0; i < churned; i++) {
+      freshVals[i] = make_value<V>(fresh[i]);
+   }
+   std::vector<std::pair<const char*, double>> best = {
+       {"insert", 1e300}, {"lookup_hit", 1e300}, {"lookup_miss", 1e300}, {"churn", 1e300}, {"erase", 1e300}};
+   std::vector<size_t> elements = {n, n, missing.size(), 2 * churned, n};
+   bool ok = true;
+   for (int r = 0; r < c.repeats; r++) {
+      auto map = make();
+      std::vector<double> t(best.size(), 0.0);
+      t[0] = seconds([&] { map.insert(inserted.data(), vals.data(), n); });
+      t[1] = seconds([&] { map.retrieve(lookups.data(), out.data(), n); });
+      for (size_t i = 0; i < n; i++) {
+         ok = ok && out[i] == make_value<V>(lookups[i]);
+      }
+      const V sentinel = make_value<V>(0);
+      std::fill(out.begin(), out.end(), sentinel);
+      t[2] = seconds([&] { map.retrieve(missing.data(), out.data(), missing.size()); });
+      ok = ok && std::all_of(out.begin(), out.begin() + missing.size(), [&](const V& v) { return v == sentinel; });
+      if (churned) {
+         // Swaps the first tenth of the keys for fresh ones and back, so every repeat starts alike
+         t[3] = seconds([&] {
+            map.erase(inserted.data(), churned);
+            map.cleanup();
+            map.insert(fresh.data(), freshVals.data(), churned);
+         });
+         map.erase(fresh.data(), churned);
+         map.cleanup();
+         map.insert(inserted.data(), vals.data(), churned);
+      }
+      t[4] = seconds([&] { map.erase(inserted.data(), n); });
+      for (size_t i = 0; i < best.size(); i++) {
+         best[i].second = std::min(best[i].second, t[i]);
+      }
+   }
+   for (size_t i = 0; i < best.size(); i++) {
+      if (elements[i] != 0) {
+         results.push_back(Result{label, name(c.w), sizeof(K), sizeof(V), c.sizePower, c.loadFactor, best[i].first,
+                                  elements[i], best[i].second});
+      }
+   }
+   if (!ok) {
+      std::cerr << label << " returned wrong values on " << name(c.w) << " keys of " << sizeof(K) << " B, values of "
+                << sizeof(V) << " B, 2^" << c.sizePower << " buckets at load factor " << c.loadFactor << std::endl;
+   }
+   return ok;
+}
+
+template <typename K, typename V>
+bool sweep(const Options& o, std::vector<Result>& results) {
+   bool ok = true;
+   std::mt19937_64 gen(42);
+   for (workload w : {workload::uniform, workload::zipf, workload::sequential, workload::blocks, workload::churn}) {
+      for (int sizePower : o.sizes) {
+         for (double lf : o.loadFactors) {
+            const Case c{w, sizePower, lf, o.repeats};
+            const Keys<K> k = generate<K>(w, static_cast<size_t>((size_t(1) << sizePower) * lf), gen);
+            ok &= run<K, V>("hashinator_serial", c, k,
+                            [&] { return HashinatorRunner<K, V>(sizePower, split::execution_policy::serial); },
+                            results);
+            ok &= run<K, V>("hashinator_threaded", c, k,
+                            [&] { return HashinatorRunner<K, V>(sizePower, split::execution_policy::parallel); },
+                            results);
+            ok &= run<K, V>("std_unordered_map", c, k, [&] { return StdRunner<K, V>(sizePower, lf); }, results);
+            ok &= run<K, V>("open_addressing", c, k, [&] { return OpenAddressingRunner<K, V>(sizePower); }, results);
+         }
+      }
+   }
+   return ok;
+}
+
+void write_csv(std::ostream& out, const std::vector<Result>& results) {
+   out << "map,workload,key_bytes,value_bytes,size_power,load_factor,operation,elements,seconds,mops\n";
+   for (const auto& r : results) {
+      out << r.map << "," << r.workload << "," << r.keyBytes << "," << r.valueBytes << "," << r.sizePower << ","
+          << r.loadFactor << "," << r.operation << "," << r.elements << "," << r.seconds << "," << r.mops() << "\n";
+   }
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results) {
+   out << "{\"suite\":\"hashinator_cpu\",\"host_threads\":" << split::host_concurrency() << ",\"results\":[";
+   for (size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      out << (i ? "," : "") << "\n{\"map\":\"" << r.map << "\",\"workload\":\"" << r.workload
+          << "\",\"key_bytes\":" << r.keyBytes << ",\"value_bytes\":" << r.valueBytes
+          << ",\"size_power\":" << r.sizePower << ",\"load_factor\":" << r.loadFactor << ",\"operation\":\""
+          << r.operation << "\",\"elements\":" << r.elements << ",\"seconds\":" << r.seconds
+          << ",\"mops\":" << r.mops() << "}";
+   }
+   out << "\n]}\n";
+}
+
+template <typename T>
+std::vector<T> parse_list(const std::string& arg) {
+   std::vector<T> list;
+   std::stringstream in(arg);
+   std::string item;
+   while (std::getline(in, item, ',')) {
+      std::stringstream value(item);
+      T v;
+      value >> v;
+      list.push_back(v);
+   }
+   return list;
+}
+
+int main(int argc, char* argv[]) {
+   Options o;
+   for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      const bool hasValue = i + 1 < argc;
+      if (arg == "--quick") {
+         o.repeats = 1;
+         o.sizes = {12};
+         o.loadFactors = {0.5, 0.9};
+      } else if (arg == "--repeats" && hasValue) {
+         o.repeats = std::max(1, std::atoi(argv[++i]));
+      } else if (arg == "--sizes" && hasValue) {
+         o.sizes = parse_list<int>(argv[++i]);
+      } else if (arg == "--load-factors" && hasValue) {
+         o.loadFactors = parse_list<double>(argv[++i]);
+      } else if (arg == "--format" && hasValue) {
+         o.format = argv[++i];
+      } else if (arg == "--output" && hasValue) {
+         o.output = argv[++i];
+      } else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [--quick] [--repeats R] [--sizes 16,20] [--load-factors 0.5,0.9] [--format csv|json]"
+                      " [--output file]"
+                   << std::endl;
+         return 1;
+      }
+   }
+   std::vector<Result> results;
+   bool ok = sweep<uint32_t, uint32_t>(o, results);
+   ok &= sweep<uint32_t, uint64_t>(o, results);
+   ok &= sweep<uint64_t, uint64_t>(o, results);
+
+   std::ofstream file;
+   if (!o.output.empty()) {
+      file.open(o.output);
+   }
+   std::ostream& out = o.output.empty() ? std::cout : file;
+   if (o.format == "json") {
+      write_json(out, results);
+   } else {
+      write_csv(out, results);
+   }
+   if (!out) {
+      std::cerr << "Could not write the results" << std::endl;
+      return 1;
+   }
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <unordered_set>
+#include <random>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+static constexpr int R = 5;
+static constexpr float LOAD_FACTOR = 0.9;
+
+using namespace std::chrono;
+using namespace Hashinator;
+typedef uint32_t val_type;
+typedef uint32_t key_type;
+using hashmap= Hashmap<key_type,val_type>;
+
+auto generateNonDuplicateKeys(std::vector<key_type>& keys,const size_t size)->void {
+    std::unordered_set<key_type> unique_keys;
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<key_type> dist(1, std::numeric_limits<key_type>::max()-2);
+    keys.clear();
+    while (keys.size() < size) {
+        key_type key = dist(gen);
+        // Check if the key is already present
+        if (unique_keys.find(key) == unique_keys.end()) {
+            keys.push_back(key);
+            unique_keys.insert(key);
+        }
+    }
+}
+
+template <class Fn, class ... Args>
+auto timeMe(Fn fn, Args && ... args){
+   std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::_V2::system_clock::duration> start,stop;
+   double total_time=0;
+   start = std::chrono::high_resolution_clock::now();
+   fn(args...);
+   stop = std::chrono::high_resolution_clock::now();
+   auto duration = duration_cast<microseconds>(stop- start).count();
+   total_time+=duration;
+   return total_time;
+}
+
+// Erase a random live key and insert a fresh one, keeping the load factor constant
+void churn(hashmap& hmap,std::vector<key_type>& live, const std::vector<key_type>& fresh,std::mt19937& gen){
+   for (auto key:fresh){
+      size_t victim=gen()%live.size();
+      hmap.erase(live[victim]);
+      live[victim]=key;
+      hmap[key]=key/2;
+   }
+}
+
+// Mean number of buckets an insertion has to probe before finding an EMPTYBUCKET or a TOMBSTONE
+double insertion_probe_length(const hashmap& hmap,const std::vector<key_type>& probes){
+   const auto* buckets = hmap.expose_bucketdata<false>();
+   const size_t bitMask = hmap.bucket_count()-1;
+   size_t total=0;
+   for (auto key:probes){
+      size_t i=0;
+      auto hashIndex = hmap.hash(key);
+      while (buckets[(hashIndex+i)&bitMask].first!=hmap.get_emptybucket() &&
+             buckets[(hashIndex+i)&bitMask].first!=hmap.get_tombstone()){
+         i++;
+      }
+      total+=i+1;
+   }
+   return (double)total/probes.size();
+}
+
+void test(int sz,rehash_policy policy,const std::vector<key_type>& keys,double& time,double& probes){
+   const size_t N = LOAD_FACTOR*(1<<sz);
+   std::mt19937 gen(sz);
+   std::vector<key_type> fresh(keys.begin()+N,keys.begin()+2*N);
+   std::vector<key_type> unseen(keys.begin()+2*N,keys.end());
+   time=0;
+   probes=0;
+   for (int i =0; i<R; i++){
+      hashmap hmap(sz);
+      hmap.set_rehash_policy(policy);
+      std::vector<key_type> live(keys.begin(),keys.begin()+N);
+      for (auto key:live){
+         hmap[key]=key/2;
+      }
+      time+=timeMe(churn,hmap,live,fresh,gen);
+      probes+=insertion_probe_length(hmap,unseen);
+   }
+   time/=R;
+   probes/=R;
+}
+
+int main(){
+   printf("Insert/erase churn at load factor %.02f\n",LOAD_FACTOR);
+   printf("Sizepower -- Standard [us] -- Graveyard [us] -- Standard probes -- Graveyard probes\n");
+   for (int sz=10; sz<=20;sz++){
+      std::vector<key_type> keys;
+      generateNonDuplicateKeys(keys,2*LOAD_FACTOR*(1<<sz)+4096);
+      double time_standard,time_graveyard,probes_standard,probes_graveyard;
+      test(sz,rehash_policy::standard,keys,time_standard,probes_standard);
+      test(sz,rehash_policy::graveyard,keys,time_graveyard,probes_graveyard);
+      printf("%d \t %.03f %.03f \t %.02f %.02f\n",sz,time_standard,time_graveyard,probes_standard,probes_graveyard);
+   }
+   return 0;
+}
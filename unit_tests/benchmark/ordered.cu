@@ -0,0 +1,89 @@
+#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <unordered_set>
+#include <random>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+static constexpr int R = 5;
+static constexpr int SZ = 20;
+
+using namespace std::chrono;
+using namespace Hashinator;
+typedef uint32_t val_type;
+typedef uint32_t key_type;
+using hashmap= Hashmap<key_type,val_type>;
+
+auto generateNonDuplicateKeys(std::vector<key_type>& keys,const size_t size)->void {
+    std::unordered_set<key_type> unique_keys;
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<key_type> dist(1, std::numeric_limits<key_type>::max()-2);
+    keys.clear();
+    while (keys.size() < size) {
+        key_type key = dist(gen);
+        // Check if the key is already present
+        if (unique_keys.find(key) == unique_keys.end()) {
+            keys.push_back(key);
+            unique_keys.insert(key);
+        }
+    }
+}
+
+template <class Fn, class ... Args>
+auto timeMe(Fn fn, Args && ... args){
+   std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::_V2::system_clock::duration> start,stop;
+   double total_time=0;
+   start = std::chrono::high_resolution_clock::now();
+   fn(args...);
+   stop = std::chrono::high_resolution_clock::now();
+   auto duration = duration_cast<microseconds>(stop- start).count();
+   total_time+=duration;
+   return total_time;
+}
+
+void lookup(const hashmap& hmap,const std::vector<key_type>& keys,size_t& found){
+   for (auto key:keys){
+      found+=hmap.count(key);
+   }
+}
+
+void test(float lf,insertion_policy policy,const std::vector<key_type>& keys,double& hits,double& misses){
+   const size_t N = lf*(1<<SZ);
+   std::vector<key_type> present(keys.begin(),keys.begin()+N);
+   std::vector<key_type> absent(keys.begin()+N,keys.begin()+2*N);
+   hits=0;
+   misses=0;
+   size_t found=0;
+   for (int i =0; i<R; i++){
+      hashmap hmap(SZ);
+      hmap.set_insertion_policy(policy);
+      for (auto key:present){
+         hmap[key]=key/2;
+      }
+      hits+=timeMe(lookup,hmap,present,found);
+      misses+=timeMe(lookup,hmap,absent,found);
+   }
+   hits/=R;
+   misses/=R;
+   if (found!=R*N){
+      std::cerr<<"Lookup mismatch!"<<std::endl;
+   }
+}
+
+int main(){
+   printf("Lookups in a table of 2^%d buckets\n",SZ);
+   printf("Load factor -- Linear hits [us] -- Ordered hits [us] -- Linear misses [us] -- Ordered misses [us]\n");
+   for (float lf : {0.5f,0.7f,0.8f,0.9f}){
+      std::vector<key_type> keys;
+      generateNonDuplicateKeys(keys,2*lf*(1<<SZ));
+      double hits_linear,misses_linear,hits_ordered,misses_ordered;
+      test(lf,insertion_policy::linear,keys,hits_linear,misses_linear);
+      test(lf,insertion_policy::ordered,keys,hits_ordered,misses_ordered);
+      printf("%.02f \t %.03f %.03f \t %.03f %.03f\n",lf,hits_linear,hits_ordered,misses_linear,misses_ordered);
+   }
+   return 0;
+}
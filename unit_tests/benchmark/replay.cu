@@ -0,0 +1,109 @@
+#include <iostream>
+#include <stdlib.h>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+
+/*
+ * Replays a workload file recorded with Hashmap::record_workload() on a few map
+ * configurations and prints the throughput and latencies of each one.
+ *    replay [workload file]
+ * Without a file a synthetic workload is recorded first and replayed.
+ */
+using namespace Hashinator;
+typedef uint32_t val_type;
+typedef uint32_t key_type;
+using hashmap= Hashmap<key_type,val_type>;
+template <int elementsPerWarp>
+using warpmap= Hashmap<key_type,val_type,std::numeric_limits<key_type>::max(),std::numeric_limits<key_type>::max()-1,
+                       HashFunctions::Fibonacci<key_type>,
+                       Hashers::HostHasher<key_type,val_type,HashFunctions::Fibonacci<key_type>,
+                                           std::numeric_limits<key_type>::max(),
+                                           std::numeric_limits<key_type>::max()-1,defaults::WARPSIZE,elementsPerWarp>>;
+
+// Batches of inserts, lookups and erasures with hot keys looked up one at a time in between
+bool record_synthetic(const std::string& path){
+   hashmap hmap;
+   if (!hmap.record_workload(path)){
+      return false;
+   }
+   std::mt19937 gen(42);
+   const size_t batch=1<<14;
+   std::vector<key_type> keys(batch);
+   std::vector<val_type> vals(batch);
+   key_type next=1;
+   for (int round=0; round<16; ++round){
+      for (size_t i=0; i<batch; ++i){
+         keys[i]=next++;
+         vals[i]=keys[i]/2;
+      }
+      hmap.insert(keys.data(),vals.data(),batch);
+      std::uniform_int_distribution<key_type> any(1,next+batch);
+      for (size_t i=0; i<batch; ++i){
+         keys[i]=any(gen);
+      }
+      hmap.retrieve(keys.data(),vals.data(),batch);
+      std::geometric_distribution<key_type> hot(1e-3);
+      for (size_t i=0; i<batch; ++i){
+         const key_type key=1+hot(gen);
+         if (hmap.find(key)==hmap.end()){
+            hmap[key]=key/2;
+         }
+      }
+      for (size_t i=0; i<batch/4; ++i){
+         keys[i]=1+any(gen)%(next-1);
+      }
+      hmap.erase(keys.data(),batch/4);
+      for (size_t i=0; i<batch/16; ++i){
+         hmap.erase(1+any(gen)%(next-1));
+      }
+   }
+   hmap.stop_workload_recording();
+   return true;
+}
+
+template <typename MAP, typename Setup>
+void run(const char* label,const Workload<key_type,val_type>& w,HostTarget target,Setup setup){
+   MAP hmap;
+   setup(hmap);
+   const ReplayReport report=replay(w,hmap,target);
+   printf("%s\n%s",label,report.to_string().c_str());
+}
+
+int main(int argc, char* argv[]){
+   std::string path;
+   if (argc>1){
+      path=argv[1];
+   } else {
+      path=(std::filesystem::temp_directory_path()/"hashinator_synthetic.hnwl").string();
+      if (!record_synthetic(path)){
+         std::cerr<<"Could not write "<<path<<std::endl;
+         return 1;
+      }
+   }
+   Workload<key_type,val_type> w;
+   if (!Workload<key_type,val_type>::load(path,w)){
+      std::cerr<<"Could not read a workload of 32 bit keys and values from "<<path<<std::endl;
+      return 1;
+   }
+   printf("Replaying %zu operations over %zu keys from %s\n",w.ops.size(),w.elements(),path.c_str());
+   auto none=[](auto&){};
+   run<hashmap>("standard, serial batches",w,split::execution_policy::serial,none);
+   run<hashmap>("standard, adaptive batches",w,split::execution_policy::adaptive,none);
+   run<hashmap>("standard, parallel batches",w,split::execution_policy::parallel,none);
+   run<hashmap>("graveyard rehash policy",w,split::execution_policy::adaptive,
+                [](hashmap& h){h.set_rehash_policy(rehash_policy::graveyard);});
+   run<hashmap>("ordered insertion policy",w,split::execution_policy::adaptive,
+                [](hashmap& h){h.set_insertion_policy(insertion_policy::ordered);});
+   run<warpmap<8>>("4 lane virtual warps",w,split::execution_policy::adaptive,none);
+   run<warpmap<32>>("1 lane virtual warps",w,split::execution_policy::adaptive,none);
+   if (argc<=1){
+      std::filesystem::remove(path);
+   }
+   return 0;
+}
@@ -0,0 +1,728 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+
+/*
+ * Thread scaling of Hashinator and SplitVector on the host. A .cpp file like cpu_suite.cpp.
+ *    scaling [--quick] [--threads 1,2,4] [--size P] [--scaling strong|weak|both] [--repeats R]
+ *            [--pin none|compact|spread] [--numa none|first-touch|interleave]
+ *            [--format csv|json] [--output file]
+ * Strong scaling runs 2^P elements at every thread count, weak scaling gives every thread
+ * 2^P divided by the largest thread count, so the largest runs of both are the same size.
+ * The workloads are run on the threads they would get in an application:
+ *    library:    the parallel batch calls (insert, retrieve and erase on the map, copy_if on a
+ *                SplitVector), spread over split::set_host_concurrency() threads of the pool,
+ *                or of OpenMP when built with -DSPLIT_USE_OPENMP
+ *    std_thread: user threads calling the concurrent host accessors warpInsert, warpFind and
+ *                warpErase on one shared map, or writing and summing slices of a SplitVector
+ *    openmp:     the same user loops in an omp parallel region, when built with -fopenmp
+ * Every successful insertion and erasure bumps the fill and tombstone counters of the shared
+ * MapInfo atomically, and every probe reads the size next to them. partitioned_insert does
+ * the work of concurrent_insert on one private map per thread; the gap between the two is
+ * the price of sharing the table. Built with -DHASHINATOR_INSTRUMENT the compare and swaps
+ * that lost a race for a bucket are reported as well.
+ * Each row is the best of R repeats; speedup is the throughput relative to the smallest
+ * thread count run (taken to scale perfectly) and efficiency is the speedup per thread.
+ * --pin binds thread t to the t-th allowed CPU (compact) or spreads the threads evenly over
+ * them (spread). --numa interleave spreads every page over the online NUMA nodes, and
+ * first-touch has each thread initialize the inputs it works on so their pages land on its
+ * node; the buckets of the maps are always initialized by the constructing thread. Both are
+ * Linux only and need no libnuma. The run fails if any workload gives a wrong result.
+ */
+using namespace Hashinator;
+
+using Map = Hashmap<uint64_t, uint64_t>;
+
+enum class pinning { none, compact, spread };
+enum class placement { none, first_touch, interleave };
+enum class threading { library, std_thread, openmp };
+
+const char* name(threading t) {
+   static const char* names[] = {"library", "std_thread", "openmp"};
+   return names[static_cast<int>(t)];
+}
+
+// Distinct keys far from the empty bucket and tombstone markers
+inline uint64_t key(uint64_t i) {
+   uint32_t x = static_cast<uint32_t>(i);
+   x ^= x >> 16;
+   x *= 0x85ebca6bu;
+   x ^= x >> 13;
+   x *= 0xc2b2ae35u;
+   x ^= x >> 16;
+   return x;
+}
+
+inline uint64_t value(uint64_t i) { return 3 * i + 1; }
+
+// Smallest map holding n elements at a load factor of at most 0.5
+int size_power(size_t n) { return std::max(4, static_cast<int>(std::ceil(std::log2(std::max<size_t>(n, 1)))) + 1); }
+
+double now() { return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+uint64_t cas_failures() {
+   return split::instrument::get(split::instrument::snapshot(), split::instrument::counter::cas_failures);
+}
+
+/*
+ * Pinning and page placement
+ */
+struct Placement {
+   pinning pin = pinning::none;
+   placement numa = placement::none;
+   std::vector<int> cpus; // CPUs the process may run on
+
+   Placement() {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+         for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) {
+               cpus.push_back(c);
+            }
+         }
+      }
+#endif
+   }
+
+   // Binds the calling thread, thread slot of nThreads, to its CPU
+   void bind(size_t slot, size_t nThreads) const {
+#ifdef __linux__
+      if (pin == pinning::none || cpus.empty()) {
+         return;
+      }
+      const size_t n = cpus.size();
+      const size_t index = pin == pinning::compact || nThreads >= n ? slot % n : slot * n / nThreads;
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpus[index], &set);
+      pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+      (void)slot;
+      (void)nThreads;
+#endif
+   }
+};
+
+// NUMA nodes with memory, read from sysfs
+std::vector<int> numa_nodes() {
+   std::vector<int> nodes;
+#ifdef __linux__
+   std::error_code error;
+   for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/node", error)) {
+      const std::string dir = entry.path().filename().string();
+      if (dir.rfind("node", 0) == 0 && dir.size() > 4 && std::isdigit(static_cast<unsigned char>(dir[4]))) {
+         nodes.push_back(std::stoi(dir.substr(4)));
+      }
+   }
+   std::sort(nodes.begin(), nodes.end());
+#endif
+   return nodes;
+}
+
+// Interleaves the pages of the calling thread, and of the threads it starts later, over nodes
+bool interleave_pages(const std::vector<int>& nodes) {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+   constexpr int MPOL_INTERLEAVE = 3;
+   constexpr size_t bits = 8 * sizeof(unsigned long);
+   std::vector<unsigned long> mask(4, 0);
+   for (int node : nodes) {
+      if (static_cast<size_t>(node) < mask.size() * bits) {
+         mask[node / bits] |= 1ul << (node % bits);
+      }
+   }
+   return !nodes.empty() && syscall(SYS_set_mempolicy, MPOL_INTERLEAVE, mask.data(), mask.size() * bits + 1) == 0;
+#else
+   (void)nodes;
+   return false;
+#endif
+}
+
+/*
+ * Running on threads
+ */
+
+// Runs prepare(t) and then work(t) on nThreads user threads and returns the seconds from the
+// moment every thread is prepared until the last one is done
+template <typename Prepare, typename Work>
+double on_threads(threading kind, size_t nThreads, const Placement& where, Prepare&& prepare, Work&& work) {
+   double start = 0.0;
+   double end = 0.0;
+#ifdef _OPENMP
+   if (kind == threading::openmp) {
+#pragma omp parallel num_threads(static_cast<int>(nThreads))
+      {
+         const size_t t = omp_get_thread_num();
+         where.bind(t, nThreads);
+         prepare(t);
+#pragma omp barrier
+#pragma omp master
+         start = now();
+#pragma omp barrier
+         work(t);
+#pragma omp barrier
+#pragma omp master
+         end = now();
+      }
+      return end - start;
+   }
+#endif
+   (void)kind;
+   std::atomic<size_t> ready{0};
+   std::atomic<bool> go{false};
+   std::vector<std::thread> threads;
+   for (size_t t = 0; t < nThreads; t++) {
+      threads.emplace_back([&, t]() {
+         where.bind(t, nThreads);
+         prepare(t);
+         ready++;
+         while (!go.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+         }
+         work(t);
+      });
+   }
+   while (ready.load() < nThreads) {
+      std::this_thread::yield();
+   }
+   start = now();
+   go.store(true, std::memory_order_release);
+   for (auto& thread : threads) {
+      thread.join();
+   }
+   end = now();
+   return end - start;
+}
+
+// Binds the threads of the library backend, each of them taking one chunk of a job that
+// waits until all of them have arrived. Gives up after a second if some never show up.
+void bind_library_threads(size_t nThreads, const Placement& where) {
+#ifndef SPLIT_USE_STD_EXECUTION
+   if (where.pin == pinning::none) {
+      return;
+   }
+   std::atomic<size_t> arrived{0};
+   split::parallel_for(
+       nThreads, 1,
+       [&](size_t begin, size_t end) {
+          for (size_t slot = begin; slot < end; slot++) {
+             where.bind(slot, nThreads);
+             arrived++;
+             const double deadline = now() + 1.0;
+             while (arrived.load() < nThreads && now() < deadline) {
+                std::this_thread::yield();
+             }
+          }
+       },
+       split::execution_policy::parallel);
+#else
+   (void)nThreads;
+   (void)where;
+#endif
+}
+
+// First element of the slice of thread t
+inline size_t slice(size_t n, size_t t, size_t nThreads) { return n * t / nThreads; }
+
+// Inputs of the library batches, left uninitialized until filled
+struct Inputs {
+   explicit Inputs(size_t n) : n(n), keys(new uint64_t[n]), vals(new uint64_t[n]), out(new uint64_t[n]) {}
+
+   // Fills the inputs on the calling thread, or under first-touch on the threads of the batches
+   void fill(placement numa) {
+      auto body = [this](size_t begin, size_t end) {
+         for (size_t i = begin; i < end; i++) {
+            keys[i] = key(i);
+            vals[i] = value(i);
+            out[i] = 0;
+         }
+      };
+      if (numa == placement::first_touch) {
+         split::parallel_for(n, std::max<size_t>(1024, n / (8 * split::host_concurrency())), body,
+                             split::execution_policy::parallel);
+      } else {
+         body(0, n);
+      }
+   }
+
+   size_t n;
+   std::unique_ptr<uint64_t[]> keys;
+   std::unique_ptr<uint64_t[]> vals;
+   std::unique_ptr<uint64_t[]> out;
+};
+
+/*
+ * Workloads. Each runs n elements on nThreads threads once and returns the seconds the
+ * measured part took, or a negative number if the result was wrong.
+ */
+struct Run {
+   size_t n;
+   size_t nThreads;
+   const Placement& where;
+};
+
+const auto parallel = split::execution_policy::parallel;
+
+double batch_insert(const Run& r) {
+   Inputs in(r.n);
+   in.fill(r.where.numa);
+   Map map(size_power(r.n));
+   const double start = now();
+   map.insert(in.keys.get(), in.vals.get(), r.n, 1.0, 0, parallel);
+   const double seconds = now() - start;
+   return map.size() == r.n ? seconds : -1.0;
+}
+
+double batch_retrieve(const Run& r) {
+   Inputs in(r.n);
+   in.fill(r.where.numa);
+   Map map(size_power(r.n));
+   map.insert(in.keys.get(), in.vals.get(), r.n, 1.0, 0, parallel);
+   const double start = now();
+   map.retrieve(in.keys.get(), in.out.get(), r.n, 0, parallel);
+   const double seconds = now() - start;
+   for (size_t i = 0; i < r.n; i++) {
+      if (in.out[i] != value(i)) {
+         return -1.0;
+      }
+   }
+   return seconds;
+}
+
+double batch_erase(const Run& r) {
+   Inputs in(r.n);
+   in.fill(r.where.numa);
+   Map map(size_power(r.n));
+   map.insert(in.keys.get(), in.vals.get(), r.n, 1.0, 0, parallel);
+   const double start = now();
+   map.erase(in.keys.get(), r.n, 0, parallel);
+   const double seconds = now() - start;
+   return map.size() == 0 ? seconds : -1.0;
+}
+
+double tools_copy_if(const Run& r) {
+   split::SplitVector<uint64_t> input(r.n);
+   split::SplitVector<uint64_t> output;
+   size_t expected = 0;
+   for (size_t i = 0; i < r.n; i++) {
+      input[i] = key(i);
+      expected += input[i] % 2 == 0;
+   }
+   const double start = now();
+   split::tools::copy_if(input, output, [](const uint64_t& x) { return x % 2 == 0; }, parallel);
+   const double seconds = now() - start;
+   return output.size() == expected ? seconds : -1.0;
+}
+
+// Per thread results, a cache line apart
+struct alignas(64) Partial {
+   uint64_t value = 0;
+};
+
+// The keys each user thread works on, filled by the thread itself under first-touch
+struct SlicedKeys {
+   explicit SlicedKeys(const Run& r) : keys(new uint64_t[r.n]), firstTouch(r.where.numa == placement::first_touch) {
+      if (!firstTouch) {
+         fill(0, r.n);
+      }
+   }
+   void prepare(const Run& r, size_t t) {
+      if (firstTouch) {
+         fill(slice(r.n, t, r.nThreads), slice(r.n, t + 1, r.nThreads));
+      }
+   }
+   void fill(size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+         keys[i] = key(i);
+      }
+   }
+   std::unique_ptr<uint64_t[]> keys;
+   bool firstTouch;
+};
+
+double concurrent_insert(const Run& r, threading kind) {
+   SlicedKeys in(r);
+   Map map(size_power(r.n));
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where, [&](size_t t) { in.prepare(r, t); },
+       [&](size_t t) {
+          for (size_t i = slice(r.n, t, r.nThreads); i < slice(r.n, t + 1, r.nThreads); i++) {
+             map.warpInsert(in.keys[i], value(i));
+          }
+       });
+   return map.size() == r.n ? seconds : -1.0;
+}
+
+double partitioned_insert(const Run& r, threading kind) {
+   SlicedKeys in(r);
+   std::vector<std::unique_ptr<Map>> maps(r.nThreads);
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where,
+       [&](size_t t) {
+          in.prepare(r, t);
+          maps[t] = std::make_unique<Map>(size_power(slice(r.n, t + 1, r.nThreads) - slice(r.n, t, r.nThreads)));
+       },
+       [&](size_t t) {
+          for (size_t i = slice(r.n, t, r.nThreads); i < slice(r.n, t + 1, r.nThreads); i++) {
+             maps[t]->warpInsert(in.keys[i], value(i));
+          }
+       });
+   size_t total = 0;
+   for (const auto& map : maps) {
+      total += map->size();
+   }
+   return total == r.n ? seconds : -1.0;
+}
+
+double concurrent_find(const Run& r, threading kind) {
+   SlicedKeys in(r);
+   Map map(size_power(r.n));
+   for (size_t i = 0; i < r.n; i++) {
+      map.warpInsert(key(i), value(i));
+   }
+   std::vector<Partial> wrong(r.nThreads);
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where, [&](size_t t) { in.prepare(r, t); },
+       [&](size_t t) {
+          for (size_t i = slice(r.n, t, r.nThreads); i < slice(r.n, t + 1, r.nThreads); i++) {
+             uint64_t val = 0;
+             map.warpFind(in.keys[i], val);
+             wrong[t].value += val != value(i);
+          }
+       });
+   for (const auto& w : wrong) {
+      if (w.value) {
+         return -1.0;
+      }
+   }
+   return seconds;
+}
+
+// Eight finds, one insertion of a new key and one erasure in every ten operations, on a
+// map holding the first half of the keys
+double concurrent_mixed(const Run& r, threading kind) {
+   Map map(size_power(r.n + r.n / 2));
+   for (size_t i = 0; i < r.n / 2; i++) {
+      map.warpInsert(key(i), value(i));
+   }
+   std::vector<Partial> found(r.nThreads);
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where, [](size_t) {},
+       [&](size_t t) {
+          for (size_t j = slice(r.n, t, r.nThreads); j < slice(r.n, t + 1, r.nThreads); j++) {
+             if (j % 10 == 8) {
+                map.warpInsert(key(r.n / 2 + j), value(j));
+             } else if (j % 10 == 9) {
+                map.warpErase(key(j / 2));
+             } else {
+                uint64_t val = 0;
+                map.warpFind(key(j / 2), val);
+                found[t].value += val;
+             }
+          }
+       });
+   const size_t inserted = r.n / 10 + (r.n % 10 > 8);
+   const size_t erased = r.n / 10;
+   return map.size() == r.n / 2 + inserted - erased ? seconds : -1.0;
+}
+
+double vector_fill(const Run& r, threading kind) {
+   split::SplitVector<uint64_t> v(r.n);
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where, [](size_t) {},
+       [&](size_t t) {
+          for (size_t i = slice(r.n, t, r.nThreads); i < slice(r.n, t + 1, r.nThreads); i++) {
+             v[i] = key(i);
+          }
+       });
+   for (size_t i = 0; i < r.n; i++) {
+      if (v[i] != key(i)) {
+         return -1.0;
+      }
+   }
+   return seconds;
+}
+
+double vector_sum(const Run& r, threading kind) {
+   split::SplitVector<uint64_t> v(r.n);
+   uint64_t expected = 0;
+   for (size_t i = 0; i < r.n; i++) {
+      v[i] = key(i);
+      expected += v[i];
+   }
+   std::vector<Partial> sums(r.nThreads);
+   const double seconds = on_threads(
+       kind, r.nThreads, r.where, [](size_t) {},
+       [&](size_t t) {
+          uint64_t sum = 0;
+          for (size_t i = slice(r.n, t, r.nThreads); i < slice(r.n, t + 1, r.nThreads); i++) {
+             sum += v[i];
+          }
+          sums[t].value = sum;
+       });
+   uint64_t total = 0;
+   for (const auto& s : sums) {
+      total += s.value;
+   }
+   return total == expected ? seconds : -1.0;
+}
+
+struct Benchmark {
+   const char* name;
+   bool library;
+   double (*batch)(const Run&);
+   double (*user)(const Run&, threading);
+};
+
+const Benchmark benchmarks[] = {
+    {"batch_insert", true, batch_insert, nullptr},
+    {"batch_retrieve", true, batch_retrieve, nullptr},
+    {"batch_erase", true, batch_erase, nullptr},
+    {"tools_copy_if", true, tools_copy_if, nullptr},
+    {"concurrent_insert", false, nullptr, concurrent_insert},
+    {"partitioned_insert", false, nullptr, partitioned_insert},
+    {"concurrent_find", false, nullptr, concurrent_find},
+    {"concurrent_mixed", false, nullptr, concurrent_mixed},
+    {"vector_fill", false, nullptr, vector_fill},
+    {"vector_sum", false, nullptr, vector_sum},
+};
+
+/*
+ * Sweeps and reports
+ */
+struct Result {
+   std::string scaling;
+   std::string workload;
+   std::string threading;
+   size_t threads;
+   size_t elements;
+   double seconds;
+   double throughput; // Million elements per second
+   double speedup;
+   double efficiency;
+   uint64_t casFailures;
+};
+
+struct Options {
+   std::vector<size_t> threads;
+   int sizePower = 22;
+   bool strong = true;
+   bool weak = true;
+   size_t repeats = 3;
+   Placement where;
+};
+
+// Best of the repeats of one workload, or false if any of them was wrong
+bool measure(const Benchmark& w, threading kind, const Run& r, size_t repeats, Result& result) {
+   double best = -1.0;
+   uint64_t failures = 0;
+   for (size_t k = 0; k < repeats; k++) {
+      split::instrument::reset();
+      const double seconds = w.library ? w.batch(r) : w.user(r, kind);
+      if (seconds < 0.0) {
+         return false;
+      }
+      if (best < 0.0 || seconds < best) {
+         best = seconds;
+         failures = cas_failures();
+      }
+   }
+   result.seconds = best;
+   result.throughput = best > 0.0 ? r.n / best / 1e6 : 0.0;
+   result.casFailures = failures;
+   return true;
+}
+
+bool sweep(const Options& options, bool strong, std::vector<Result>& results) {
+   const size_t total = size_t(1) << options.sizePower;
+   const size_t perThread = std::max<size_t>(1, total / options.threads.back());
+   std::vector<threading> kinds = {threading::library, threading::std_thread};
+#ifdef _OPENMP
+   kinds.push_back(threading::openmp);
+#endif
+   const size_t libraryThreads = split::host_concurrency();
+   for (const Benchmark& w : benchmarks) {
+      for (threading kind : kinds) {
+         if (w.library != (kind == threading::library)) {
+            continue;
+         }
+         const size_t first = results.size();
+         for (size_t nThreads : options.threads) {
+            if (kind == threading::library) {
+               // The standard parallel algorithms, and the pool past its size, cannot be limited
+               if (split::set_host_concurrency(nThreads) != nThreads) {
+                  continue;
+               }
+               bind_library_threads(nThreads, options.where);
+            }
+            const Run r{strong ? total : perThread * nThreads, nThreads, options.where};
+            Result result{strong ? "strong" : "weak", w.name, name(kind), nThreads, r.n, 0, 0, 0, 0, 0};
+            if (!measure(w, kind, r, options.repeats, result)) {
+               std::cerr << w.name << " on " << nThreads << " " << name(kind) << " threads gave a wrong result"
+                         << std::endl;
+               return false;
+            }
+            const Result& base = first < results.size() ? results[first] : result;
+            result.speedup = base.throughput > 0.0 ? result.throughput / base.throughput * base.threads : 0.0;
+            result.efficiency = result.speedup / nThreads;
+            results.push_back(result);
+         }
+         if (kind == threading::library) {
+            split::set_host_concurrency(libraryThreads);
+         }
+      }
+   }
+   return true;
+}
+
+void write_csv(std::ostream& out, const std::vector<Result>& results) {
+   out << "scaling,workload,threading,threads,elements,seconds,mops_per_s,speedup,efficiency,cas_failures\n";
+   for (const auto& r : results) {
+      out << r.scaling << "," << r.workload << "," << r.threading << "," << r.threads << "," << r.elements << ","
+          << r.seconds << "," << r.throughput << "," << r.speedup << "," << r.efficiency << "," << r.casFailures
+          << "\n";
+   }
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results, const Options& options, size_t nodes) {
+   static const char* pins[] = {"none", "compact", "spread"};
+   static const char* placements[] = {"none", "first-touch", "interleave"};
+   out << "{\"suite\":\"scaling\",\"cpus\":" << options.where.cpus.size() << ",\"numa_nodes\":" << nodes
+       << ",\"pin\":\"" << pins[static_cast<int>(options.where.pin)] << "\",\"numa\":\""
+       << placements[static_cast<int>(options.where.numa)] << "\",\"results\":[";
+   for (size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      out << (i ? "," : "") << "\n{\"scaling\":\"" << r.scaling << "\",\"workload\":\"" << r.workload
+          << "\",\"threading\":\"" << r.threading << "\",\"threads\":" << r.threads << ",\"elements\":" << r.elements
+          << ",\"seconds\":" << r.seconds << ",\"mops_per_s\":" << r.throughput << ",\"speedup\":" << r.speedup
+          << ",\"efficiency\":" << r.efficiency << ",\"cas_failures\":" << r.casFailures << "}";
+   }
+   out << "\n]}\n";
+}
+
+std::vector<size_t> parse_list(const std::string& arg) {
+   std::vector<size_t> values;
+   std::stringstream in(arg);
+   std::string item;
+   while (std::getline(in, item, ',')) {
+      values.push_back(std::max<size_t>(1, std::stoull(item)));
+   }
+   return values;
+}
+
+// Powers of two up to the number of CPUs, and the number of CPUs itself
+std::vector<size_t> default_threads() {
+   const size_t cpus = std::max(1u, std::thread::hardware_concurrency());
+   std::vector<size_t> threads;
+   for (size_t t = 1; t < cpus; t *= 2) {
+      threads.push_back(t);
+   }
+   threads.push_back(cpus);
+   return threads;
+}
+
+int main(int argc, char* argv[]) {
+   Options options;
+   options.threads = default_threads();
+   std::string format = "csv";
+   std::string output;
+   bool valid = true;
+   for (int i = 1; i < argc && valid; i++) {
+      const std::string arg = argv[i];
+      const bool hasValue = i + 1 < argc;
+      if (arg == "--quick") {
+         options.threads = {1, 2};
+         options.sizePower = 12;
+         options.repeats = 1;
+      } else if (arg == "--threads" && hasValue) {
+         options.threads = parse_list(argv[++i]);
+      } else if (arg == "--size" && hasValue) {
+         options.sizePower = std::stoi(argv[++i]);
+      } else if (arg == "--repeats" && hasValue) {
+         options.repeats = std::max(1, std::stoi(argv[++i]));
+      } else if (arg == "--scaling" && hasValue) {
+         const std::string s = argv[++i];
+         options.strong = s != "weak";
+         options.weak = s != "strong";
+         valid = s == "strong" || s == "weak" || s == "both";
+      } else if (arg == "--pin" && hasValue) {
+         const std::string s = argv[++i];
+         options.where.pin = s == "compact" ? pinning::compact : s == "spread" ? pinning::spread : pinning::none;
+         valid = s == "none" || s == "compact" || s == "spread";
+      } else if (arg == "--numa" && hasValue) {
+         const std::string s = argv[++i];
+         options.where.numa = s == "first-touch" ? placement::first_touch
+                              : s == "interleave" ? placement::interleave
+                                                  : placement::none;
+         valid = s == "none" || s == "first-touch" || s == "interleave";
+      } else if (arg == "--format" && hasValue) {
+         format = argv[++i];
+      } else if (arg == "--output" && hasValue) {
+         output = argv[++i];
+      } else {
+         valid = false;
+      }
+   }
+   if (!valid || options.threads.empty() || options.sizePower < 1 || options.sizePower > 30) {
+      std::cerr << "Usage: " << argv[0]
+                << " [--quick] [--threads 1,2,4] [--size P] [--scaling strong|weak|both] [--repeats R]\n"
+                << "       [--pin none|compact|spread] [--numa none|first-touch|interleave]"
+                << " [--format csv|json] [--output file]" << std::endl;
+      return 1;
+   }
+   std::sort(options.threads.begin(), options.threads.end());
+   options.threads.erase(std::unique(options.threads.begin(), options.threads.end()), options.threads.end());
+
+   // Before the pool starts, so that its threads inherit the policy
+   const std::vector<int> nodes = numa_nodes();
+   if (options.where.numa == placement::interleave && !interleave_pages(nodes)) {
+      std::cerr << "Could not interleave the pages, running with the default placement" << std::endl;
+      options.where.numa = placement::none;
+   }
+
+   std::vector<Result> results;
+   if ((options.strong && !sweep(options, true, results)) || (options.weak && !sweep(options, false, results))) {
+      return 1;
+   }
+
+   std::ofstream file;
+   if (!output.empty()) {
+      file.open(output);
+   }
+   std::ostream& out = output.empty() ? std::cout : file;
+   if (format == "json") {
+      write_json(out, results, options, nodes.size());
+   } else {
+      write_csv(out, results);
+   }
+   if (!out) {
+      std::cerr << "Could not write the results" << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef SPLIT_CPU_ONLY_MODE
+#define SPLIT_CPU_ONLY_MODE
+#endif
+#include "../../include/splitvector/splitvec.h"
+
+/*
+ * SplitVector against std::vector on the host. Like cpu_suite.cpp it is a .cpp file so it
+ * builds without a CUDA or HIP toolchain.
+ *    splitvector_suite [--quick] [--sizes 16,1024] [--format csv|json] [--output file]
+ * For every element type and size each operation is timed over many runs with the default
+ * allocators, then run once more with both containers on split::tracking_allocator to count
+ * the allocations and bytes it asks for; the buffers std::string allocates for itself are not
+ * counted. A call is
+ *    push_back, emplace_back: appending one element to a vector growing from empty to size
+ *    reserve, resize:         one call on an empty vector, to size elements
+ *    copy:                    copy constructing a vector of size elements
+ *    insert_middle, erase_middle: one insertion or erasure in the middle of size elements
+ *    iterate:                 visiting one element of size in a range for loop
+ */
+
+// What the benchmarks need of an element type
+template <typename T>
+struct Element;
+
+template <>
+struct Element<uint64_t> {
+   static const char* name() { return "uint64"; }
+   static uint64_t make(size_t i) { return i; }
+   template <typename Vec>
+   static void emplace(Vec& v, size_t i) {
+      v.emplace_back(i);
+   }
+   static size_t weight(uint64_t x) { return x; }
+};
+
+// Too long for the small string optimization, so every copy allocates
+template <>
+struct Element<std::string> {
+   static const char* name() { return "string32"; }
+   static std::string make(size_t i) { return std::string(32, static_cast<char>('a' + i % 26)); }
+   template <typename Vec>
+   static void emplace(Vec& v, size_t i) {
+      v.emplace_back(size_t(32), static_cast<char>('a' + i % 26));
+   }
+   static size_t weight(const std::string& x) { return x.size(); }
+};
+
+enum class op { push_back, emplace_back, reserve, resize, copy, insert_middle, erase_middle, iterate, count };
+
+const char* name(op o) {
+   static const char* names[] = {"push_back", "emplace_back",  "reserve",      "resize",
+                                 "copy",      "insert_middle", "erase_middle", "iterate"};
+   return names[static_cast<int>(o)];
+}
+
+volatile size_t sink;
+
+// Times the measured part of a run
+struct Clock {
+   void begin() { start = std::chrono::steady_clock::now(); }
+   void end() { ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count(); }
+   std::chrono::steady_clock::time_point start;
+   double ns = 0.0;
+};
+
+// Counts the allocations of the measured part of a run
+struct Counter {
+   void begin() { before = split::tracking::snapshot(); }
+   void end() {
+      const split::tracking::AllocationStats after = split::tracking::snapshot();
+      allocations += after.allocations - before.allocations;
+      bytes += after.allocatedBytes - before.allocatedBytes;
+   }
+   split::tracking::AllocationStats before;
+   uint64_t allocations = 0;
+   uint64_t bytes = 0;
+};
+
+template <typename Vec, typename T>
+Vec filled(size_t n) {
+   Vec v;
+   v.reserve(n);
+   for (size_t i = 0; i < n; i++) {
+      v.push_back(Element<T>::make(i));
+   }
+   return v;
+}
+
+// One run of o on n elements; only the part between probe.begin() and probe.end() counts. Returns the calls made.
+template <typename Vec, typename T, typename Probe>
+size_t run(op o, size_t n, Probe& probe) {
+   const T value = Element<T>::make(7);
+   switch (o) {
+   case op::push_back: {
+      Vec v;
+      probe.begin();
+      for (size_t i = 0; i < n; i++) {
+         v.push_back(value);
+      }
+      probe.end();
+      sink = v.size();
+      return n;
+   }
+   case op::emplace_back: {
+      Vec v;
+      probe.begin();
+      for (size_t i = 0; i < n; i++) {
+         Element<T>::emplace(v, i);
+      }
+      probe.end();
+      sink = v.size();
+      return n;
+   }
+   case op::reserve: {
+      Vec v;
+      probe.begin();
+      v.reserve(n);
+      probe.end();
+      sink = v.capacity();
+      return 1;
+   }
+   case op::resize: {
+      Vec v;
+      probe.begin();
+      v.resize(n);
+      probe.end();
+      sink = v.size();
+      return 1;
+   }
+   case op::copy: {
+      const Vec src = filled<Vec, T>(n);
+      probe.begin();
+      Vec dst(src);
+      probe.end();
+      sink = dst.size();
+      return 1;
+   }
+   case op::insert_middle: {
+      Vec v = filled<Vec, T>(n);
+      const size_t calls = std::min<size_t>(n, 64);
+      probe.begin();
+      for (size_t i = 0; i < calls; i++) {
+         v.insert(v.begin() + v.size() / 2, value);
+      }
+      probe.end();
+      sink = v.size();
+      return calls;
+   }
+   case op::erase_middle: {
+      Vec v = filled<Vec, T>(n);
+      const size_t calls = std::min<size_t>(n / 2, 64);
+      probe.begin();
+      for (size_t i = 0; i < calls; i++) {
+         v.erase(v.begin() + v.size() / 2);
+      }
+      probe.end();
+      sink = v.size();
+      return calls;
+   }
+   case op::iterate: {
+      const Vec v = filled<Vec, T>(n);
+      size_t sum = 0;
+      probe.begin();
+      for (const auto& x : v) {
+         sum += Element<T>::weight(x);
+      }
+      probe.end();
+      sink = sum;
+      return n;
+   }
+   default:
+      return 0;
+   }
+}
+
+struct Result {
+   std::string container;
+   std::string element;
+   size_t size;
+   std::string operation;
+   double nsPerCall;
+   double allocationsPerCall;
+   double bytesPerCall;
+};
+
+// Runs o about 2^22 elements' worth of times after a warm up run, and once more on the tracked container
+template <typename Vec, typename TrackedVec, typename T>
+Result measure(const char* container, op o, size_t n) {
+   const size_t runs = std::max<size_t>(3, std::min<size_t>(1000, (size_t(1) << 22) / std::max<size_t>(n, 1)));
+   Clock warmup;
+   run<Vec, T>(o, n, warmup);
+   Clock clock;
+   size_t calls = 0;
+   for (size_t r = 0; r < runs; r++) {
+      calls += run<Vec, T>(o, n, clock);
+   }
+   Counter counter;
+   const size_t counted = run<TrackedVec, T>(o, n, counter);
+   return Result{container,
+                 Element<T>::name(),
+                 n,
+                 name(o),
+                 calls ? clock.ns / calls : 0.0,
+                 counted ? double(counter.allocations) / counted : 0.0,
+                 counted ? double(counter.bytes) / counted : 0.0};
+}
+
+template <typename T>
+using tracked = split::tracking_allocator<split::split_host_allocator<T>>;
+
+template <typename T>
+void sweep(const std::vector<size_t>& sizes, std::vector<Result>& results) {
+   for (size_t n : sizes) {
+      for (int i = 0; i < static_cast<int>(op::count); i++) {
+         const op o = static_cast<op>(i);
+         results.push_back(measure<split::SplitVector<T>, split::SplitVector<T, tracked<T>>, T>("SplitVector", o, n));
+         results.push_back(measure<std::vector<T>, std::vector<T, tracked<T>>, T>("std::vector", o, n));
+      }
+   }
+}
+
+void write_csv(std::ostream& out, const std::vector<Result>& results) {
+   out << "container,element,size,operation,ns_per_call,allocations_per_call,bytes_per_call\n";
+   for (const auto& r : results) {
+      out << r.container << "," << r.element << "," << r.size << "," << r.operation << "," << r.nsPerCall << ","
+          << r.allocationsPerCall << "," << r.bytesPerCall << "\n";
+   }
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results) {
+   out << "{\"suite\":\"splitvector\",\"results\":[";
+   for (size_t i = 0; i < results.size(); i++) {
+      const Result& r = results[i];
+      out << (i ? "," : "") << "\n{\"container\":\"" << r.container << "\",\"element\":\"" << r.element
+          << "\",\"size\":" << r.size << ",\"operation\":\"" << r.operation << "\",\"ns_per_call\":" << r.nsPerCall
+          << ",\"allocations_per_call\":" << r.allocationsPerCall << ",\"bytes_per_call\":" << r.bytesPerCall
+          << "}";
+   }
+   out << "\n]}\n";
+}
+
+std::vector<size_t> parse_sizes(const std::string& arg) {
+   std::vector<size_t> sizes;
+   std::stringstream in(arg);
+   std::string item;
+   while (std::getline(in, item, ',')) {
+      sizes.push_back(std::stoull(item));
+   }
+   return sizes;
+}
+
+int main(int argc, char* argv[]) {
+   std::vector<size_t> sizes = {16, 1024, 65536, 1 << 20};
+   std::string format = "csv";
+   std::string output;
+   for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      const bool hasValue = i + 1 < argc;
+      if (arg == "--quick") {
+         sizes = {16, 1024};
+      } else if (arg == "--sizes" && hasValue) {
+         sizes = parse_sizes(argv[++i]);
+      } else if (arg == "--format" && hasValue) {
+         format = argv[++i];
+      } else if (arg == "--output" && hasValue) {
+         output = argv[++i];
+      } else {
+         std::cerr << "Usage: " << argv[0] << " [--quick] [--sizes 16,1024] [--format csv|json] [--output file]"
+                   << std::endl;
+         return 1;
+      }
+   }
+   std::vector<Result> results;
+   sweep<uint64_t>(sizes, results);
+   sweep<std::string>(sizes, results);
+
+   std::ofstream file;
+   if (!output.empty()) {
+      file.open(output);
+   }
+   std::ostream& out = output.empty() ? std::cout : file;
+   if (format == "json") {
+      write_json(out, results);
+   } else {
+      write_csv(out, results);
+   }
+   if (!out) {
+      std::cerr << "Could not write the results" << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <unordered_set>
+#include <random>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hashinator.h"
+static constexpr int R = 5;
+static constexpr int SZ = 20;
+static constexpr float LOAD_FACTOR = 0.7;
+
+using namespace std::chrono;
+using namespace Hashinator;
+typedef uint32_t val_type;
+typedef uint32_t key_type;
+using hashmap= Hashmap<key_type,val_type>;
+
+auto generateNonDuplicateKeys(std::vector<key_type>& keys,const size_t size)->void {
+    std::unordered_set<key_type> unique_keys;
+    std::random_device rd;
+    std::mt19937 gen(rd());
+    std::uniform_int_distribution<key_type> dist(1, std::numeric_limits<key_type>::max()-2);
+    keys.clear();
+    while (keys.size() < size) {
+        key_type key = dist(gen);
+        // Check if the key is already present
+        if (unique_keys.find(key) == unique_keys.end()) {
+            keys.push_back(key);
+            unique_keys.insert(key);
+        }
+    }
+}
+
+template <class Fn, class ... Args>
+auto timeMe(Fn fn, Args && ... args){
+   std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::_V2::system_clock::duration> start,stop;
+   double total_time=0;
+   start = std::chrono::high_resolution_clock::now();
+   fn(args...);
+   stop = std::chrono::high_resolution_clock::now();
+   auto duration = duration_cast<microseconds>(stop- start).count();
+   total_time+=duration;
+   return total_time;
+}
+
+// elementsPerWarp==0 stands for the scalar host probe
+template <int elementsPerWarp>
+void insert(hashmap& hmap,const std::vector<key_type>& keys){
+   for (auto key:keys){
+      if constexpr (elementsPerWarp==0){
+         hmap[key]=key/2;
+      } else {
+         hmap.warpInsert<false,elementsPerWarp>(key,key/2);
+      }
+   }
+}
+
+template <int elementsPerWarp>
+void lookup(const hashmap& hmap,const std::vector<key_type>& keys,size_t& found){
+   for (auto key:keys){
+      val_type val=0;
+      if constexpr (elementsPerWarp==0){
+         auto it=hmap.find(key);
+         if (it!=hmap.end()){
+            val=it->second;
+         }
+      } else {
+         hmap.warpFind<elementsPerWarp>(key,val);
+      }
+      found+=(val==key/2);
+   }
+}
+
+template <int elementsPerWarp>
+void test(const std::vector<key_type>& keys){
+   double insertion=0,hits=0,misses=0;
+   const size_t N = LOAD_FACTOR*(1<<SZ);
+   std::vector<key_type> present(keys.begin(),keys.begin()+N);
+   std::vector<key_type> absent(keys.begin()+N,keys.begin()+2*N);
+   size_t found=0;
+   for (int i =0; i<R; i++){
+      hashmap hmap(SZ);
+      insertion+=timeMe(insert<elementsPerWarp>,hmap,present);
+      hits+=timeMe(lookup<elementsPerWarp>,hmap,present,found);
+      misses+=timeMe(lookup<elementsPerWarp>,hmap,absent,found);
+   }
+   if (found<R*N){
+      std::cerr<<"Lookup mismatch!"<<std::endl;
+   }
+   if constexpr (elementsPerWarp==0){
+      printf("scalar \t %.03f %.03f %.03f\n",insertion/R,hits/R,misses/R);
+   } else {
+      printf("%d \t %.03f %.03f %.03f\n",defaults::WARPSIZE/elementsPerWarp,insertion/R,hits/R,misses/R);
+   }
+}
+
+int main(){
+   printf("Host virtual warps in a table of 2^%d buckets at load factor %.02f\n",SZ,LOAD_FACTOR);
+   printf("Lanes per virtual warp -- Insert [us] -- Hits [us] -- Misses [us]\n");
+   std::vector<key_type> keys;
+   generateNonDuplicateKeys(keys,2*LOAD_FACTOR*(1<<SZ));
+   test<0>(keys);
+   test<32>(keys);
+   test<8>(keys);
+   test<4>(keys);
+   test<2>(keys);
+   test<1>(keys);
+   return 0;
+}
@@ -7,6 +7,7 @@
 #define  SPLIT_CPU_ONLY_MODE
 #endif
 #include "../../include/splitvector/splitvec.h"
+#include "../../include/splitvector/split_tools.h"
 
 #define expect_true EXPECT_TRUE
 #define expect_false EXPECT_FALSE
@@ -444,6 +445,129 @@ TEST(Vector_Functionality , Iterator_Arithmetics){
 
 }
 
+TEST(Vector_Functionality , Host_Streams){
+   //Stream taking calls run in order on the host stream and finish by the synchronize
+   split_gpuStream_t s;
+   split_gpuEvent_t copied;
+   SPLIT_CHECK_ERR(split_gpuStreamCreate(&s));
+   SPLIT_CHECK_ERR(split_gpuEventCreate(&copied));
+   vec a(N,7);
+   vec b;
+   b.overwrite(a,s);
+   SPLIT_CHECK_ERR(split_gpuEventRecord(copied,s));
+   SPLIT_CHECK_ERR(split_gpuMemsetAsync(a.data(),0,a.size()*sizeof(int),s));
+   a.optimizeGPU(s);
+   b.resize(2*b.size(),false,s);
+   SPLIT_CHECK_ERR(split_gpuEventSynchronize(copied));
+   SPLIT_CHECK_ERR(split_gpuStreamSynchronize(s));
+   expect_true(split_gpuEventQuery(copied)==split_gpuSuccess);
+   expect_true(b.size()==2*a.size());
+   for (size_t i=0; i<a.size(); ++i){
+      expect_true(a[i]==0 && b[i]==7);
+   }
+   SPLIT_CHECK_ERR(split_gpuEventDestroy(copied));
+   SPLIT_CHECK_ERR(split_gpuStreamDestroy(s));
+}
+
+TEST(Vector_Functionality , Host_Copy_If){
+   //Compaction keeps the input order under every execution policy
+   const size_t n=1<<16;
+   vec a(n);
+   for (size_t i=0; i<n; ++i){
+      a[i]=(i*7919)%n;
+   }
+   auto isEven=[](const int& x){return x%2==0;};
+   for (auto policy : {split::execution_policy::serial,split::execution_policy::parallel,split::execution_policy::adaptive}){
+      vec b;
+      split::tools::copy_if<int>(a,b,isEven,policy);
+      stdvec reference;
+      std::copy_if(a.begin(),a.end(),std::back_inserter(reference),isEven);
+      expect_true(b.size()==reference.size());
+      for (size_t i=0; i<b.size(); ++i){
+         expect_true(b[i]==reference[i]);
+      }
+      vec c(n);
+      expect_true(split::tools::copy_if<int>(a.data(),c.data(),a.size(),isEven,policy)==reference.size());
+      expect_true(std::equal(reference.begin(),reference.end(),c.begin()));
+   }
+}
+
+TEST(Vector_Functionality , Memory_Usage){
+   vec a(100);
+   a.reserve(300);
+   const split::MemoryUsage usage=a.memory_usage();
+   expect_true(usage.payload==100*sizeof(int));
+   expect_true(usage.slack==(a.capacity()-100)*sizeof(int));
+   expect_true(usage.overhead==2*sizeof(size_t));
+   expect_true(usage.total()==a.capacity()*sizeof(int)+2*sizeof(size_t));
+   vec b(std::move(a));
+   expect_true(a.memory_usage().total()==0);
+   expect_true(b.memory_usage().total()==usage.total());
+}
+
+TEST(Vector_Functionality , Tracking_Allocator){
+   using tracked=split::SplitVector<int,split::tracking_allocator<split::split_host_allocator<int>>>;
+   split::tracking::reset();
+   const split::tracking::AllocationStats before=split::tracking::snapshot();
+   {
+      tracked a(1000,7);
+      const split::tracking::AllocationStats during=split::tracking::snapshot();
+      // The elements plus the size and capacity words
+      expect_true(during.allocations-before.allocations==3);
+      expect_true(during.liveBytes-before.liveBytes==1000*sizeof(int)+2*sizeof(size_t));
+      expect_true(during.constructs-before.constructs==1000);
+      expect_true(during.sizeClasses[split::tracking::size_class(1000*sizeof(int))]>=1);
+      a.reserve(4000);
+      expect_true(a[999]==7);
+   }
+   const split::tracking::AllocationStats after=split::tracking::snapshot();
+   expect_true(after.liveBytes==before.liveBytes);
+   expect_true(after.deallocations-before.deallocations==after.allocations-before.allocations);
+   expect_true(after.freedBytes==after.allocatedBytes);
+   expect_true(after.peakBytes-before.liveBytes>=5000*sizeof(int)+2*sizeof(size_t));
+   expect_true(after.destroys-before.destroys==after.constructs-before.constructs);
+
+   split::tracking::sample_call_sites(1);
+   {
+      tracked b(10);
+   }
+   split::tracking::sample_call_sites(0);
+   const split::tracking::AllocationStats sampled=split::tracking::snapshot();
+   expect_true(sampled.sampleEvery==0);
+#ifdef SPLIT_TRACKING_BACKTRACE
+   expect_false(sampled.callSites.empty());
+   uint64_t sampledAllocations=0;
+   for (const auto& site:sampled.callSites){
+      expect_false(site.frames.empty());
+      sampledAllocations+=site.allocations;
+   }
+   expect_true(sampledAllocations==3);
+#endif
+   expect_false(sampled.to_string().empty());
+}
+
+TEST(Vector_Functionality , NonTrivial_Emplace_Erase){
+   split::SplitVector<std::string> a;
+   for (int i=0;i<8;i++){
+      a.push_back(std::string(32,'a'+i));
+   }
+   a.emplace(a.begin()+4,size_t(32),'z');
+   expect_true(a.size()==9);
+   expect_true(a[3]==std::string(32,'d'));
+   expect_true(a[4]==std::string(32,'z'));
+   expect_true(a[5]==std::string(32,'e'));
+   expect_true(a[8]==std::string(32,'h'));
+   a.erase(a.begin()+4);
+   expect_true(a.size()==8);
+   expect_true(a[4]==std::string(32,'e'));
+   a.erase(a.begin()+1,a.begin()+3);
+   expect_true(a.size()==6);
+   expect_true(a[0]==std::string(32,'a'));
+   expect_true(a[1]==std::string(32,'d'));
+   expect_true(a[5]==std::string(32,'h'));
+   a.emplace_back(size_t(32),'y');
+   expect_true(a.back()==std::string(32,'y'));
+}
 
 int main(int argc, char* argv[]){
    ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,191 @@
+#include <iostream>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#ifndef HASHINATOR_CPU_ONLY_MODE
+#define HASHINATOR_CPU_ONLY_MODE
+#endif
+#include "../../include/hashinator/hopscotch.h"
+#include <gtest/gtest.h>
+
+#define expect_true EXPECT_TRUE
+#define expect_false EXPECT_FALSE
+#define expect_eq EXPECT_EQ
+
+using namespace std::chrono;
+using namespace Hashinator;
+typedef uint32_t val_type;
+typedef Hopscotch<val_type,val_type> hopscotch;
+typedef Hopscotch<val_type,val_type,std::numeric_limits<val_type>::max(),HashFunctions::Fibonacci<val_type>,true> hopscotch_cached;
+
+template <class Fn, class ... Args>
+auto execute_and_time(const char* name,Fn fn, Args && ... args) ->bool{
+   std::chrono::time_point<std::chrono::_V2::system_clock, std::chrono::_V2::system_clock::duration> start,stop;
+   double total_time=0;
+   start = std::chrono::high_resolution_clock::now();
+   bool retval=fn(args...);
+   stop = std::chrono::high_resolution_clock::now();
+   auto duration = duration_cast<microseconds>(stop- start).count();
+   total_time+=duration;
+   std::cout<<name<<" took "<<total_time<<" us"<<std::endl;
+   return retval;
+}
+
+std::vector<val_type> unique_keys(size_t size,std::mt19937& gen){
+   std::uniform_int_distribution<val_type> dist(1, std::numeric_limits<val_type>::max()-2);
+   std::unordered_map<val_type,bool> seen;
+   std::vector<val_type> keys;
+   while (keys.size()<size){
+      val_type key=dist(gen);
+      if (!seen.count(key)){
+         seen[key]=true;
+         keys.push_back(key);
+      }
+   }
+   return keys;
+}
+
+bool test_batch(val_type power){
+   std::mt19937 gen(power);
+   const size_t N = 0.9*(1<<power);
+   std::vector<val_type> keys=unique_keys(2*N,gen);
+   std::vector<val_type> vals(N);
+   for (size_t i=0; i<N; ++i){
+      vals[i]=keys[i]/2;
+   }
+   hopscotch hmap(power);
+   hmap.insert(keys.data(),vals.data(),N,0.95);
+   if (hmap.size()!=N){
+      return false;
+   }
+   std::vector<val_type> out(N,0);
+   hmap.retrieve(keys.data(),out.data(),N);
+   if (out!=vals){
+      return false;
+   }
+   //Misses leave the output untouched
+   std::vector<val_type> missing(N,42);
+   hmap.retrieve(keys.data()+N,missing.data(),N);
+   for (auto v:missing){
+      if (v!=42){
+         return false;
+      }
+   }
+   hmap.erase(keys.data(),N/2);
+   if (hmap.size()!=N-N/2){
+      return false;
+   }
+   for (size_t i=0; i<N; ++i){
+      if (hmap.count(keys[i])!=(i>=N/2)){
+         return false;
+      }
+   }
+   return true;
+}
+
+template <class Map>
+bool test_random_ops(val_type power){
+   std::mt19937 gen(power);
+   const size_t N = 0.85*(1<<power);
+   std::vector<val_type> keys=unique_keys(N,gen);
+   std::unordered_map<val_type,val_type> reference;
+   Map hmap(power);
+   for (size_t i=0; i<4*N; ++i){
+      val_type key=keys[gen()%N];
+      if (gen()%3==0){
+         if (hmap.erase(key)!=reference.erase(key)){
+            return false;
+         }
+      }else{
+         hmap[key]=i;
+         reference[key]=i;
+      }
+   }
+   if (hmap.size()!=reference.size()){
+      return false;
+   }
+   for (auto key:keys){
+      const val_type* val=hmap.find(key);
+      if (reference.count(key)){
+         if (val==nullptr || *val!=reference[key]){
+            return false;
+         }
+      }else if (val!=nullptr){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HopscotchUnitTests , Batch_Insert_Retrieve_Erase){
+   for (int power=8; power<20; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_batch ,power);
+      expect_true(retval);
+   }
+}
+
+TEST(HopscotchUnitTests , Random_Operations){
+   for (int power=8; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_random_ops<hopscotch> ,power);
+      expect_true(retval);
+   }
+}
+
+TEST(HopscotchUnitTests , Random_Operations_Cached_Hashes){
+   for (int power=8; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_random_ops<hopscotch_cached> ,power);
+      expect_true(retval);
+   }
+}
+
+TEST(HopscotchUnitTests , Growth){
+   hopscotch hmap(4);
+   for (val_type i=1; i<100000; ++i){
+      hmap[i]=i*2;
+   }
+   expect_eq(hmap.size(),99999u);
+   for (val_type i=1; i<100000; ++i){
+      expect_eq(hmap.at(i),i*2);
+   }
+   expect_eq(hmap.count(0),0u);
+}
+
+TEST(HopscotchUnitTests , Arbitrary_Capacity){
+   for (size_t capacity : {33ul, 1000ul, 3001ul, 100003ul}){
+      hopscotch hmap;
+      hmap.resize(capacity);
+      expect_eq(hmap.bucket_count(),capacity);
+      std::mt19937 gen(capacity);
+      const size_t N = 0.85*capacity;
+      std::vector<val_type> keys=unique_keys(N,gen);
+      for (auto key:keys){
+         hmap[key]=key/2;
+      }
+      expect_eq(hmap.size(),N);
+      for (auto key:keys){
+         expect_eq(hmap.at(key),key/2);
+      }
+   }
+}
+
+TEST(HopscotchUnitTests , Batch_Sizing){
+   //2^16+1 elements would need 2^18 buckets at load factor 0.5 with power of two capacities
+   std::mt19937 gen(16);
+   const size_t N = (1<<16)+1;
+   std::vector<val_type> keys=unique_keys(N,gen);
+   hopscotch hmap;
+   hmap.insert(keys.data(),keys.data(),N,0.5);
+   expect_true(hmap.bucket_count()>=2*N);
+   expect_true(hmap.bucket_count()<(1<<18));
+   expect_eq(hmap.size(),N);
+}
+
+int main(int argc, char* argv[]){
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -1,7 +1,16 @@
 #include <iostream>
 #include <stdlib.h>
+#include <atomic>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
 #include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include "../../include/hashinator/hashinator.h"
 #include <gtest/gtest.h>
 
@@ -83,6 +92,1259 @@ TEST(HashmapUnitTets , Host_Device_Insert_Delete_Global_Tets){
    }
 }
 
+bool test_graveyard_churn(val_type power){
+   const size_t N = 0.9 * (1<<power);
+   std::mt19937 gen(power);
+   std::uniform_int_distribution<val_type> dist(1, std::numeric_limits<val_type>::max()-2);
+   std::unordered_map<val_type,val_type> reference;
+   std::vector<val_type> live;
+   hashmap hmap(power);
+   hmap.set_rehash_policy(rehash_policy::graveyard);
+   auto add = [&](){
+      val_type key=dist(gen);
+      while (reference.count(key)){key=dist(gen);}
+      reference[key]=key/2;
+      live.push_back(key);
+      hmap[key]=key/2;
+   };
+   for (size_t i=0; i<N; ++i){
+      add();
+   }
+   //Churn at a constant load factor
+   for (size_t i=0; i<4*N; ++i){
+      size_t victim=gen()%live.size();
+      hmap.erase(live[victim]);
+      reference.erase(live[victim]);
+      live[victim]=live.back();
+      live.pop_back();
+      add();
+   }
+   if (hmap.size()!=reference.size() || hmap.getSizePower()!=(int)power){
+      return false;
+   }
+   for (const auto& kval:reference){
+      auto it=hmap.find(kval.first);
+      if (it==hmap.end() || it->second!=kval.second){
+         return false;
+      }
+   }
+   return hmap.tombstone_count()>0;
+}
+
+TEST(HashmapUnitTets , Graveyard_Churn){
+   for (int power=8; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_graveyard_churn ,power);
+      expect_true(retval);
+   }
+}
+
+bool test_ordered_probing(val_type power){
+   const size_t N = 0.85 * (1<<power);
+   std::mt19937 gen(power);
+   std::uniform_int_distribution<val_type> dist(1, std::numeric_limits<val_type>::max()-2);
+   std::unordered_map<val_type,val_type> reference;
+   std::vector<val_type> live;
+   hashmap hmap(power);
+   hmap.set_insertion_policy(insertion_policy::ordered);
+   for (size_t i=0; i<N; ++i){
+      val_type key=dist(gen);
+      reference[key]=key/2;
+      live.push_back(key);
+      hmap[key]=key/2;
+   }
+   //Erase and reinsert at random
+   for (size_t i=0; i<2*N; ++i){
+      val_type key=live[gen()%live.size()];
+      if (gen()%2){
+         if (hmap.erase(key)!=reference.erase(key)){
+            return false;
+         }
+      }else{
+         reference[key]=key/2;
+         hmap[key]=key/2;
+      }
+   }
+   if (hmap.size()!=reference.size() || hmap.tombstone_count()!=0){
+      return false;
+   }
+   size_t visited=0;
+   for (auto it=hmap.begin(); it!=hmap.end(); ++it){
+      visited++;
+   }
+   if (visited!=reference.size()){
+      return false;
+   }
+   for (auto key:live){
+      auto it=hmap.find(key);
+      if (reference.count(key)){
+         if (it==hmap.end() || it->second!=reference[key]){
+            return false;
+         }
+      }else if (it!=hmap.end()){
+         return false;
+      }
+   }
+   //Negative lookups
+   for (size_t i=0; i<N; ++i){
+      val_type key=dist(gen);
+      if ((hmap.find(key)==hmap.end())==(reference.count(key)==1)){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HashmapUnitTets , Ordered_Probing){
+   for (int power=8; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_ordered_probing ,power);
+      expect_true(retval);
+   }
+}
+
+bool test_ordered_batches(val_type power){
+   //Batch calls on an ordered table must keep every key findable and never duplicate one
+   const size_t N = 0.9 * (1<<power);
+   std::mt19937 gen(power);
+   std::uniform_int_distribution<val_type> dist(1, std::numeric_limits<val_type>::max()-2);
+   std::unordered_map<val_type,val_type> reference;
+   hashmap hmap(power);
+   hmap.set_insertion_policy(insertion_policy::ordered);
+   for (size_t i=0; i<0.7*N; ++i){
+      val_type key=dist(gen);
+      reference[key]=key/2;
+      hmap[key]=key/2;
+   }
+   std::vector<val_type> keys,vals;
+   while (reference.size()<N){
+      val_type key=dist(gen);
+      if (reference.count(key)==0){
+         reference[key]=key/3;
+         keys.push_back(key);
+         vals.push_back(key/3);
+      }
+   }
+   hmap.insert(keys.data(),vals.data(),keys.size(),0.9);
+   for (auto key:keys){
+      if (hmap.find(key)==hmap.end()){
+         return false;
+      }
+      hmap[key]=7;
+      reference[key]=7;
+   }
+   std::vector<val_type> erased(keys.begin(),keys.begin()+keys.size()/2);
+   hmap.erase(erased.data(),erased.size());
+   for (auto key:erased){
+      reference.erase(key);
+   }
+   if (hmap.size()!=reference.size() || hmap.tombstone_count()!=0){
+      return false;
+   }
+   size_t visited=0;
+   for (auto it=hmap.begin(); it!=hmap.end(); ++it){
+      auto ref=reference.find(it->first);
+      if (ref==reference.end() || ref->second!=it->second){
+         return false;
+      }
+      visited++;
+   }
+   return visited==reference.size();
+}
+
+TEST(HashmapUnitTets , Ordered_Batches){
+   for (int power=8; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_ordered_batches ,power));
+   }
+}
+
+bool test_ordered_warps(val_type power){
+   //The warp accessors do not keep the ordering, lookups must still see every key afterwards
+   const size_t N = 0.8 * (1<<power);
+   std::mt19937 gen(power);
+   std::uniform_int_distribution<val_type> dist(1, std::numeric_limits<val_type>::max()-2);
+   std::unordered_map<val_type,val_type> reference;
+   hashmap hmap(power+1);
+   hmap.set_insertion_policy(insertion_policy::ordered);
+   for (size_t i=0; i<N/2; ++i){
+      val_type key=dist(gen);
+      reference[key]=key/2;
+      hmap[key]=key/2;
+   }
+   std::vector<val_type> keys;
+   while (reference.size()<N){
+      val_type key=dist(gen);
+      if (reference.count(key)==0){
+         reference[key]=key/3;
+         keys.push_back(key);
+         hmap.warpInsert(key,key/3);
+      }
+   }
+   for (size_t i=0; i<keys.size(); i+=3){
+      hmap.warpErase(keys[i]);
+      reference.erase(keys[i]);
+   }
+   const hashmap& constMap=hmap;
+   for (auto key:keys){
+      if ((constMap.find(key)==constMap.end())==(reference.count(key)==1)){
+         return false;
+      }
+   }
+   //The next host insertion rebuilds the ordered layout
+   for (auto key:keys){
+      hmap[key]=7;
+      reference[key]=7;
+   }
+   if (hmap.size()!=reference.size() || hmap.tombstone_count()!=0){
+      return false;
+   }
+   for (auto& kval:reference){
+      auto it=hmap.find(kval.first);
+      if (it==hmap.end() || it->second!=kval.second){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HashmapUnitTets , Ordered_Warps){
+   for (int power=8; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_ordered_warps ,power));
+   }
+}
+
+bool test_overflow_stash(val_type power){
+   hashmap hmap(power);
+   //Keys that all share the first bucket
+   std::vector<val_type> keys;
+   for (val_type key=1; keys.size()<Hashinator::defaults::BUCKET_OVERFLOW+Hashinator::defaults::STASH_SIZE; ++key){
+      if ((hmap.hash(key)&(hmap.bucket_count()-1))==0){
+         keys.push_back(key);
+      }
+   }
+   for (auto key:keys){
+      hmap[key]=key/2;
+   }
+   //The window is full so the rest waits in the stash without growing the table
+   if (hmap.getSizePower()!=(int)power || hmap.stash_size()!=Hashinator::defaults::STASH_SIZE || hmap.size()!=keys.size()){
+      return false;
+   }
+   for (auto key:keys){
+      auto it=hmap.find(key);
+      if (it==hmap.end() || it->second!=key/2){
+         return false;
+      }
+   }
+   if (hmap.stash_hits()<Hashinator::defaults::STASH_SIZE){
+      return false;
+   }
+   size_t visited=0;
+   for (auto it=hmap.begin(); it!=hmap.end(); ++it){
+      visited++;
+   }
+   if (visited!=keys.size()){
+      return false;
+   }
+   //Iterators into the stash compare by position
+   auto last=hmap.find(keys.back());
+   if (last==hmap.end() || last==hmap.find(keys[keys.size()-2]) || last!=hmap.find(keys.back())){
+      return false;
+   }
+   //Erasing stashed elements keeps the rest reachable
+   hmap.erase(keys.back());
+   keys.pop_back();
+   if (hmap.stash_size()!=Hashinator::defaults::STASH_SIZE-1 || hmap.count(keys.back())!=1){
+      return false;
+   }
+   //Filling the stash forces the rehash
+   val_type key=keys.back()+1;
+   while (hmap.getSizePower()==(int)power){
+      if ((hmap.hash(++key)&(hmap.bucket_count()-1))==0){
+         hmap[key]=key/2;
+         keys.push_back(key);
+      }
+   }
+   for (auto key:keys){
+      if (hmap.at(key)!=key/2){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HashmapUnitTets , Overflow_Stash){
+   for (int power=10; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_overflow_stash ,power);
+      expect_true(retval);
+   }
+}
+
+bool test_hashed_api(val_type power){
+   //Batched hashes match the scalar hash for every length, including the scalar tail
+   {
+      std::vector<val_type> keys(67);
+      std::vector<uint64_t> keys64(keys.size());
+      for (size_t i=0; i<keys.size(); ++i){
+         keys[i]=rand();
+         keys64[i]=((uint64_t)rand()<<32)|rand();
+      }
+      Hashmap<uint64_t,val_type> hmap64(power);
+      hashmap check(power);
+      for (size_t len=0; len<=keys.size(); ++len){
+         std::vector<uint32_t> hashes(len),hashes64(len);
+         check.hash_batch(keys.data(),hashes.data(),len);
+         hmap64.hash_batch(keys64.data(),hashes64.data(),len);
+         for (size_t i=0; i<len; ++i){
+            if (hashes[i]!=check.hash(keys[i]) || hashes64[i]!=hmap64.hash(keys64[i])){
+               return false;
+            }
+         }
+      }
+   }
+   //Hashes are kept in sync while the table grows under insert_hashed
+   size_t N = 1<<power;
+   std::vector<val_type> keys(N),vals(N,0);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+   }
+   hashmap hmap(4);
+   std::vector<uint32_t> hashes(N);
+   hmap.hash_batch(keys.data(),hashes.data(),N);
+   hmap.insert_hashed(keys.data(),keys.data(),hashes.data(),N);
+   if (hmap.size()!=N || hmap.getSizePower()<=4){
+      return false;
+   }
+   for (size_t i=0; i<N; ++i){
+      if (hashes[i]!=hmap.hash(keys[i])){
+         return false;
+      }
+      auto it=hmap.find_hashed(keys[i],hashes[i]);
+      if (it==hmap.end() || it->second!=keys[i]){
+         return false;
+      }
+   }
+   hmap.retrieve_hashed(keys.data(),hashes.data(),vals.data(),N);
+   if (vals!=keys){
+      return false;
+   }
+   //Erase every other key and check the rest through the regular interface
+   if (hmap.erase_hashed(keys[0],hashes[0])!=1 || hmap.erase_hashed(keys[0],hashes[0])!=0){
+      return false;
+   }
+   std::vector<val_type> erased;
+   std::vector<uint32_t> erasedHashes;
+   for (size_t i=2; i<N; i+=2){
+      erased.push_back(keys[i]);
+      erasedHashes.push_back(hashes[i]);
+   }
+   hmap.erase_hashed(erased.data(),erasedHashes.data(),erased.size());
+   for (size_t i=0; i<N; ++i){
+      if (hmap.count(keys[i])!=i%2){
+         return false;
+      }
+   }
+   //Missing keys are left untouched
+   std::vector<val_type> erasedVals(erased.size(),0);
+   hmap.retrieve_hashed(erased.data(),erasedHashes.data(),erasedVals.data(),erased.size());
+   for (auto v:erasedVals){
+      if (v!=0){
+         return false;
+      }
+   }
+   return hmap.insert_hashed(keys[0],1,hmap.hash(keys[0])) && !hmap.insert_hashed(keys[0],2,hmap.hash(keys[0])) && hmap.at(keys[0])==2;
+}
+
+TEST(HashmapUnitTets , Hashed_API){
+   for (int power=10; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      bool retval = execute_and_time(name.c_str(),test_hashed_api ,power);
+      expect_true(retval);
+   }
+}
+
+template <typename KEY>
+bool test_probe_churn(val_type power){
+   //Random insert/erase/find against std::unordered_map, for every key width the vectorized probe handles
+   std::mt19937_64 gen(power);
+   Hashmap<KEY,KEY> hmap(power);
+   std::unordered_map<KEY,KEY> reference;
+   const KEY range = 1<<power;
+   for (size_t i=0; i<(size_t)(16<<power); ++i){
+      KEY key = 1+gen()%range;
+      switch (gen()%3){
+         case 0:
+            hmap[key]=key/2;
+            reference[key]=key/2;
+            break;
+         case 1:
+            hmap.erase(key);
+            reference.erase(key);
+            break;
+         default:
+            auto it=hmap.find(key);
+            auto ref=reference.find(key);
+            if ((it==hmap.end())!=(ref==reference.end()) || (it!=hmap.end() && it->second!=ref->second)){
+               return false;
+            }
+      }
+   }
+   return hmap.size()==reference.size();
+}
+
+TEST(HashmapUnitTets , Probe_Churn){
+   for (int power=6; power<14; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_probe_churn<uint32_t> ,power));
+      expect_true(execute_and_time(name.c_str(),test_probe_churn<uint64_t> ,power));
+   }
+}
+
+template <typename KEY>
+bool test_batch_retrieve(val_type power){
+   //Batched retrieval must agree with find(), including chunk boundaries and keys missing from the table
+   std::mt19937_64 gen(power);
+   Hashmap<KEY,KEY> hmap(power);
+   const size_t N = 1<<power;
+   const KEY untouched=std::numeric_limits<KEY>::max();
+   //Managed buffers so that the GPU build can retrieve on the device
+   split::SplitVector<KEY> keys(N+N/3+7),vals(keys.size(),untouched);
+   for (size_t i=0; i<keys.size(); ++i){
+      keys[i]=1+gen()%(4*N);
+   }
+   for (size_t i=0; i<N; ++i){
+      hmap[keys[i]]=keys[i]/2;
+   }
+   for (size_t i=0; i<N/4; ++i){
+      hmap.erase(keys[gen()%N]);
+   }
+   std::vector<bool> present(keys.size());
+   for (size_t i=0; i<keys.size(); ++i){
+      present[i]=hmap.find(keys[i])!=hmap.end();
+   }
+   hmap.optimizeGPU();
+   keys.optimizeGPU();
+   vals.optimizeGPU();
+   hmap.retrieve(keys.data(),vals.data(),keys.size());
+   SPLIT_CHECK_ERR(split_gpuDeviceSynchronize());
+   hmap.optimizeCPU();
+   keys.optimizeCPU();
+   vals.optimizeCPU();
+   SPLIT_CHECK_ERR(split_gpuDeviceSynchronize());
+   for (size_t i=0; i<keys.size(); ++i){
+      //Missing keys are neither created nor written to
+      if (vals[i]!=(present[i]?keys[i]/2:untouched) || (hmap.find(keys[i])!=hmap.end())!=present[i]){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HashmapUnitTets , Batch_Retrieve){
+   for (int power=4; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_batch_retrieve<uint32_t> ,power));
+      expect_true(execute_and_time(name.c_str(),test_batch_retrieve<uint64_t> ,power));
+   }
+}
+
+#ifdef HASHINATOR_CPU_ONLY_MODE
+template <int elementsPerWarp>
+bool test_host_virtual_warps(val_type power){
+   //The warp accessors must agree with the regular host interface for every virtual warp size
+   const size_t N = 1<<power;
+   hashmap hmap(power+1);
+   std::vector<std::thread> workers;
+   const size_t nThreads=4;
+   for (size_t t=0; t<nThreads; ++t){
+      workers.emplace_back([&hmap,N,t](){
+         for (size_t i=t; i<N; i+=nThreads){
+            hmap.warpInsert<false,elementsPerWarp>(i+1,i);
+         }
+      });
+   }
+   for (auto& w:workers){
+      w.join();
+   }
+   if (hmap.size()!=N){
+      return false;
+   }
+   for (size_t i=0; i<N; ++i){
+      val_type val=0;
+      hmap.warpFind<elementsPerWarp>(i+1,val);
+      auto it=hmap.find(i+1);
+      if (val!=i || it==hmap.end() || it->second!=i){
+         return false;
+      }
+   }
+   //Duplicates overwrite unless asked not to
+   if (hmap.warpInsert_V<false,elementsPerWarp>(1,42) || hmap.warpInsert_V<true,elementsPerWarp>(1,7) || hmap.at(1)!=42){
+      return false;
+   }
+   for (size_t i=0; i<N; i+=2){
+      hmap.warpErase<elementsPerWarp>(i+1);
+   }
+   val_type missing=1234;
+   hmap.warpFind<elementsPerWarp>(1,missing);
+   if (missing!=1234 || hmap.size()!=N/2){
+      return false;
+   }
+   for (size_t i=0; i<N; ++i){
+      if (hmap.count(i+1)!=i%2){
+         return false;
+      }
+   }
+   return true;
+}
+
+TEST(HashmapUnitTets , Host_Virtual_Warps){
+   for (int power=10; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_host_virtual_warps<1> ,power));
+      expect_true(execute_and_time(name.c_str(),test_host_virtual_warps<4> ,power));
+      expect_true(execute_and_time(name.c_str(),test_host_virtual_warps<32> ,power));
+   }
+}
+
+template <int elementsPerWarp>
+bool test_host_hasher(val_type power){
+   //The batch calls run on the host thread pool through the HostHasher and must agree with std::unordered_map
+   using hasher=Hashers::HostHasher<val_type,val_type,HashFunctions::Fibonacci<val_type>,
+                                    std::numeric_limits<val_type>::max(),std::numeric_limits<val_type>::max()-1,
+                                    defaults::WARPSIZE,elementsPerWarp>;
+   using map=Hashmap<val_type,val_type,std::numeric_limits<val_type>::max(),std::numeric_limits<val_type>::max()-1,
+                     HashFunctions::Fibonacci<val_type>,hasher>;
+   const size_t N = 1<<power;
+   std::mt19937 gen(power);
+   std::unordered_map<val_type,val_type> reference;
+   std::vector<val_type> keys(N),vals(N);
+   for (size_t i=0; i<N; ++i){
+      //Duplicates on purpose
+      keys[i]=1+gen()%(2*N);
+      vals[i]=gen()%1000;
+      reference[keys[i]]=vals[i];
+   }
+   map hmap(4);
+   hmap.insert(keys.data(),vals.data(),N/2);
+   hmap.insert(keys.data()+N/2,vals.data()+N/2,N-N/2);
+   //Keep the duplicate that won the race in the reference
+   for (auto& kval:reference){
+      kval.second=hmap.at(kval.first);
+   }
+   if (hmap.size()!=reference.size()){
+      return false;
+   }
+   std::vector<val_type> erased(keys.begin(),keys.begin()+N/4);
+   hmap.erase(erased.data(),erased.size());
+   for (auto key:erased){
+      reference.erase(key);
+   }
+   if (hmap.size()!=reference.size() || hmap.tombstone_count()==0){
+      return false;
+   }
+   std::vector<val_type> out(N,std::numeric_limits<val_type>::max());
+   hmap.retrieve(keys.data(),out.data(),N);
+   for (size_t i=0; i<N; ++i){
+      auto ref=reference.find(keys[i]);
+      if (out[i]!=(ref==reference.end()?std::numeric_limits<val_type>::max():ref->second)){
+         return false;
+      }
+   }
+   map indexed(4);
+   std::vector<val_type> unique;
+   for (auto& kval:reference){
+      unique.push_back(kval.first);
+   }
+   indexed.insertIndex(unique.data(),unique.size());
+   for (size_t i=0; i<unique.size(); ++i){
+      if (indexed.at(unique[i])!=i){
+         return false;
+      }
+   }
+   return indexed.size()==unique.size();
+}
+
+TEST(HashmapUnitTets , Host_Hasher){
+   for (int power=8; power<20; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_host_hasher<1> ,power));
+      expect_true(execute_and_time(name.c_str(),test_host_hasher<8> ,power));
+      expect_true(execute_and_time(name.c_str(),test_host_hasher<32> ,power));
+   }
+}
+
+bool test_float_values(val_type power){
+   //Values are only stored, never compared and swapped, so any value type works on the host
+   const size_t N = 1<<power;
+   std::vector<val_type> keys(N);
+   std::vector<float> vals(N);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+      vals[i]=0.5f*i;
+   }
+   bool ok=true;
+   for (auto policy : {split::execution_policy::serial,split::execution_policy::parallel}){
+      Hashmap<val_type,float> hmap;
+      std::vector<float> out(N,-1.0f);
+      hmap.insert(keys.data(),vals.data(),N,0.5,0,policy);
+      hmap.retrieve(keys.data(),out.data(),N,0,policy);
+      for (size_t i=0; i<N; ++i){
+         ok = ok && out[i]==vals[i];
+      }
+      Hashmap<val_type,float> indexed;
+      indexed.insertIndex(keys.data(),N,0.5,0,policy);
+      ok = ok && indexed.size()==N && indexed.at(keys[N-1])==float(N-1);
+   }
+   Hashmap<val_type,float> warps(power+1);
+   for (size_t i=0; i<N; ++i){
+      warps.warpInsert(keys[i],vals[i]);
+   }
+   float val=-1.0f;
+   warps.warpFind(keys[N/2],val);
+   return ok && warps.size()==N && val==vals[N/2];
+}
+
+TEST(HashmapUnitTets , Float_Values){
+   for (int power=8; power<16; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_float_values ,power));
+   }
+}
+
+bool test_host_streams(val_type power){
+   //Batches on a stream run in order and asynchronously, events order work across streams
+   const size_t N = 1<<power;
+   split_gpuStream_t s[2];
+   split_gpuEvent_t inserted;
+   SPLIT_CHECK_ERR(split_gpuStreamCreate(&s[0]));
+   SPLIT_CHECK_ERR(split_gpuStreamCreate(&s[1]));
+   SPLIT_CHECK_ERR(split_gpuEventCreate(&inserted));
+   std::vector<val_type> keys(N),vals(N),outA(N,0),outB(N,0),copy(N,0);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+      vals[i]=2*i;
+   }
+   hashmap a,b;
+   std::atomic<bool> go{false};
+   split::host_launch(s[0],[&go](){
+      while (!go){
+         std::this_thread::yield();
+      }
+   });
+   a.insert(keys.data(),vals.data(),N,0.5,s[0]);
+   SPLIT_CHECK_ERR(split_gpuEventRecord(inserted,s[0]));
+   a.erase(keys.data(),N/2,s[0]);
+   a.retrieve(keys.data(),outA.data(),N,s[0]);
+   //b only starts once a has been filled
+   SPLIT_CHECK_ERR(split_gpuStreamWaitEvent(s[1],inserted,0));
+   b.insert(keys.data(),vals.data(),N,0.5,s[1]);
+   b.retrieve(keys.data(),outB.data(),N,s[1]);
+   SPLIT_CHECK_ERR(split_gpuMemcpyAsync(copy.data(),outB.data(),N*sizeof(val_type),split_gpuMemcpyDeviceToHost,s[1]));
+   //Nothing may have run while s[0] is held back
+   bool ok = split_gpuStreamQuery(s[0])==split_gpuErrorNotReady && split_gpuEventQuery(inserted)==split_gpuErrorNotReady &&
+             a.size()==0 && b.size()==0;
+   go=true;
+   SPLIT_CHECK_ERR(split_gpuDeviceSynchronize());
+   ok = ok && a.size()==N-N/2 && b.size()==N;
+   for (size_t i=0; i<N; ++i){
+      ok = ok && outA[i]==(i<N/2?0:vals[i]) && outB[i]==vals[i] && copy[i]==vals[i];
+   }
+   SPLIT_CHECK_ERR(split_gpuEventDestroy(inserted));
+   SPLIT_CHECK_ERR(split_gpuStreamDestroy(s[0]));
+   SPLIT_CHECK_ERR(split_gpuStreamDestroy(s[1]));
+   return ok;
+}
+
+TEST(HashmapUnitTets , Host_Streams){
+   for (int power=8; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_host_streams ,power));
+   }
+}
+
+bool test_work_stealing(val_type power){
+   //Every chunk runs exactly once even when the first thread's chunks are much slower
+   const size_t N = 1<<power;
+   split::ThreadPool pool(4);
+   std::vector<std::atomic<int>> visits(N);
+   pool.parallel_for(N,16,[&](size_t begin, size_t end){
+      if (begin<N/4){
+         std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+      for (size_t i=begin; i<end; ++i){
+         visits[i]++;
+      }
+   });
+   for (size_t i=0; i<N; ++i){
+      if (visits[i]!=1){
+         return false;
+      }
+   }
+   //Limiting the active threads keeps the others out of the next jobs
+   pool.set_active_threads(2);
+   std::mutex lock;
+   std::set<std::thread::id> ids;
+   pool.parallel_for(N,16,[&](size_t begin, size_t end){
+      std::this_thread::sleep_for(std::chrono::microseconds(5));
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         ids.insert(std::this_thread::get_id());
+      }
+      for (size_t i=begin; i<end; ++i){
+         visits[i]++;
+      }
+   });
+   if (pool.active_threads()!=2 || ids.size()>2){
+      return false;
+   }
+   pool.set_active_threads(100);
+   for (size_t i=0; i<N; ++i){
+      if (visits[i]!=2){
+         return false;
+      }
+   }
+   return pool.active_threads()==pool.size();
+}
+
+bool test_execution_policies(val_type power){
+   //Every policy must leave the map in the same state
+   const size_t N = 1<<power;
+   std::vector<val_type> keys(N),vals(N);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+      vals[i]=3*i;
+   }
+   bool ok=true;
+   for (auto policy : {split::execution_policy::serial,split::execution_policy::parallel,split::execution_policy::adaptive}){
+      hashmap hmap;
+      std::vector<val_type> out(N,0);
+      hmap.insert(keys.data(),vals.data(),N,0.5,0,policy);
+      hmap.erase(keys.data(),N/4,0,policy);
+      hmap.rehash(hmap.getSizePower()+1,policy);
+      hmap.retrieve(keys.data(),out.data(),N,0,policy);
+      for (size_t i=0; i<N; ++i){
+         ok = ok && out[i]==(i<N/4?0:vals[i]);
+      }
+      split::SplitVector<val_type> all;
+      ok = ok && hmap.extractAllKeys(all,0,policy)==N-N/4 && hmap.size()==N-N/4;
+      //Extraction keeps the bucket order, whatever the policy
+      size_t i=0;
+      for (const auto& e : hmap){
+         ok = ok && i<all.size() && all[i++]==e.first;
+      }
+      vector odd;
+      const val_type empty=hmap.get_emptybucket(), tomb=hmap.get_tombstone();
+      auto isOdd=[empty,tomb](const hash_pair<val_type,val_type>& e){return e.first!=empty && e.first!=tomb && e.first%2==1;};
+      ok = ok && hmap.extractPattern(odd,isOdd,0,policy)==(N-N/4)/2;
+      for (const auto& e : odd){
+         ok = ok && e.first%2==1 && e.second==3*(e.first-1);
+      }
+   }
+   return ok;
+}
+
+TEST(HashmapUnitTets , Execution_Policies){
+   for (int power=8; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_work_stealing ,power));
+      expect_true(execute_and_time(name.c_str(),test_execution_policies ,power));
+   }
+}
+
+bool test_automatic_targets(val_type power){
+   //targets::automatic follows the thresholds and gives the same results as any other path
+   const size_t N = 1<<power;
+   std::vector<val_type> keys(N),vals(N),out(N,0);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+      vals[i]=5*i;
+   }
+   hashmap hmap;
+   hmap.insert(keys.data(),vals.data(),N,0.5,0,targets::automatic);
+   hmap.erase(keys.data(),N/2,0,targets::automatic);
+   hmap.resize(hmap.getSizePower()+1,targets::automatic);
+   hmap.retrieve(keys.data(),out.data(),N,0,targets::automatic);
+   bool ok = hmap.size()==N-N/2;
+   for (size_t i=0; i<N; ++i){
+      ok = ok && out[i]==(i<N/2?0:vals[i]);
+   }
+   split::SplitVector<val_type> all;
+   return ok && hmap.extractAllKeys(all,0,targets::automatic)==N-N/2;
+}
+
+TEST(HashmapUnitTets , Automatic_Targets){
+   //Calibration results survive a round trip through the cache file
+   const std::string path=(std::filesystem::temp_directory_path()/"hashinator_thresholds_test").string();
+   Thresholds measured=Calibration::measure();
+   expect_true(Calibration::store(path,measured));
+   Thresholds loaded;
+   expect_true(Calibration::load(path,loaded));
+   expect_true(loaded.simdBatch==measured.simdBatch && loaded.threadedBatch==measured.threadedBatch &&
+               loaded.threadedInsert==measured.threadedInsert && loaded.threadedErase==measured.threadedErase &&
+               loaded.threadedTable==measured.threadedTable && loaded.deviceBuckets==measured.deviceBuckets);
+   if (split::host_concurrency()==1){
+      const size_t never=std::numeric_limits<size_t>::max();
+      expect_true(measured.threadedBatch==never && measured.threadedInsert==never &&
+                  measured.threadedErase==never && measured.threadedTable==never);
+   }
+   //A cache from another setup is ignored
+   {
+      std::ofstream stale(path);
+      stale<<"signature host-threads0-lanes0\nsimdBatch 1\nthreadedBatch 1\nthreadedInsert 1\nthreadedErase 1\n"
+           <<"threadedTable 1\ndeviceBuckets 1\n";
+   }
+   expect_false(Calibration::load(path,loaded));
+   std::filesystem::remove(path);
+
+   Thresholds t;
+   t.simdBatch=128;
+   t.threadedBatch=1<<12;
+   t.threadedInsert=1<<14;
+   t.threadedErase=1<<10;
+   t.threadedTable=1<<16;
+   Calibration::set(t);
+   expect_true(Calibration::select(64)==host_path::serial);
+   expect_true(Calibration::select(128)==host_path::simd);
+   expect_true(Calibration::select(1<<12)==host_path::threaded);
+   //Every operation follows its own threshold and only lookups are vectorized
+   expect_true(Calibration::select(1<<12,host_op::insert)==host_path::serial);
+   expect_true(Calibration::select(1<<14,host_op::insert)==host_path::threaded);
+   expect_true(Calibration::select(1<<10,host_op::erase)==host_path::threaded);
+   expect_true(Calibration::select(1<<15,host_op::table)==host_path::serial);
+   expect_true(Calibration::select_target(1<<16)==targets::device);
+   expect_true(HostTarget(targets::automatic).execution(1<<12,host_op::insert)==split::execution_policy::serial);
+   expect_true(HostTarget(targets::automatic).execution(1<<12)==split::execution_policy::parallel);
+   expect_false(HostTarget(targets::automatic).vectorized(64));
+   expect_true(HostTarget(targets::host).execution(1<<20)==split::execution_policy::serial);
+   for (int power=4; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_automatic_targets ,power));
+   }
+}
+
+bool test_async_batches(val_type power){
+   //Outstanding batches on a map are applied in the order they were enqueued
+   const size_t N = 1<<power;
+   std::vector<val_type> keys(N),vals(N),newVals(N),out(N,0),after(N,0);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=i+1;
+      vals[i]=2*i;
+      newVals[i]=7*i;
+   }
+   hashmap hmap;
+   auto inserted=hmap.insert_async(keys.data(),vals.data(),N);
+   auto erased=hmap.erase_async(keys.data(),N/2);
+   auto read=hmap.retrieve_async(keys.data(),out.data(),N);
+   //Overwrites after the read must not show up in it
+   auto rewritten=hmap.insert_async(keys.data()+N/2,newVals.data()+N/2,N-N/2);
+   auto readAgain=hmap.retrieve_async(keys.data(),after.data(),N,split::execution_policy::parallel);
+   read.wait();
+   bool ok=true;
+   for (size_t i=0; i<N; ++i){
+      ok = ok && out[i]==(i<N/2?0:vals[i]);
+   }
+   hmap.wait_all();
+   for (auto* f : {&inserted,&erased,&rewritten,&readAgain}){
+      ok = ok && f->wait_for(std::chrono::seconds(0))==std::future_status::ready;
+   }
+   for (size_t i=0; i<N; ++i){
+      ok = ok && after[i]==(i<N/2?0:newVals[i]);
+   }
+   ok = ok && hmap.size()==N-N/2;
+   //Calls on async_stream() are ordered after the outstanding batches
+   hmap.erase_async(keys.data()+N/2,N/4);
+   std::fill(out.begin(),out.end(),0);
+   hmap.retrieve(keys.data(),out.data(),N,hmap.async_stream());
+   hmap.wait_all();
+   for (size_t i=0; i<N; ++i){
+      ok = ok && out[i]==((i<N/2+N/4)?0:newVals[i]);
+   }
+   //Moving a map waits for its batches
+   hmap.insert_async(keys.data(),vals.data(),N/2);
+   hashmap moved(std::move(hmap));
+   return ok && moved.size()==N-N/4;
+}
+
+bool test_metrics(val_type power){
+   //Scanning the buckets in parallel blocks gives the same metrics as a plain walk around the table
+   const size_t N = 1<<power;
+   std::vector<val_type> keys(N),vals(N);
+   for (size_t i=0; i<N; ++i){
+      keys[i]=rand();
+      vals[i]=i;
+   }
+   hashmap hmap;
+   hmap.insert(keys.data(),vals.data(),N,0.9);
+   hmap.erase(keys.data(),N/3);
+   Metrics serial=hmap.metrics(0,split::execution_policy::serial);
+   Metrics parallel=hmap.metrics(0,split::execution_policy::parallel);
+
+   const size_t n=hmap.bucket_count();
+   const hash_pair<val_type,val_type>* data=hmap.expose_bucketdata();
+   std::vector<size_t> probes,clusters,emptyRuns;
+   auto occupied=[&](size_t i){return data[i].first!=hmap.get_emptybucket();};
+   //Start the walk right after a change of kind, so no run is split by the end of the table
+   size_t start=0;
+   while (start<n && occupied(start)==occupied((start+n-1)%n)){
+      start++;
+   }
+   if (start==n){
+      (occupied(0)?clusters:emptyRuns).push_back(n);
+   } else {
+      size_t len=0;
+      for (size_t k=0; k<n; ++k){
+         const size_t i=(start+k)%n;
+         len++;
+         if (occupied(i)!=occupied((i+1)%n)){
+            (occupied(i)?clusters:emptyRuns).push_back(len);
+            len=0;
+         }
+      }
+   }
+   for (size_t i=0; i<n; ++i){
+      const val_type key=data[i].first;
+      if (key!=hmap.get_emptybucket() && key!=hmap.get_tombstone()){
+         const size_t d=(i-hmap.hash(key))&(n-1);
+         if (d>=probes.size()){probes.resize(d+1,0);}
+         probes[d]++;
+      }
+   }
+   bool ok = serial.probeHistogram==probes && parallel.probeHistogram==probes;
+   for (const Metrics& m : {serial,parallel}){
+      ok = ok && m.capacity==n && m.fill==hmap.size() && m.tombstones==hmap.tombstone_count();
+      ok = ok && m.bytes==hmap.memory_usage().total();
+      ok = ok && m.clusters==clusters.size() && m.maxProbe+1==probes.size();
+      ok = ok && m.maxCluster==(clusters.empty()?0:*std::max_element(clusters.begin(),clusters.end()));
+      ok = ok && m.maxEmptyRun==(emptyRuns.empty()?0:*std::max_element(emptyRuns.begin(),emptyRuns.end()));
+      size_t runs=0;
+      for (size_t r : m.emptyRuns){
+         runs+=r;
+      }
+      ok = ok && runs==emptyRuns.size();
+   }
+   ok = ok && serial.meanCluster==parallel.meanCluster && serial.meanProbe==parallel.meanProbe;
+   ok = ok && serial.emptyRuns==parallel.emptyRuns;
+   const std::string json=parallel.to_json();
+   ok = ok && json.front()=='{' && json.back()=='}';
+   ok = ok && json.find("\"capacity\":"+std::to_string(n)+",")!=std::string::npos;
+   return ok;
+}
+
+TEST(HashmapUnitTets , Metrics){
+   for (int power=4; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_metrics ,power));
+   }
+}
+
+TEST(HashmapUnitTets , Instrumentation){
+   //Counters are only compiled in with HASHINATOR_INSTRUMENT
+   using split::instrument::counter;
+   split::instrument::reset();
+   const size_t N = 1<<12;
+   {
+      hashmap hmap(4);
+      for (size_t i=0; i<N; ++i){
+         hmap[i+1]=i;
+      }
+      for (size_t i=0; i<N/2; ++i){
+         hmap.erase(i+1);
+      }
+      for (size_t i=0; i<N/2; ++i){
+         hmap[i+1]=i;
+      }
+      std::vector<val_type> keys(N),vals(N);
+      std::iota(keys.begin(),keys.end(),val_type(1));
+      std::thread worker([&](){hmap.retrieve(keys.data(),vals.data(),N);
+                               for (size_t i=0; i<N; ++i){hmap.find(i+1);}});
+      worker.join();
+   }
+   const auto c=split::instrument::snapshot();
+#ifdef SPLIT_INSTRUMENT
+   //Lookups of the thread that has already exited are kept
+   expect_true(split::instrument::get(c,counter::lookups)>=N+N/2+N);
+   expect_true(split::instrument::get(c,counter::probes)>=split::instrument::get(c,counter::lookups));
+   expect_true(split::instrument::get(c,counter::rehashes)>0 && split::instrument::get(c,counter::rehash_ns)>0);
+   expect_true(split::instrument::get(c,counter::cleanups)>=N/2);
+   expect_true(split::instrument::get(c,counter::tombstone_reuses)>0);
+   expect_true(split::instrument::get(c,counter::allocations)>0);
+   expect_true(split::instrument::get(c,counter::deallocations)>0);
+   split::instrument::reset();
+   expect_true(split::instrument::get(split::instrument::snapshot(),counter::lookups)==0);
+#else
+   for (auto v : c){
+      expect_true(v==0);
+   }
+#endif
+}
+
+TEST(HashmapUnitTets , Latency_Histograms){
+   //Every value lands in a bucket whose bounds are within 1/16 of it
+   for (uint64_t v : {0ul,1ul,15ul,16ul,17ul,1000ul,123456789ul}){
+      const size_t b=LatencyHistogram::bucket_of(v);
+      expect_true(LatencyHistogram::highest_in(b)>=v && LatencyHistogram::highest_in(b)-v<=v/16);
+      expect_true(b==0 || LatencyHistogram::highest_in(b-1)<v);
+   }
+   LatencyHistogram a,b;
+   for (uint64_t v=1; v<=1000; ++v){
+      a.record(v);
+      b.record(1000000+v);
+   }
+   expect_true(a.percentile(50)>=500 && a.percentile(50)<=500+500/16);
+   expect_true(a.percentile(100)==1000 && a.min()==1 && a.mean()==500.5);
+   a.merge(b);
+   expect_true(a.count()==2000 && a.max()==1001000);
+   expect_true(a.percentile(49)<=1000 && a.percentile(51)>=1000000);
+
+   //Recordings from several threads end up in one histogram per operation
+   hashmap hmap(4);
+   hmap.enable_latency_recording(1);
+   const size_t N = 1<<12;
+   std::vector<std::thread> threads;
+   std::mutex lock;
+   for (int t=0; t<4; ++t){
+      threads.emplace_back([&,t](){
+         for (size_t i=0; i<N; ++i){
+            std::lock_guard<std::mutex> guard(lock);
+            hmap[t*N+i+1]=i;
+         }
+      });
+   }
+   for (auto& t : threads){
+      t.join();
+   }
+   for (size_t i=0; i<N; ++i){
+      hmap[i+1]=0;
+      hmap.find(i+1);
+      hmap.find(8*N+i+1);
+   }
+   hmap.erase(1);
+   const LatencyRecorder* rec=hmap.latency();
+   expect_true(rec!=nullptr);
+   expect_true(rec->histogram(latency_op::insert_new).count()==4*N);
+   expect_true(rec->histogram(latency_op::insert_update).count()==N);
+   expect_true(rec->histogram(latency_op::find_hit).count()==N);
+   expect_true(rec->histogram(latency_op::find_miss).count()==N);
+   expect_true(rec->histogram(latency_op::erase).count()==1);
+   //Growing from 2^4 buckets took a few rehashes, each of them timed
+   expect_true(rec->histogram(latency_op::rehash).count()>=8);
+   expect_true(rec->histogram(latency_op::insert_new).max()>=rec->histogram(latency_op::rehash).min());
+
+   //Sampling keeps one in sample_every() operations per thread
+   hashmap sampled;
+   sampled.enable_latency_recording(100);
+   expect_true(sampled.latency()->sample_every()==128);
+   for (size_t i=0; i<N; ++i){
+      sampled.find(i);
+   }
+   const size_t kept=sampled.latency()->histogram(latency_op::find_miss).count();
+   expect_true(kept==N/128 || kept==N/128+1);
+   sampled.disable_latency_recording();
+   expect_true(sampled.latency()==nullptr);
+}
+
+TEST(HashmapUnitTets , Tracing){
+   //Ranges are only compiled in with HASHINATOR_TRACE
+   auto occurrences=[](const std::string& text,const std::string& what){
+      size_t n=0;
+      for (size_t at=text.find(what); at!=std::string::npos; at=text.find(what,at+1)){
+         n++;
+      }
+      return n;
+   };
+   split::trace::clear();
+   const size_t N = 1<<14;
+   {
+      hashmap hmap(4);
+      std::vector<val_type> keys(N);
+      std::vector<val_type> vals(N);
+      std::iota(keys.begin(),keys.end(),val_type(1));
+      hmap.insert(keys.data(),vals.data(),N,0.5,0,split::execution_policy::parallel);
+      for (size_t i=0; i<N/2; ++i){
+         hmap.erase(i+1);
+      }
+      std::thread worker([&](){
+         split::trace::set_thread_name("worker");
+         hmap.retrieve(keys.data(),vals.data(),N);
+      });
+      worker.join();
+   }
+   std::ostringstream json;
+   split::trace::write_chrome_trace(json);
+   const std::string trace=json.str();
+   expect_true(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[",0)==0);
+   expect_true(occurrences(trace,"{")==occurrences(trace,"}"));
+#ifdef SPLIT_TRACE
+   expect_true(occurrences(trace,"\"Hashmap::insert\"")==1);
+   expect_true(occurrences(trace,"\"HostHasher::insert chunk\"")>=1);
+   expect_true(occurrences(trace,"\"Hashmap::rehash\"")>=1);
+   expect_true(occurrences(trace,"\"Hashmap::performCleanupTasks\"")>=N/2);
+   expect_true(occurrences(trace,"allocator::allocate\"")>=1);
+   //The ranges of the worker are kept after it has exited
+   expect_true(occurrences(trace,"\"args\":{\"name\":\"worker\"}")==1);
+   expect_true(occurrences(trace,"\"Hashmap::retrieve\",")==1);
+
+   //A full ring drops its oldest ranges
+   split::trace::clear();
+   split::trace::set_buffer_size(8);
+   std::thread busy([](){
+      for (int i=0; i<20; ++i){
+         SPLIT_TRACE_SCOPE_N("busy",i);
+      }
+   });
+   busy.join();
+   split::trace::set_buffer_size(1<<14);
+   json.str("");
+   split::trace::write_chrome_trace(json);
+   expect_true(occurrences(json.str(),"\"busy\"")==8);
+   expect_true(occurrences(json.str(),"\"args\":{\"n\":19}")==1);
+   expect_true(occurrences(json.str(),"\"dropped_events\":12")==1);
+
+   split::trace::clear();
+   split::trace::disable();
+   {
+      SPLIT_TRACE_SCOPE("disabled");
+   }
+   split::trace::enable();
+   json.str("");
+   split::trace::write_chrome_trace(json);
+   expect_true(occurrences(json.str(),"\"ph\":\"X\"")==0);
+#else
+   expect_true(occurrences(trace,"\"ph\":\"X\"")==0);
+#endif
+}
+
+TEST(HashmapUnitTets , Workload_Replay){
+   const std::string path=(std::filesystem::temp_directory_path()/"hashinator_workload_test.hnwl").string();
+   const size_t N = 1<<12;
+   std::vector<val_type> keys(N),vals(N);
+   std::iota(keys.begin(),keys.end(),val_type(1));
+   std::iota(vals.begin(),vals.end(),val_type(7));
+   hashmap recorded(4);
+   expect_true(recorded.record_workload(path));
+   recorded.insert(keys.data(),vals.data(),N);
+   for (size_t i=0; i<N/4; ++i){
+      recorded.erase(i+1);
+      recorded.find(i+1);
+   }
+   recorded[N+1];
+   recorded.retrieve(keys.data(),vals.data(),N);
+   recorded.erase(keys.data()+N/2,N/4);
+   recorded.insert_async(keys.data(),vals.data(),N/8,0.25).get();
+   recorded.stop_workload_recording();
+   //Not recorded any more
+   recorded.find(1);
+
+   using workload=Workload<val_type,val_type>;
+   workload w;
+   expect_true(workload::load(path,w));
+   expect_true(w.ops.size()==1+N/2+1+1+1+1);
+   expect_true(w.elements()==N+N/2+1+N+N/4+N/8);
+   expect_true(w.ops.front().op==workload_op::insert_batch && w.ops.front().len==N);
+   expect_true(w.ops[1].op==workload_op::erase && w.ops[2].op==workload_op::find);
+   expect_true(w.ops.back().op==workload_op::insert_batch && w.ops.back().len==N/8);
+   expect_true(w.ops.front().targetLF==0.5f && w.ops.back().targetLF==0.25f);
+
+   //Replaying on a map with another configuration ends with the same contents
+   hashmap replayed;
+   replayed.set_rehash_policy(rehash_policy::graveyard);
+   const ReplayReport report=replay(w,replayed,split::execution_policy::parallel);
+   expect_true(report.operations==w.ops.size() && report.elements==w.elements());
+   expect_true(report.latency[size_t(workload_op::find)].count()==N/4);
+   expect_true(report.throughput()>0.0);
+   expect_true(replayed.size()==recorded.size());
+   //The batches grow the table to the load factors they were recorded with
+   expect_true(replayed.bucket_count()==recorded.bucket_count());
+   for (auto& e : recorded){
+      auto it=replayed.find(e.first);
+      expect_true(it!=replayed.end() && it->second==e.second);
+   }
+
+   //One record per call, also when the call grows the table or is made of other calls internally
+   hashmap tiny(1);
+   expect_true(tiny.record_workload(path));
+   for (val_type key=1; key<=8; ++key){
+      tiny[key]=key;
+   }
+   tiny.insert(hash_pair<val_type,val_type>(1,5));
+   tiny.insert(hash_pair<val_type,val_type>(9,5));
+   tiny.stop_workload_recording();
+   expect_true(workload::load(path,w));
+   expect_true(w.ops.size()==10 && w.elements()==10);
+   expect_true(tiny.size()==9 && tiny.at(1)==1 && tiny.at(9)==5);
+
+   //Files written for other types are rejected
+   using wide=Workload<val_type,uint64_t>;
+   wide other;
+   expect_false(wide::load(path,other));
+   std::filesystem::resize_file(path,std::filesystem::file_size(path)-1);
+   expect_false(workload::load(path,w));
+   //A corrupt batch length is rejected instead of being allocated
+   {
+      std::ofstream corrupt(path,std::ios::binary|std::ios::trunc);
+      const uint8_t header[8]={'H','N','W','L',2,sizeof(val_type),sizeof(val_type),uint8_t(workload_op::insert_batch)};
+      const uint64_t len=uint64_t(1)<<60;
+      const float targetLF=0.5f;
+      corrupt.write(reinterpret_cast<const char*>(header),sizeof(header));
+      corrupt.write(reinterpret_cast<const char*>(&len),sizeof(len));
+      corrupt.write(reinterpret_cast<const char*>(&targetLF),sizeof(targetLF));
+   }
+   expect_false(workload::load(path,w));
+   std::filesystem::remove(path);
+   expect_false(workload::load(path,w));
+}
+
+TEST(HashmapUnitTets , Memory_Usage){
+   using pair=hash_pair<val_type,val_type>;
+   const split::memory::Totals before=split::memory::totals();
+   {
+      hashmap hmap(10);
+      for (size_t i=0; i<100; ++i){
+         hmap[i+1]=i;
+      }
+      hmap.erase(1);
+      split::MemoryUsage usage=hmap.memory_usage();
+      expect_true(usage.payload==99*sizeof(pair));
+      expect_true(usage.payload+usage.slack==(1<<10)*sizeof(pair));
+      expect_true(usage.overhead>=sizeof(Info)+2*sizeof(size_t));
+      hmap.enable_latency_recording();
+      expect_true(hmap.memory_usage().overhead==usage.overhead+sizeof(LatencyRecorder));
+
+      std::vector<std::unique_ptr<hashmap>> maps;
+      split::MemoryUsage sum;
+      for (int i=0; i<100; ++i){
+         maps.emplace_back(std::make_unique<hashmap>(4));
+         (*maps.back())[i]=i;
+         sum+=maps.back()->memory_usage();
+      }
+      vector loose(1000);
+      const split::memory::Totals during=split::memory::totals();
+#ifdef SPLIT_MEMORY_REGISTRY
+      //The buckets of the maps are counted with the maps only
+      expect_true(during.liveHashmaps==before.liveHashmaps+101);
+      expect_true(during.liveVectors==before.liveVectors+1);
+      expect_true(during.hashmaps.total()==before.hashmaps.total()+sum.total()+hmap.memory_usage().total());
+      expect_true(during.vectors.total()==before.vectors.total()+loose.memory_usage().total());
+      expect_true(during.total().payload==during.vectors.payload+during.hashmaps.payload);
+#else
+      expect_true(during.liveHashmaps==0 && during.total().total()==0);
+#endif
+   }
+   const split::memory::Totals after=split::memory::totals();
+   expect_true(after.liveHashmaps==before.liveHashmaps && after.liveVectors==before.liveVectors);
+   expect_true(after.total().total()==before.total().total());
+}
+
+TEST(HashmapUnitTets , Async_Batches){
+   for (int power=4; power<18; ++power){
+      std::string name= "Power= "+std::to_string(power);
+      expect_true(execute_and_time(name.c_str(),test_async_batches ,power));
+   }
+}
+#endif
+
 int main(int argc, char* argv[]){
    srand(time(NULL));
    ::testing::InitGoogleTest(&argc, argv);